@@ -16,8 +16,11 @@
 #include "interval.h"
 #include "ray.h"
 #include "point.h"
+#include "simd.h"
 #include <stdbool.h>
 
+#define AABB_MIN_THICKNESS 0.0001 /* flat boxes are padded to this width */
+
 /* Axis-Aligned Bounding Box */
 typedef struct s_aabb
 {
@@ -41,13 +44,25 @@ static inline t_aabb aabb_from_intervals(const t_interval *x, const t_interval *
 	return ((t_aabb){.x = *x, .y = *y, .z = *z});
 }
 
-/* AABB from two points (extrema) */
+/* Widen an interval thinner than AABB_MIN_THICKNESS around its middle */
+static inline t_interval aabb_pad_axis(const t_interval *it)
+{
+	if (it->max - it->min >= (real_t)AABB_MIN_THICKNESS)
+		return *it;
+	return interval_expand(it->min, it->max, (real_t)AABB_MIN_THICKNESS);
+}
+
+/* AABB from two points (extrema). Flat boxes (axis-aligned quads and
+   triangles) are padded: the slab test rejects a zero-thickness slab. */
 static inline t_aabb aabb_from_points(const t_point3 *a, const t_point3 *b)
 {
 	t_aabb box;
 	box.x = (a->x <= b->x) ? interval(a->x, b->x) : interval(b->x, a->x);
 	box.y = (a->y <= b->y) ? interval(a->y, b->y) : interval(b->y, a->y);
 	box.z = (a->z <= b->z) ? interval(a->z, b->z) : interval(b->z, a->z);
+	box.x = aabb_pad_axis(&box.x);
+	box.y = aabb_pad_axis(&box.y);
+	box.z = aabb_pad_axis(&box.z);
 	return box;
 }
 
@@ -83,66 +98,29 @@ static inline int aabb_longest_axis(const t_aabb *box)
 		return (y_size > z_size) ? 1 : 2;
 }
 
-/* Ray-AABB intersection test */
+/* Ray-AABB intersection test: the three slabs at once, branch free. ray_t
+   is narrowed to the span inside the box on a hit. */
 static inline bool aabb_hit(const t_aabb *box, const t_ray *r, t_interval *ray_t)
 {
 	if (!box || !r || !ray_t)
 		return false;
 
-	real_t inv_x = (real_t)1.0 / r->dir.x;
-	real_t inv_y = (real_t)1.0 / r->dir.y;
-	real_t inv_z = (real_t)1.0 / r->dir.z;
-
-	real_t t0, t1;
-
-	/* X slab */
-	t0 = (box->x.min - r->orig.x) * inv_x;
-	t1 = (box->x.max - r->orig.x) * inv_x;
-	if (t0 > t1)
-	{
-		real_t tmp = t0;
-		t0 = t1;
-		t1 = tmp;
-	}
-	if (t0 > ray_t->min)
-		ray_t->min = t0;
-	if (t1 < ray_t->max)
-		ray_t->max = t1;
-	if (ray_t->max <= ray_t->min)
-		return false;
-
-	/* Y slab */
-	t0 = (box->y.min - r->orig.y) * inv_y;
-	t1 = (box->y.max - r->orig.y) * inv_y;
-	if (t0 > t1)
-	{
-		real_t tmp = t0;
-		t0 = t1;
-		t1 = tmp;
-	}
-	if (t0 > ray_t->min)
-		ray_t->min = t0;
-	if (t1 < ray_t->max)
-		ray_t->max = t1;
-	if (ray_t->max <= ray_t->min)
-		return false;
-
-	/* Z slab */
-	t0 = (box->z.min - r->orig.z) * inv_z;
-	t1 = (box->z.max - r->orig.z) * inv_z;
-	if (t0 > t1)
-	{
-		real_t tmp = t0;
-		t0 = t1;
-		t1 = tmp;
-	}
-	if (t0 > ray_t->min)
-		ray_t->min = t0;
-	if (t1 < ray_t->max)
-		ray_t->max = t1;
-	if (ray_t->max <= ray_t->min)
+	t_simd orig = simd_load3(&r->orig);
+	t_simd inv_dir = simd_rcp(simd_load3(&r->dir));
+	t_simd lo = simd_set(box->x.min, box->y.min, box->z.min, (real_t)0.0);
+	t_simd hi = simd_set(box->x.max, box->y.max, box->z.max, (real_t)0.0);
+	t_simd t0 = simd_mul(simd_sub(lo, orig), inv_dir);
+	t_simd t1 = simd_mul(simd_sub(hi, orig), inv_dir);
+	real_t t_near = simd_hmax3(simd_min(t0, t1));
+	real_t t_far = simd_hmin3(simd_max(t0, t1));
+	if (t_near < ray_t->min)
+		t_near = ray_t->min;
+	if (t_far > ray_t->max)
+		t_far = ray_t->max;
+	if (t_far <= t_near)
 		return false;
-
+	ray_t->min = t_near;
+	ray_t->max = t_far;
 	return true;
 }
 
@@ -154,4 +132,25 @@ static inline t_aabb aabb_add_vec3(const t_aabb *box, const t_vec3 *offset)
 	return aabb_from_intervals(&nx, &ny, &nz);
 }
 
+/* Linear blend of two boxes (box at shutter open -> box at shutter close) */
+static inline t_aabb aabb_lerp(const t_aabb *box0, const t_aabb *box1, real_t t)
+{
+	real_t s = (real_t)1.0 - t;
+	return ((t_aabb){
+		.x = interval(s * box0->x.min + t * box1->x.min, s * box0->x.max + t * box1->x.max),
+		.y = interval(s * box0->y.min + t * box1->y.min, s * box0->y.max + t * box1->y.max),
+		.z = interval(s * box0->z.min + t * box1->z.min, s * box0->z.max + t * box1->z.max)});
+}
+
+/* Surface area, used as a cost estimate when building the BVH */
+static inline real_t aabb_surface_area(const t_aabb *box)
+{
+	real_t dx = interval_size(&box->x);
+	real_t dy = interval_size(&box->y);
+	real_t dz = interval_size(&box->z);
+	if (dx < 0 || dy < 0 || dz < 0)
+		return 0;
+	return (real_t)2.0 * (dx * dy + dy * dz + dz * dx);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   aov.h                                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/07 15:48:02 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/07 15:48:02 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef AOV_H
+#define AOV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "vector.h"
+#include "framebuffer.h"
+
+/* Arbitrary output variables: extra per-pixel layers gathered in the same
+   pass as the beauty image (camera->aovs) and written as PFM float images
+   next to it, for offline compositing and denoising. Depth, normal and
+   albedo are the denoiser guides; direct light counts emitters seen
+   directly, light sampled at the first hit and emitters reached by the first
+   bounce, indirect is the rest of the beauty image. Ids are those of the
+   pixel's first sample (object ids are truncated to 24 bits, exact in a
+   float). */
+
+typedef enum e_aov_layer
+{
+	AOV_DEPTH = 1 << 0,
+	AOV_NORMAL = 1 << 1,
+	AOV_ALBEDO = 1 << 2,
+	AOV_MATERIAL_ID = 1 << 3,
+	AOV_OBJECT_ID = 1 << 4,
+	AOV_DIRECT = 1 << 5,
+	AOV_INDIRECT = 1 << 6,
+	AOV_SAMPLES = 1 << 7,
+	AOV_ALL = (1 << 8) - 1
+} t_aov_layer;
+
+#define AOV_LAYER_COUNT 8
+
+static const char *const g_aov_names[AOV_LAYER_COUNT] = {
+	"depth", "normal", "albedo", "material_id", "object_id", "direct", "indirect", "samples"};
+
+static const int g_aov_channels[AOV_LAYER_COUNT] = {1, 3, 3, 1, 1, 3, 3, 1};
+
+/* Write width x height pixels of 1 or 3 floats, top row first, as PFM */
+static inline bool aov_write_pfm(const char *filename, int width, int height, int channels, const float *data)
+{
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+		return false;
+	const uint16_t probe = 1;
+	bool little = *(const unsigned char *)&probe == 1;
+	fprintf(f, "%s\n%d %d\n%s\n", channels == 3 ? "PF" : "Pf", width, height, little ? "-1.0" : "1.0");
+	size_t row = (size_t)width * (size_t)channels;
+	bool ok = true;
+	/* PFM stores the bottom row first */
+	for (int j = height - 1; ok && j >= 0; --j)
+		ok = fwrite(data + (size_t)j * row, sizeof(float), row, f) == row;
+	return (fclose(f) == 0) && ok;
+}
+
+/* Value of layer `layer` at pixel idx into out[0..2] */
+static inline void aov_pixel(const t_accum *acc, t_aov_layer layer, size_t idx, float *out)
+{
+	int n = accum_pixel_samples(acc, idx);
+	real_t inv = (n > 0) ? (real_t)1.0 / (real_t)n : (real_t)0.0;
+	t_vec3 v = vec3_zero();
+	switch (layer)
+	{
+	case AOV_DEPTH:
+		out[0] = acc->depth[idx] * (float)inv;
+		return;
+	case AOV_NORMAL:
+		v = vec3_near_zero(&acc->normal[idx]) ? acc->normal[idx] : unit_vector(&acc->normal[idx]);
+		break;
+	case AOV_ALBEDO:
+		v = vec3_mul_scalar(&acc->albedo[idx], inv);
+		break;
+	case AOV_MATERIAL_ID:
+		out[0] = (float)acc->material_id[idx];
+		return;
+	case AOV_OBJECT_ID:
+		out[0] = (float)(acc->object_id[idx] & 0xFFFFFFU);
+		return;
+	case AOV_DIRECT:
+		v = vec3_mul_scalar(&acc->direct[idx], inv);
+		break;
+	case AOV_INDIRECT:
+		v = vec3_sub(&acc->sum[idx], &acc->direct[idx]);
+		v = vec3_mul_scalar(&v, inv);
+		break;
+	default:
+		out[0] = (float)n;
+		return;
+	}
+	out[0] = (float)v.x;
+	out[1] = (float)v.y;
+	out[2] = (float)v.z;
+}
+
+/* Write the requested layers as <stem>_<layer>.pfm; acc needs guides and
+   layers. Returns the number of files written. */
+static inline int aov_write_layers(const t_accum *acc, int layers, const char *stem)
+{
+	if (!acc->albedo || !acc->direct)
+		return 0;
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	float *buf = (float *)malloc(n * 3 * sizeof(float));
+	if (!buf)
+		return 0;
+	size_t size = strlen(stem) + 32; /* "_<layer>.pfm" */
+	char *filename = (char *)malloc(size);
+	if (!filename)
+	{
+		free(buf);
+		return 0;
+	}
+	int written = 0;
+	for (int k = 0; k < AOV_LAYER_COUNT; ++k)
+	{
+		if (!(layers & (1 << k)))
+			continue;
+		int ch = g_aov_channels[k];
+		for (size_t idx = 0; idx < n; ++idx)
+			aov_pixel(acc, (t_aov_layer)(1 << k), idx, &buf[idx * (size_t)ch]);
+		snprintf(filename, size, "%s_%s.pfm", stem, g_aov_names[k]);
+		if (aov_write_pfm(filename, acc->width, acc->height, ch, buf))
+			++written;
+		else
+			fprintf(stderr, "Warning: cannot write %s\n", filename);
+	}
+	free(filename);
+	free(buf);
+	return written;
+}
+
+#endif
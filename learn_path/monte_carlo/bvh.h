@@ -25,25 +25,43 @@
 /* Forward declaration */
 typedef struct s_bvh_node t_bvh_node;
 
-/* BVH node structure: stores children as wrappers and bounding box */
+/* Split a node in time when its interpolated box is this much larger than the
+   real bounds at mid-shutter, at most BVH_MAX_TIME_SPLITS times per path. */
+#define BVH_TIME_SPLIT_RATIO 2.0
+#define BVH_MAX_TIME_SPLITS 2
+
+/* BVH node structure: stores children as wrappers and bounding box.
+   Nodes over moving objects keep their bounds at the start (box0) and end
+   (box1) of their time range [t0, t0 + 1/inv_dt] and interpolate with the
+   ray time. A time_split node sends rays to left before t_split, else right. */
 typedef struct s_bvh_node
 {
 	t_hittable_wrapper left;
 	t_hittable_wrapper right;
 	t_aabb bbox;
+	bool moving;
+	t_aabb box0;
+	t_aabb box1;
+	real_t t0;
+	real_t inv_dt;
+	bool time_split;
+	real_t t_split;
 } t_bvh_node;
 
 /* Comparator function type for qsort */
 typedef int (*t_comparator_fn)(const void *a, const void *b);
 
-/* Generic box comparator: compares interval minimums along given axis */
+/* Generic box comparator: compares interval minimums along given axis.
+   Moving objects are ordered by where they are at mid-shutter. */
 static inline int bvh_box_compare(const void *a, const void *b, int axis_index)
 {
 	const t_hittable_wrapper *wa = (const t_hittable_wrapper *)a;
 	const t_hittable_wrapper *wb = (const t_hittable_wrapper *)b;
+	t_aabb box_a = hittable_wrapper_box_at(wa, 0.5);
+	t_aabb box_b = hittable_wrapper_box_at(wb, 0.5);
 
-	real_t a_min = aabb_axis_interval(&wa->bbox, axis_index)->min;
-	real_t b_min = aabb_axis_interval(&wb->bbox, axis_index)->min;
+	real_t a_min = aabb_axis_interval(&box_a, axis_index)->min;
+	real_t b_min = aabb_axis_interval(&box_b, axis_index)->min;
 
 	if (a_min < b_min)
 		return -1;
@@ -70,6 +88,8 @@ static inline int bvh_box_z_compare(const void *a, const void *b)
 	return bvh_box_compare(a, b, 2);
 }
 
+static inline void bvh_node_destroy(t_bvh_node *node);
+
 /* Set current BVH node for callback dispatch */
 static __thread const t_bvh_node *g_current_bvh = NULL;
 static inline void set_current_bvh(const void *obj)
@@ -83,10 +103,25 @@ static inline bool bvh_node_hit(const t_ray *r, t_interval rayt, t_hit_record *r
 	const t_bvh_node *node = g_current_bvh;
 	if (!node)
 		return false;
+	RT_STAT_INC(nodes);
+
+	/* Time split: each half of the shutter has its own subtree */
+	if (node->time_split)
+	{
+		const t_hittable_wrapper *half = (r->tm < node->t_split) ? &node->left : &node->right;
+		half->set_current(half->object);
+		return half->hit_noobj(r, rayt, rec);
+	}
 
-	/* Early rejection: ray doesn't hit bounding box */
+	/* Early rejection: ray doesn't hit bounding box at the ray's time */
 	t_interval ray_t_copy = rayt;
-	if (!aabb_hit(&node->bbox, r, &ray_t_copy))
+	if (node->moving)
+	{
+		t_aabb box = aabb_lerp(&node->box0, &node->box1, (r->tm - node->t0) * node->inv_dt);
+		if (!aabb_hit(&box, r, &ray_t_copy))
+			return false;
+	}
+	else if (!aabb_hit(&node->bbox, r, &ray_t_copy))
 		return false;
 
 	/* Test left child */
@@ -95,9 +130,14 @@ static inline bool bvh_node_hit(const t_ray *r, t_interval rayt, t_hit_record *r
 	if (node->left.hit_noobj && node->left.set_current)
 	{
 		node->left.set_current(node->left.object);
+		temp_rec.object_id = 0;
+		RT_STAT_OBJECT_BEGIN(cost);
 		hit_left = node->left.hit_noobj(r, rayt, &temp_rec);
+		RT_STAT_OBJECT_END(cost, node->left.id);
 		if (hit_left)
 		{
+			if (!temp_rec.object_id)
+				temp_rec.object_id = node->left.id;
 			*rec = temp_rec;
 			rayt.max = temp_rec.t;
 		}
@@ -108,16 +148,134 @@ static inline bool bvh_node_hit(const t_ray *r, t_interval rayt, t_hit_record *r
 	if (node->right.hit_noobj && node->right.set_current)
 	{
 		node->right.set_current(node->right.object);
+		temp_rec.object_id = 0;
+		RT_STAT_OBJECT_BEGIN(cost);
 		hit_right = node->right.hit_noobj(r, rayt, &temp_rec);
+		RT_STAT_OBJECT_END(cost, node->right.id);
 		if (hit_right)
+		{
+			if (!temp_rec.object_id)
+				temp_rec.object_id = node->right.id;
 			*rec = temp_rec;
+		}
 	}
 
 	return hit_left || hit_right;
 }
 
-/* Recursive BVH construction from sorted object array */
-static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t start, size_t end)
+/* Copy of a wrapper restricted to the local time range [ta, tb] */
+static inline t_hittable_wrapper bvh_retime_wrapper(const t_hittable_wrapper *w, real_t ta, real_t tb)
+{
+	t_hittable_wrapper out = *w;
+	if (!w->moving)
+		return out;
+	out.box0 = aabb_lerp(&w->box0, &w->box1, ta);
+	out.box1 = aabb_lerp(&w->box0, &w->box1, tb);
+	out.bbox = aabb_merge(&out.box0, &out.box1);
+	return out;
+}
+
+/* Wrapper pointing at a child node */
+static inline t_hittable_wrapper bvh_node_wrapper(t_bvh_node *child)
+{
+	t_hittable_wrapper w = {
+		.object = (void *)child,
+		.owned = true,
+		.set_current = set_current_bvh,
+		.hit_noobj = bvh_node_hit,
+		.bbox = child->bbox,
+		.moving = child->moving,
+		.box0 = child->box0,
+		.box1 = child->box1};
+	return w;
+}
+
+/* Set the bounds of a node from its span of (already re-timed) objects */
+static inline void bvh_node_set_bounds(t_bvh_node *node, const t_hittable_wrapper *objects,
+									   size_t start, size_t end, real_t t0, real_t t1)
+{
+	node->bbox = aabb_empty();
+	node->box0 = aabb_empty();
+	node->box1 = aabb_empty();
+	node->moving = false;
+	for (size_t i = start; i < end; ++i)
+	{
+		t_aabb b0 = hittable_wrapper_box_at(&objects[i], 0);
+		t_aabb b1 = hittable_wrapper_box_at(&objects[i], 1);
+		node->bbox = aabb_merge(&node->bbox, &objects[i].bbox);
+		node->box0 = aabb_merge(&node->box0, &b0);
+		node->box1 = aabb_merge(&node->box1, &b1);
+		node->moving = node->moving || objects[i].moving;
+	}
+	node->t0 = t0;
+	node->inv_dt = (t1 > t0) ? (real_t)1.0 / (t1 - t0) : (real_t)0.0;
+	node->time_split = false;
+	node->t_split = 0;
+}
+
+/* True when interpolating the merged start/end boxes would bound the span
+   much more loosely than the objects actually are at mid-shutter */
+static inline bool bvh_wants_time_split(const t_bvh_node *node, const t_hittable_wrapper *objects,
+										size_t start, size_t end)
+{
+	if (!node->moving)
+		return false;
+	t_aabb tight = aabb_empty();
+	for (size_t i = start; i < end; ++i)
+	{
+		t_aabb b = hittable_wrapper_box_at(&objects[i], 0.5);
+		tight = aabb_merge(&tight, &b);
+	}
+	t_aabb loose = aabb_lerp(&node->box0, &node->box1, 0.5);
+	return aabb_surface_area(&loose) > BVH_TIME_SPLIT_RATIO * aabb_surface_area(&tight);
+}
+
+static inline t_bvh_node *bvh_node_build_range(t_hittable_wrapper *objects, size_t start, size_t end,
+											   real_t t0, real_t t1, int time_splits);
+
+/* Build one subtree per half of [t0, t1] over the same objects */
+static inline bool bvh_node_build_time_split(t_bvh_node *node, const t_hittable_wrapper *objects,
+											 size_t start, size_t end, real_t t0, real_t t1,
+											 int time_splits)
+{
+	size_t span = end - start;
+	real_t tm = (real_t)0.5 * (t0 + t1);
+	t_hittable_wrapper *early = (t_hittable_wrapper *)malloc(span * sizeof(t_hittable_wrapper));
+	t_hittable_wrapper *late = (t_hittable_wrapper *)malloc(span * sizeof(t_hittable_wrapper));
+	t_bvh_node *left_node = NULL;
+	t_bvh_node *right_node = NULL;
+
+	if (early && late)
+	{
+		for (size_t i = 0; i < span; ++i)
+		{
+			early[i] = bvh_retime_wrapper(&objects[start + i], 0, 0.5);
+			late[i] = bvh_retime_wrapper(&objects[start + i], 0.5, 1);
+			late[i].owned = false; /* the early subtree frees shared objects */
+		}
+		left_node = bvh_node_build_range(early, 0, span, t0, tm, time_splits - 1);
+		right_node = bvh_node_build_range(late, 0, span, tm, t1, time_splits - 1);
+	}
+	free(early);
+	free(late);
+	if (!left_node || !right_node)
+	{
+		bvh_node_destroy(left_node);
+		bvh_node_destroy(right_node);
+		return false;
+	}
+
+	node->left = bvh_node_wrapper(left_node);
+	node->right = bvh_node_wrapper(right_node);
+	node->time_split = true;
+	node->t_split = tm;
+	return true;
+}
+
+/* Recursive BVH construction over objects whose box0/box1 bound them at
+   shutter times t0 and t1 */
+static inline t_bvh_node *bvh_node_build_range(t_hittable_wrapper *objects, size_t start, size_t end,
+											   real_t t0, real_t t1, int time_splits)
 {
 	if (!objects || start >= end)
 		return NULL;
@@ -127,14 +285,18 @@ static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t sta
 		return NULL;
 
 	size_t object_span = end - start;
+	bvh_node_set_bounds(node, objects, start, end, t0, t1);
 
-	/* Build bounding box of the span of objects */
-	t_aabb span_bbox = aabb_empty();
-	for (size_t i = start; i < end; ++i)
-		span_bbox = aabb_merge(&span_bbox, &objects[i].bbox);
+	/* Fast-moving objects crossing each other: split the shutter instead of space */
+	if (object_span > 1 && time_splits > 0 && bvh_wants_time_split(node, objects, start, end))
+	{
+		if (bvh_node_build_time_split(node, objects, start, end, t0, t1, time_splits))
+			return node;
+	}
 
-	/* Choose axis with longest extent */
-	int axis = aabb_longest_axis(&span_bbox);
+	/* Choose axis with longest extent at mid-shutter */
+	t_aabb mid_bbox = aabb_lerp(&node->box0, &node->box1, 0.5);
+	int axis = aabb_longest_axis(node->moving ? &mid_bbox : &node->bbox);
 	t_comparator_fn comparator;
 	if (axis == 0)
 		comparator = bvh_box_x_compare;
@@ -147,11 +309,7 @@ static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t sta
 	if (object_span == 1)
 	{
 		node->left = objects[start];
-		node->right.object = NULL;
-		node->right.owned = false;
-		node->right.set_current = NULL;
-		node->right.hit_noobj = NULL;
-		node->bbox = objects[start].bbox;
+		node->right = (t_hittable_wrapper){.object = NULL, .owned = false};
 		return node;
 	}
 
@@ -167,7 +325,6 @@ static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t sta
 		}
 		node->left = objects[start];
 		node->right = objects[start + 1];
-		node->bbox = aabb_merge(&objects[start].bbox, &objects[start + 1].bbox);
 		return node;
 	}
 
@@ -175,38 +332,30 @@ static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t sta
 	qsort(&objects[start], object_span, sizeof(t_hittable_wrapper), comparator);
 	size_t mid = start + object_span / 2;
 
-	t_bvh_node *left_node = bvh_node_build(objects, start, mid);
-	t_bvh_node *right_node = bvh_node_build(objects, mid, end);
+	t_bvh_node *left_node = bvh_node_build_range(objects, start, mid, t0, t1, time_splits);
+	t_bvh_node *right_node = bvh_node_build_range(objects, mid, end, t0, t1, time_splits);
 
 	if (!left_node || !right_node)
 	{
 		free(node);
-		if (left_node)
-			free(left_node);
-		if (right_node)
-			free(right_node);
+		bvh_node_destroy(left_node);
+		bvh_node_destroy(right_node);
 		return NULL;
 	}
 
 	/* Create wrappers for child nodes */
-	node->left.object = (void *)left_node;
-	node->left.owned = true;
-	node->left.set_current = set_current_bvh;
-	node->left.hit_noobj = bvh_node_hit;
-	node->left.bbox = left_node->bbox;
-
-	node->right.object = (void *)right_node;
-	node->right.owned = true;
-	node->right.set_current = set_current_bvh;
-	node->right.hit_noobj = bvh_node_hit;
-	node->right.bbox = right_node->bbox;
-
-	/* Compute bounding box as merge of children */
-	node->bbox = aabb_merge(&left_node->bbox, &right_node->bbox);
+	node->left = bvh_node_wrapper(left_node);
+	node->right = bvh_node_wrapper(right_node);
 
 	return node;
 }
 
+/* Recursive BVH construction from sorted object array */
+static inline t_bvh_node *bvh_node_build(t_hittable_wrapper *objects, size_t start, size_t end)
+{
+	return bvh_node_build_range(objects, start, end, 0, 1, BVH_MAX_TIME_SPLITS);
+}
+
 /* Create BVH from hittable list */
 static inline t_bvh_node *bvh_node_create(t_hittable_list *world)
 {
@@ -19,6 +19,8 @@
 #ifdef _OPENMP
 #include <omp.h>
 #endif
+#include <signal.h>
+#include <string.h>
 #include <time.h>
 #include "types.h"
 #include "point.h"
@@ -27,6 +29,32 @@
 #include "hittable_list.h"
 #include "random.h"
 #include "color.h"
+#include "tile.h"
+#include "framebuffer.h"
+#include "pdf.h"
+#include "sampler.h"
+#include "denoise.h"
+#include "aov.h"
+#include "farm.h"
+#include "image_writer.h"
+#include "guide.h"
+#include "envmap.h"
+
+/* Light list and direct lighting live in light.h, included by common.h after
+   this file (light.h needs the primitives, which need common.h) */
+typedef struct s_light_list t_light_list;
+static inline bool light_list_empty(const t_light_list *lights);
+static inline real_t light_environment_share(const t_light_list *lights, const t_envmap *env);
+static inline real_t light_list_pdf(const t_light_list *lights, const t_envmap *env, const t_ray *r, real_t t,
+									const t_material *mat, const t_point3 *p, const t_vec3 *n);
+static inline t_color light_list_direct(const t_light_list *lights, const t_envmap *env,
+										const t_hittable_list *world, const t_ray *r_in, const t_hit_record *rec,
+										const t_color *attenuation, const t_guide_mix *mix);
+
+#define ROULETTE_MIN_DEPTH 3 /* default camera->rr_depth */
+#define ROULETTE_MAX_SURVIVAL 0.95 /* even bright paths may end, bounding the loop */
+#define TIME_BUDGET_RESERVE 0.05 /* share of the time budget kept as slack past the measured output cost */
+#define TIME_BUDGET_SAFETY 0.9	 /* timed passes are sized to this share of the time left */
 
 /* Camera type */
 typedef struct s_camera
@@ -37,6 +65,7 @@ typedef struct s_camera
 	int image_width;
 	int image_height;
 	int max_depth;
+	int rr_depth; /* bounces before Russian roulette may end a path (-1 = off) */
 	real_t vfov;
 	t_point3 lookfrom;
 	t_point3 lookat;
@@ -55,8 +84,44 @@ typedef struct s_camera
 	t_vec3 defocus_disk_v;
 	int sqrt_spp;
 	real_t recip_sqrt_spp;
+	int tile_size;			 /* render tile edge in pixels */
+	t_tile_order tile_order; /* order tiles are handed out in */
+	int sample_stride;		 /* strata are visited as (s * stride) mod spp */
+	int pass_samples;		 /* progressive mode: samples per pixel per pass (0 = one pass) */
+	int checkpoint_every;	 /* progressive mode: save the accumulator every N passes */
+	bool resume;			 /* continue from checkpoint_path if it matches this render */
+	const char *checkpoint_path;
+	real_t adaptive_error;	  /* adaptive sampling: target relative error (0 = off) */
+	int adaptive_min_samples; /* adaptive sampling: samples before a pixel may stop */
+	int adaptive_max_samples; /* adaptive sampling: per-pixel cap (0 = 4x spp) */
+	real_t time_budget;		  /* wall-clock seconds for the whole render (0 = off) */
+	const t_light_list *lights; /* lights sampled directly at diffuse bounces (NULL = off) */
+	t_sampler_kind sampler;		/* sample sequence (see sampler.h) */
+	uint64_t seed;				/* samples are a pure function of (seed, pixel, sample index) */
+	bool denoise;				/* filter the final image with first-hit guides (denoise.h) */
+	int aovs;					/* t_aov_layer bits written as PFM next to the image (0 = none) */
+	int workers;				/* render processes, single threaded each (farm.h; 0 or 1 = off) */
+	t_tile crop;				/* pixel window rendered and written (whole image by default) */
+	const char *crop_backdrop;	/* full-size PPM or PNG the crop is pasted over (NULL = crop alone) */
+	const char *output_path;	/* image written: PPM, PNG, or linear HDR PFM or EXR (by extension) */
+	bool output_compress;		/* lossless ZIP compression of EXR tiles */
+	bool bucket_mode;			/* out-of-core: only in-flight tiles in memory (camera_render_buckets) */
+	bool guiding;				/* learn where light comes from and sample bounces towards it (guide.h) */
+	t_guide *guide;				/* set by camera_render while guiding */
+	const t_envmap *environment; /* image lighting seen past the scene, sampled like a light (NULL = background) */
 } t_camera;
 
+static inline int camera_gcd(int a, int b)
+{
+	while (b != 0)
+	{
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
 /* Initialize camera in-place */
 static inline void camera_init(t_camera *camera, real_t aspect_ratio, int image_width)
 {
@@ -74,11 +139,36 @@ static inline void camera_init(t_camera *camera, real_t aspect_ratio, int image_
 		return;
 
 	camera->max_depth = 50;
+	camera->rr_depth = ROULETTE_MIN_DEPTH;
+	camera->tile_size = TILE_DEFAULT_SIZE;
+	camera->tile_order = TILE_ORDER_SPIRAL;
+	camera->pass_samples = 0;
+	camera->checkpoint_every = 1;
+	camera->resume = false;
+	camera->checkpoint_path = "../output/render.ckpt";
+	camera->adaptive_error = 0.0;
+	camera->adaptive_min_samples = 16;
+	camera->adaptive_max_samples = 0;
+	camera->time_budget = 0.0;
+	camera->lights = NULL;
+	camera->sampler = SAMPLER_RANDOM;
+	camera->seed = 0;
+	camera->denoise = false;
+	camera->aovs = 0;
+	camera->workers = 0;
+	camera->crop_backdrop = NULL;
+	camera->output_path = "../output/render.ppm";
+	camera->output_compress = true;
+	camera->bucket_mode = false;
+	camera->guiding = false;
+	camera->guide = NULL;
+	camera->environment = NULL;
 	camera->aspect_ratio = (aspect_ratio > 0) ? aspect_ratio : (real_t)1.0;
 	camera->image_width = (image_width > 0) ? image_width : 100;
 	camera->image_height = (int)((real_t)camera->image_width / camera->aspect_ratio);
 	if (camera->image_height < 1)
 		camera->image_height = 1;
+	camera->crop = (t_tile){0, 0, camera->image_width, camera->image_height};
 
 	/* Initialize background to black if not set */
 	if (camera->background.x == 0.0 && camera->background.y == 0.0 && camera->background.z == 0.0)
@@ -132,6 +222,15 @@ static inline void camera_init(t_camera *camera, real_t aspect_ratio, int image_
 	camera->recip_sqrt_spp = (real_t)1.0 / (real_t)camera->sqrt_spp;
 	camera->pixel_samples_scale = (real_t)1.0 / (camera->sqrt_spp * camera->sqrt_spp);
 
+	/* Visit strata with a stride coprime to their count, near n / phi, so any
+	   run of consecutive samples (one progressive pass) spreads over the pixel */
+	int n_strata = camera->sqrt_spp * camera->sqrt_spp;
+	camera->sample_stride = (int)(0.618034 * n_strata);
+	while (camera->sample_stride > 1 && camera_gcd(camera->sample_stride, n_strata) != 1)
+		--camera->sample_stride;
+	if (camera->sample_stride < 1)
+		camera->sample_stride = 1;
+
 	t_vec3 sum = vec3_add(&camera->pixel_delta_u, &camera->pixel_delta_v);
 	t_vec3 half_sum = vec3_mul_scalar(&sum, (real_t)0.5);
 	camera->pixel00_loc = vec3_add(&viewport_upper_left, &half_sum);
@@ -142,6 +241,26 @@ static inline void camera_init(t_camera *camera, real_t aspect_ratio, int image_
 	camera->defocus_disk_v = vec3_mul_scalar(&camera->v, defocus_radius);
 }
 
+/* Crop to the window [x0, x1) x [y0, y1) given in [0, 1] image coordinates
+   (0, 0 = top left); pixels are kept whole, so the window may grow slightly */
+static inline void camera_set_crop(t_camera *camera, real_t x0, real_t y0, real_t x1, real_t y1)
+{
+	camera->crop.x0 = (int)floor((double)x0 * camera->image_width);
+	camera->crop.y0 = (int)floor((double)y0 * camera->image_height);
+	camera->crop.x1 = (int)ceil((double)x1 * camera->image_width);
+	camera->crop.y1 = (int)ceil((double)y1 * camera->image_height);
+}
+
+/* The crop window clamped to the image; the whole image if it is empty */
+static inline t_tile camera_crop_window(const t_camera *camera)
+{
+	t_tile image = {0, 0, camera->image_width, camera->image_height};
+	t_tile window = camera->crop;
+	if (tile_list_clip(&window, 1, &image) == 0)
+		return image;
+	return window;
+}
+
 /* Return a random point in the [-0.5,-0.5] .. [+0.5,+0.5] square (z = 0) */
 static inline t_vec3 sample_square(void)
 {
@@ -170,7 +289,10 @@ static inline t_vec3 defocus_disk_sample(const t_camera *cam)
    and directed at a randomly sampled point around pixel (i,j) in stratified sub-cell (s_i, s_j) */
 static inline t_ray get_ray_stratified(const t_camera *cam, int i, int j, int s_i, int s_j)
 {
-	t_vec3 offset = sample_square_stratified(s_i, s_j, cam->recip_sqrt_spp);
+	/* Low-discrepancy samplers place the sample themselves */
+	t_vec3 offset = (cam->sampler == SAMPLER_RANDOM)
+						? sample_square_stratified(s_i, s_j, cam->recip_sqrt_spp)
+						: sample_square();
 
 	/* tmp_u = (i + offset.x) * pixel_delta_u */
 	t_vec3 tmp_u = vec3_mul_scalar(&cam->pixel_delta_u, (real_t)(i + offset.x));
@@ -181,13 +303,16 @@ static inline t_ray get_ray_stratified(const t_camera *cam, int i, int j, int s_
 	t_vec3 pixel_sample = vec3_add(&tmp, &tmp_v);
 
 	/* Ray origin: defocus disk if enabled, otherwise camera center */
+	sampler_open(SAMPLER_DIM_LENS, 2);
 	t_vec3 ray_origin = (cam->defocus_angle <= (real_t)0.0) ? cam->center : defocus_disk_sample(cam);
 
 	/* Ray direction: from origin to pixel sample */
 	t_vec3 ray_direction = vec3_sub(&pixel_sample, &ray_origin);
 
 	/* Random time in [0, 1] for motion blur */
+	sampler_open(SAMPLER_DIM_TIME, 1);
 	real_t ray_time = random_real();
+	sampler_close();
 
 	return ray_create(ray_origin, ray_direction, ray_time);
 }
@@ -216,66 +341,238 @@ static inline void get_output_filename(char *filename, size_t size, const char *
 	snprintf(filename, size, "../output/%s.ppm", base_name);
 }
 
-/* ray_color_depth with material emission, scattering PDF, and background support */
-static inline t_vec3 ray_color_with_background(const t_ray *r, const t_hittable_list *world, int depth, const t_color *background)
+/* Sky seen by a ray that leaves the scene */
+static inline t_color ray_background(const t_ray *r, const t_color *background)
 {
-	t_hit_record rec;
-
-	if (depth <= 0)
+	/* Check if background is essentially black (for dark scenes like Cornell box) */
+	if (background->x < 0.01 && background->y < 0.01 && background->z < 0.01)
 		return vec3_zero();
 
-	if (!hittable_list_hit(world, r, interval((real_t)1e-4, INFINITY), &rec))
-	{
-		/* No hit - return background/sky color */
-		/* Check if background is essentially black (for dark scenes like Cornell box) */
-		if (background->x < 0.01 && background->y < 0.01 && background->z < 0.01)
-			return vec3_zero();
-
-		/* For sky-lit outdoor scenes: use classic sky gradient
-		   This matches the original C++ ray tracer behavior:
-		   lerp between white at horizon and blue at zenith */
-		t_vec3 unit_dir = unit_vector(&r->dir);
-		real_t a = (real_t)0.5 * (unit_dir.y + (real_t)1.0);
-
-		/* Original C++ uses: (1-a)*white + a*blue
-		   white = (1.0, 1.0, 1.0), blue = (0.5, 0.7, 1.0) for classic look
-		   But we use the provided background color as the "blue" target */
-		t_vec3 white = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
-		return vec3_lerp(&white, background, a);
-	}
+	/* For sky-lit outdoor scenes: use classic sky gradient
+	   This matches the original C++ ray tracer behavior:
+	   lerp between white at horizon and blue at zenith */
+	t_vec3 unit_dir = unit_vector(&r->dir);
+	real_t a = (real_t)0.5 * (unit_dir.y + (real_t)1.0);
+
+	/* Original C++ uses: (1-a)*white + a*blue
+	   white = (1.0, 1.0, 1.0), blue = (0.5, 0.7, 1.0) for classic look
+	   But we use the provided background color as the "blue" target */
+	t_vec3 white = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
+	return vec3_lerp(&white, background, a);
+}
 
-	t_ray scattered;
-	t_color attenuation;
-	t_color emission = vec3_zero();
+/* Russian roulette after `bounce` bounces: false ends the path, otherwise
+   *throughput is divided by the survival probability so the estimate stays
+   unbiased. Survival follows the brightest throughput channel. */
+static inline bool path_survives(t_color *throughput, int bounce, int rr_depth)
+{
+	if (rr_depth < 0 || bounce < rr_depth)
+		return true;
+	real_t q = fmax(throughput->x, fmax(throughput->y, throughput->z));
+	if (q >= (real_t)ROULETTE_MAX_SURVIVAL)
+		q = (real_t)ROULETTE_MAX_SURVIVAL;
+	if (q <= (real_t)0.0 || random_real() >= q)
+		return false;
+	*throughput = vec3_div_scalar(throughput, q);
+	return true;
+}
 
-	/* Get emitted color from material */
-	if (rec.mat && rec.mat->emitted)
-		emission = rec.mat->emitted(rec.mat, rec.u, rec.v, &rec.p);
+/* First-hit data of one camera sample: denoiser guides and AOVs. Albedo and
+   normal come from the first non-specular hit (mirrors and glass are looked
+   through); depth and ids from the first hit. Direct is the part of the
+   sample's radiance that left an emitter or the sky and reached the camera
+   after at most one bounce. */
+typedef struct s_path_aov
+{
+	t_color albedo;
+	t_vec3 normal;
+	real_t depth; /* 0 when the camera ray escapes */
+	bool has_surface;
+	t_color direct;
+	uint32_t material_id; /* 0 when the camera ray escapes */
+	uint32_t object_id;
+} t_path_aov;
 
-	/* If material exists and scatters, combine emission with scattered light */
-	if (rec.mat && rec.mat->scatter(rec.mat, r, &rec, &attenuation, &scattered))
+static inline void path_aov_surface(t_path_aov *aov, const t_color *albedo, const t_vec3 *normal)
+{
+	if (!aov || aov->has_surface)
+		return;
+	aov->albedo = *albedo;
+	aov->normal = *normal;
+	aov->has_surface = true;
+}
+
+/* Path tracing with material emission, scattering PDF, and background support.
+   The path is followed in a loop carrying its throughput, for at most depth
+   segments; from bounce rr_depth on (-1 = never) it is ended by Russian
+   roulette. With lights, every non-delta bounce also samples one light
+   directly (next-event estimation). The BSDF ray leaving that bounce keeps its
+   sampling density bsdf_pdf (0 after a delta bounce or for camera rays); when
+   it reaches a registered light, the emission is MIS-weighted against the
+   density light sampling would have had for the same direction. When aov is
+   given it receives the sample's first-hit guides. With a guide, non-delta
+   bounces draw their direction from the learned distribution or the BSDF
+   (see guide.h) and, while training, the path records what it brought back.
+   With an environment map, rays leaving the scene see it instead of the
+   background, and it is sampled at bounces alongside the lights. */
+static inline t_vec3 ray_color_path(const t_ray *r, const t_hittable_list *world, const t_light_list *lights,
+									const t_envmap *env, int depth, const t_color *background, int rr_depth,
+									t_path_aov *aov, t_guide *guide)
+{
+	t_guide_vertex verts[GUIDE_MAX_VERTICES];
+	int vert_count = 0;
+	t_color radiance = vec3_zero();
+	t_color throughput = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
+	const t_color white = throughput;
+	t_ray ray = *r;
+	real_t bsdf_pdf = (real_t)0.0;
+	t_point3 from_p = r->orig; /* surface the BSDF ray left, for light_list_pdf */
+	t_vec3 from_n = r->dir;
+	t_vec3 back = unit_vector(&r->dir);
+	back = vec3_neg(&back);
+	if (aov)
 	{
-		t_vec3 scattered_col = ray_color_with_background(&scattered, world, depth - 1, background);
-		t_vec3 attenuated = vec3_mul_elem(&attenuation, &scattered_col);
-		return vec3_add(&emission, &attenuated);
+		aov->depth = (real_t)0.0;
+		aov->has_surface = false;
+		aov->direct = vec3_zero();
+		aov->material_id = 0;
+		aov->object_id = 0;
 	}
 
-	/* Material does not scatter: return only emission */
-	return emission;
+	for (int bounce = 0; bounce < depth; ++bounce)
+	{
+		t_hit_record rec;
+		RT_STAT_INC(segments);
+		if (!hittable_list_hit(world, &ray, interval(RAY_T_MIN, INFINITY), &rec))
+		{
+			t_color sky = env ? envmap_radiance(env, &ray.dir) : ray_background(&ray, background);
+			if (env && bsdf_pdf > (real_t)0.0)
+			{
+				t_vec3 dir = unit_vector(&ray.dir);
+				real_t env_pdf = light_environment_share(lights, env) * envmap_pdf(env, &dir);
+				if (env_pdf > (real_t)0.0)
+					sky = vec3_mul_scalar(&sky, mis_power_heuristic(bsdf_pdf, env_pdf));
+			}
+			sky = vec3_mul_elem(&throughput, &sky);
+			radiance = vec3_add(&radiance, &sky);
+			if (aov && bounce <= 1)
+				aov->direct = vec3_add(&aov->direct, &sky);
+			break;
+		}
+		RT_STAT_INC(hits);
+		if (aov && bounce == 0)
+		{
+			aov->depth = rec.t * vec3_length(&ray.dir);
+			aov->material_id = rec.mat ? rec.mat->id : 0;
+			aov->object_id = rec.object_id;
+		}
+		if (!rec.mat)
+			break;
+
+		/* Get emitted color from material */
+		if (rec.mat->emitted)
+		{
+			t_color emission = rec.mat->emitted(rec.mat, rec.u, rec.v, &rec.p);
+			if (bsdf_pdf > (real_t)0.0 && !vec3_near_zero(&emission))
+			{
+				real_t light_pdf = light_list_pdf(lights, env, &ray, rec.t, rec.mat, &from_p, &from_n);
+				if (light_pdf > (real_t)0.0)
+					emission = vec3_mul_scalar(&emission, mis_power_heuristic(bsdf_pdf, light_pdf));
+			}
+			emission = vec3_mul_elem(&throughput, &emission);
+			radiance = vec3_add(&radiance, &emission);
+			if (aov && bounce <= 1)
+				aov->direct = vec3_add(&aov->direct, &emission);
+		}
+
+		/* Material does not scatter: the path ends on its emission */
+		t_ray scattered;
+		t_color attenuation = vec3_zero();
+		sampler_open_bounce(bounce, SAMPLER_BSDF, 4);
+		bool scatters = rec.mat->scatter(rec.mat, &ray, &rec, &attenuation, &scattered);
+		t_guide_mix mix = {NULL, -1, rec.normal};
+		if (guide && rec.mat->diffuse)
+			mix = guide_mix_at(guide, &rec.p, &rec.normal);
+
+		/* Non-delta bounce: sample a light there too, even when the BSDF
+		   sample is absorbed, since emitters reached by BSDF sampling are
+		   weighted as if light sampling always ran */
+		bool sample_lights = (!light_list_empty(lights) || env) && rec.mat->sampling_pdf;
+		if (sample_lights)
+		{
+			sampler_open_bounce(bounce, SAMPLER_LIGHT, 3);
+			t_color direct = light_list_direct(lights, env, world, &ray, &rec, &attenuation, &mix);
+			direct = vec3_mul_elem(&throughput, &direct);
+			radiance = vec3_add(&radiance, &direct);
+			if (aov && bounce == 0)
+				aov->direct = vec3_add(&aov->direct, &direct);
+		}
+		if (!scatters && !mix.dtree)
+		{
+			path_aov_surface(aov, &white, &rec.normal);
+			break;
+		}
+		if (scatters && rec.mat->sampling_pdf)
+		{
+			t_color albedo = vec3_mul_elem(&throughput, &attenuation);
+			path_aov_surface(aov, &albedo, &rec.normal);
+		}
+
+		/* Guided bounce: the direction may come from the learned distribution
+		   instead, and is weighted by the BSDF over the mixture density. An
+		   absorbed BSDF sample leaves `scattered` unset and the pdf at 0. */
+		t_color weight = attenuation;
+		if (mix.dtree)
+		{
+			sampler_close();
+			if (random_real() >= (real_t)GUIDE_BSDF_FRACTION)
+			{
+				scattered = ray_create(rec.p, guide_sample(&mix), ray.tm);
+				scatters = true;
+			}
+		}
+		real_t path_pdf = (real_t)0.0;
+		if (scatters && rec.mat->sampling_pdf)
+			path_pdf = guide_mix_pdf(&mix, rec.mat->sampling_pdf(rec.mat, &ray, &rec, &scattered), &scattered.dir);
+		if (mix.dtree)
+		{
+			real_t f_pdf = scatters ? rec.mat->scattering_pdf(rec.mat, &ray, &rec, &scattered) : (real_t)0.0;
+			scatters = f_pdf > (real_t)0.0 && path_pdf > (real_t)0.0;
+			weight = scatters ? vec3_mul_scalar(&attenuation, f_pdf / path_pdf) : vec3_zero();
+		}
+
+		/* Emitters the BSDF ray reaches are MIS-weighted against light sampling */
+		bsdf_pdf = (real_t)0.0;
+		if (sample_lights)
+		{
+			bsdf_pdf = path_pdf;
+			from_p = rec.p;
+			from_n = rec.normal;
+		}
+		if (!scatters)
+			break; /* guided direction the BSDF does not reach */
+		throughput = vec3_mul_elem(&throughput, &weight);
+		sampler_open_bounce(bounce, SAMPLER_ROULETTE, 1);
+		bool survives = path_survives(&throughput, bounce + 1, rr_depth);
+		sampler_close();
+		if (!survives)
+			break;
+		if (guide && guide->training && mix.cell >= 0 && path_pdf > (real_t)0.0
+			&& vert_count < GUIDE_MAX_VERTICES)
+			verts[vert_count++] = (t_guide_vertex){mix.cell, scattered.dir, path_pdf, radiance, throughput};
+		ray = scattered;
+		ray.orig = ray_offset_origin(&rec.p, &rec.normal, &ray.dir);
+	}
+	if (vert_count > 0)
+		guide_record_path(guide, verts, vert_count, &radiance);
+	path_aov_surface(aov, &white, &back);
+	return radiance;
 }
 
-/* Convert pixel color to binary PPM (P6) row buffer */
-static inline unsigned char *write_color_to_buf_bin(unsigned char *dst, const t_vec3 *pixel)
+/* Plain path tracing, every emitter found by BSDF sampling */
+static inline t_vec3 ray_color_with_background(const t_ray *r, const t_hittable_list *world, int depth, const t_color *background)
 {
-	real_t r = linear_to_gamma(pixel->x);
-	real_t g = linear_to_gamma(pixel->y);
-	real_t b = linear_to_gamma(pixel->z);
-
-	static const t_interval intensity = {0.000, 0.999, true};
-	*dst++ = (unsigned char)component_to_byte(r, &intensity);
-	*dst++ = (unsigned char)component_to_byte(g, &intensity);
-	*dst++ = (unsigned char)component_to_byte(b, &intensity);
-	return dst;
+	return ray_color_path(r, world, NULL, NULL, depth, background, -1, NULL, NULL);
 }
 
 /* Format seconds into hh:mm:ss (or mm:ss if <1h) */
@@ -295,121 +592,807 @@ static inline void format_time(double seconds, char *buf, size_t bufsize)
 		snprintf(buf, bufsize, "%02d:%02d", m, s);
 }
 
-/* Render function with stratified sampling */
-static inline void camera_render(const t_camera *camera, FILE *out, const t_hittable_list *world)
+/* Stratum of the s-th sample of a pixel: strided order (see camera_init) */
+static inline void camera_sample_stratum(const t_camera *camera, int s, int *s_i, int *s_j)
 {
-	(void)out;
-	if (!camera)
-		return;
-	setvbuf(stderr, NULL, _IONBF, 0); /* unbuffered progress */
-	clock_t start_clock = clock();
+	int n = camera->sqrt_spp * camera->sqrt_spp;
+	int k = (int)(((long)s * camera->sample_stride) % n);
+	*s_i = k % camera->sqrt_spp;
+	*s_j = k / camera->sqrt_spp;
+}
 
-	char filename[256];
-	snprintf(filename, sizeof(filename), "../output/render.ppm");
-	FILE *ppm_file = fopen(filename, "w");
-	if (!ppm_file)
+/* Sum of samples [s_begin, s_end) of pixel (i, j). When lum is given, the
+   sum of the samples' luminance and of its square are added to lum[0..1];
+   when guides is given, the samples' guides and direct light are added to
+   it and it takes the ids of sample 0. */
+static inline t_color camera_render_pixel(const t_camera *camera, const t_hittable_list *world,
+										  int i, int j, int s_begin, int s_end, double *lum,
+										  t_path_aov *guides)
+{
+	t_path_aov aov;
+	t_color pixel_color = vec3_zero();
+	for (int s = s_begin; s < s_end; ++s)
 	{
-		fprintf(stderr, "Error: cannot open file %s for writing\n", filename);
-		return;
+		int s_i;
+		int s_j;
+		camera_sample_stratum(camera, s, &s_i, &s_j);
+		sampler_start(camera->sampler, camera->seed, i, j, s);
+		t_ray r = get_ray_stratified(camera, i, j, s_i, s_j);
+		RT_STAT_INC(camera_rays);
+		t_vec3 sample_color = ray_color_path(&r, world, camera->lights, camera->environment,
+											 camera->max_depth, &camera->background, camera->rr_depth,
+											 guides ? &aov : NULL, camera->guide);
+		pixel_color = vec3_add(&pixel_color, &sample_color);
+		if (guides)
+		{
+			guides->albedo = vec3_add(&guides->albedo, &aov.albedo);
+			guides->normal = vec3_add(&guides->normal, &aov.normal);
+			guides->depth += aov.depth;
+			guides->direct = vec3_add(&guides->direct, &aov.direct);
+			if (s == 0)
+			{
+				guides->material_id = aov.material_id;
+				guides->object_id = aov.object_id;
+			}
+		}
+		if (lum)
+		{
+			double y = (double)color_luminance(&sample_color);
+			lum[0] += y;
+			lum[1] += y * y;
+		}
 	}
-	setvbuf(ppm_file, NULL, _IOFBF, 1 << 20);
-
-	fprintf(ppm_file, "P6\n%d %d\n255\n", camera->image_width, camera->image_height);
+	sampler_stop();
+	return pixel_color;
+}
 
-	int w = camera->image_width;
-	int h = camera->image_height;
-	t_vec3 *pixels = (t_vec3 *)malloc((size_t)w * (size_t)h * sizeof(t_vec3));
-	if (!pixels)
+/* Add n more samples to every pixel of one tile, skipping pixels that have
+   converged. Rows left when the deadline (wall time, 0 = none) passes are
+   skipped as well. */
+static inline void camera_render_tile(const t_camera *camera, const t_hittable_list *world,
+									  const t_tile *tile, t_accum *acc, int n, double deadline,
+									  t_render_stats *stats)
+{
+	for (int j = tile->y0; j < tile->y1; ++j)
 	{
-		fprintf(stderr, "Error: cannot allocate pixel buffer\n");
-		fclose(ppm_file);
-		return;
+		if (deadline > 0.0 && stats_wall_time() >= deadline)
+			return;
+		for (int i = tile->x0; i < tile->x1; ++i)
+		{
+			size_t idx = accum_index(acc, i, j);
+			if (acc->converged && acc->converged[idx])
+				continue;
+			t_ray_stats pixel_stats = render_stats_pixel_begin();
+			double lum[2] = {0.0, 0.0};
+			t_path_aov guides = {vec3_zero(), vec3_zero(), (real_t)0.0, false, vec3_zero(), 0, 0};
+			int s_begin = accum_pixel_samples(acc, idx);
+			t_color c = camera_render_pixel(camera, world, i, j, s_begin, s_begin + n,
+											acc->count ? lum : NULL, acc->albedo ? &guides : NULL);
+			acc->sum[idx] = vec3_add(&acc->sum[idx], &c);
+			if (acc->albedo)
+			{
+				acc->albedo[idx] = vec3_add(&acc->albedo[idx], &guides.albedo);
+				acc->normal[idx] = vec3_add(&acc->normal[idx], &guides.normal);
+				acc->depth[idx] += (float)guides.depth;
+			}
+			if (acc->direct)
+			{
+				acc->direct[idx] = vec3_add(&acc->direct[idx], &guides.direct);
+				if (s_begin == 0)
+				{
+					acc->material_id[idx] = guides.material_id;
+					acc->object_id[idx] = guides.object_id;
+				}
+			}
+			if (acc->count)
+			{
+				acc->count[idx] += n;
+				acc->lum[idx] += (float)lum[0];
+				acc->lum_sq[idx] += (float)lum[1];
+			}
+			render_stats_pixel_end(stats, i, j, &pixel_stats);
+		}
 	}
+}
 
-	fprintf(stderr, "Starting render...\n");
-	int rows_done = 0;
-	fprintf(stderr, "\rRendering:   0.0%% | rows left: %4d | elapsed:   0.0s | ETA:   --:-- ", h);
+/* One pass: samples to add per pixel, hard deadline, and what the progress
+   line shows (shares of the whole render, spp reached / spp limit) */
+typedef struct s_pass_plan
+{
+	int samples;
+	double deadline;	/* wall time the pass must stop at (0 = none) */
+	double work_start;	/* share done when this run started (resume) */
+	double work_before; /* share done before this pass */
+	double work_pass;	/* share this pass adds */
+	int spp_limit;
+} t_pass_plan;
+
+/* Progress of one pass: shares of the whole render, not just this pass */
+typedef struct s_pass_progress
+{
+	const t_pass_plan *plan;
+	long pixels_done;
+	long pixel_total;
+	int spp_shown;
+	double start_time;
+} t_pass_progress;
+
+static inline void camera_print_progress(const t_pass_progress *p, long done, int tiles_left)
+{
+	const t_pass_plan *plan = p->plan;
+	double frac = plan->work_before + plan->work_pass * (double)done / (double)p->pixel_total;
+	if (frac > 1.0)
+		frac = 1.0;
+	double elapsed = stats_wall_time() - p->start_time;
+	double frac_run = frac - plan->work_start;
+	double remain = (frac_run > 0.0) ? elapsed / frac_run * (1.0 - frac) : -1.0;
+	char elapsed_buf[32], eta_buf[32];
+	format_time(elapsed, elapsed_buf, sizeof(elapsed_buf));
+	format_time(remain, eta_buf, sizeof(eta_buf));
+	fprintf(stderr, "\rRendering: %5.1f%% | spp %d/%d | tiles left: %4d | elapsed: %s | ETA: %s ",
+			100.0 * frac, p->spp_shown, plan->spp_limit, tiles_left, elapsed_buf, eta_buf);
+}
+
+/* What the farm workers and coordinator need to render one pass */
+typedef struct s_farm_pass
+{
+	const t_camera *camera;
+	const t_hittable_list *world;
+	const t_pass_plan *plan;
+	t_render_stats *stats;
+	t_pass_progress progress;
+	t_accum *acc;
+	t_image_writer *out;
+} t_farm_pass;
+
+static inline void camera_farm_render_tile(void *ctx, const t_tile *tile, t_accum *acc)
+{
+	t_farm_pass *fp = (t_farm_pass *)ctx;
+	camera_render_tile(fp->camera, fp->world, tile, acc, fp->plan->samples, fp->plan->deadline, fp->stats);
+}
+
+static inline void camera_farm_progress(void *ctx, const t_tile *tile, int tiles_left)
+{
+	t_farm_pass *fp = (t_farm_pass *)ctx;
+	if (fp->out)
+		image_writer_put_tile(fp->out, fp->acc, tile);
+	fp->progress.pixels_done += tile_area(tile);
+	camera_print_progress(&fp->progress, fp->progress.pixels_done, tiles_left);
+}
+
+/* Render plan->samples more samples of every active pixel with the tile scheduler,
+   or with camera->workers processes (farm.h). Finished tiles go to out as
+   they come in (NULL = no output).
+   With acc NULL (bucket mode) each thread renders its tiles into a bucket of
+   its own, a tile at a time, and out gets the tile before the bucket is
+   reused: memory does not grow with the image. */
+static inline bool camera_render_pass(const t_camera *camera, const t_hittable_list *world,
+									  t_accum *acc, const t_pass_plan *plan,
+									  t_render_stats *stats, double start_time, t_image_writer *out)
+{
+	t_tile window = camera_crop_window(camera);
+	int spp_shown = (acc ? acc->samples : 0) + plan->samples;
+	t_pass_progress progress = {plan, 0, (long)tile_area(&window), spp_shown, start_time};
+
+	/* Tiles of the crop window in the camera's order, one deque per thread,
+	   stealing when idle */
+	int tile_count = 0;
+	t_tile *tiles = tile_list_create(camera->image_width, camera->image_height, camera->tile_size,
+									 camera->tile_order, &tile_count);
+	if (tiles)
+		tile_count = tile_list_clip(tiles, tile_count, &window);
+	/* Training passes stay in this process: the guide learns from every path */
+	if (tiles && acc && camera->workers > 1 && !(camera->guide && camera->guide->training))
+	{
+		t_farm_pass fp = {camera, world, plan, stats, progress, acc, out};
+		t_farm_job job = {camera_farm_render_tile, camera_farm_progress, &fp};
+		bool ok = farm_render(acc, tiles, tile_count, camera->workers, &job);
+		free(tiles);
+		return ok;
+	}
+#ifdef _OPENMP
+	int thread_count = omp_get_max_threads();
+#else
+	int thread_count = 1;
+#endif
+	t_tile_scheduler sched;
+	if (!tiles || !tile_scheduler_init(&sched, tiles, tile_count, thread_count))
+	{
+		fprintf(stderr, "Error: cannot allocate render tiles\n");
+		free(tiles);
+		return false;
+	}
+	free(tiles);
 
 	/* Parallel render into buffer with live progress */
-#pragma omp parallel for schedule(dynamic, 1)
-	for (int j = 0; j < h; ++j)
+	bool ok = true;
+#pragma omp parallel num_threads(thread_count)
 	{
-		for (int i = 0; i < w; ++i)
+#ifdef _OPENMP
+		int tid = omp_get_thread_num();
+#else
+		int tid = 0;
+#endif
+		t_accum bucket;
+		bool bucketed = !acc;
+		if (bucketed && !accum_bucket_init(&bucket, camera->tile_size * camera->tile_size, plan->samples))
 		{
-			t_color pixel_color = vec3_zero();
-			for (int s_j = 0; s_j < camera->sqrt_spp; ++s_j)
+#pragma omp atomic write
+			ok = false;
+		}
+		t_tile tile;
+		while (tile_scheduler_next(&sched, tid, &tile))
+		{
+			t_accum *target = acc;
+			bool rendered;
+#pragma omp atomic read
+			rendered = ok;
+			if (bucketed && rendered)
 			{
-				for (int s_i = 0; s_i < camera->sqrt_spp; ++s_i)
-				{
-					t_ray r = get_ray_stratified(camera, i, j, s_i, s_j);
-					t_vec3 sample_color = ray_color_with_background(&r, world, camera->max_depth, &camera->background);
-					pixel_color = vec3_add(&pixel_color, &sample_color);
-				}
+				accum_bucket_place(&bucket, tile.x0, tile.y0, tile.x1 - tile.x0, tile.y1 - tile.y0);
+				target = &bucket;
 			}
-			/* Store in correct scanline order (j=0 is top row in PPM) */
-			pixels[j * w + i] = vec3_mul_scalar(&pixel_color, camera->pixel_samples_scale);
-		}
+			if (target)
+				camera_render_tile(camera, world, &tile, target, plan->samples, plan->deadline, stats);
+			if (target && out)
+				image_writer_put_tile(out, target, &tile);
+			tile_scheduler_done(&sched);
 
-		int done;
+			long done;
 #pragma omp atomic capture
-		done = ++rows_done;
-		if ((done & 7) == 0)
-		{
-			double elapsed = (double)(clock() - start_clock) / (double)CLOCKS_PER_SEC;
-			double per_line = (done > 0) ? (elapsed / (double)done) : 0.0;
-			double remain = (per_line > 0.0) ? per_line * (double)(h - done) : -1.0;
-			double pct = (100.0 * (double)done) / (double)h;
-			char elapsed_buf[32], eta_buf[32];
-			format_time(elapsed, elapsed_buf, sizeof(elapsed_buf));
-			format_time(remain, eta_buf, sizeof(eta_buf));
+			done = progress.pixels_done += tile_area(&tile);
+			int tiles_left;
+#pragma omp atomic read
+			tiles_left = sched.pending;
 #pragma omp critical
 			{
-				fprintf(stderr, "\rRendering: %5.1f%% | rows left: %4d | elapsed: %s | ETA: %s ",
-						pct, (h - done), elapsed_buf, eta_buf);
+				camera_print_progress(&progress, done, tiles_left);
 			}
 		}
+		if (bucketed)
+			accum_destroy(&bucket);
 	}
+	tile_scheduler_destroy(&sched);
+	if (!ok)
+		fprintf(stderr, "\nError: cannot allocate render buckets\n");
+	return ok;
+}
+
+/* Where a crop render goes: the window alone, or pasted over a backdrop */
+typedef struct s_crop_output
+{
+	t_tile window;
+	unsigned char *backdrop; /* 8-bit RGB of the whole image, NULL = window alone */
+	bool compress;			 /* EXR tiles ZIP-compressed */
+} t_crop_output;
+
+/* Write acc's current estimate, or `pixels` when given (width * height
+   colours of the same size), in the format filename names. With a crop
+   only its window is written, alone or (8-bit formats) over the crop's
+   backdrop. */
+static inline bool camera_write_pixels(const t_accum *acc, const t_vec3 *pixels, const t_crop_output *crop,
+									   const char *filename)
+{
+	return image_write(acc, pixels, crop ? &crop->window : NULL, crop ? crop->backdrop : NULL,
+					   crop ? crop->compress : true, filename);
+}
+
+/* Write the accumulator's current estimate */
+static inline bool camera_write_image(const t_accum *acc, const t_crop_output *crop, const char *filename)
+{
+	return camera_write_pixels(acc, NULL, crop, filename);
+}
 
-	fprintf(stderr, "\nStarting write...\n");
+/* <stem><suffix><extension of filename>, e.g. render.png -> render_noisy.png */
+static inline void camera_sibling_path(char *out, size_t size, const char *filename, const char *suffix,
+									   const char *extension)
+{
+	const char *ext = strrchr(filename, '.');
+	const char *slash = strrchr(filename, '/');
+	if (ext && slash && ext < slash)
+		ext = NULL;
+	int stem = ext ? (int)(ext - filename) : (int)strlen(filename);
+	snprintf(out, size, "%.*s%s%s", stem, filename, suffix, extension ? extension : (ext ? ext : ""));
+}
 
-	/* Write buffered image sequentially (binary P6, one fwrite per scanline) */
-	size_t rowbuf_sz = (size_t)w * 3;
-	unsigned char *rowbuf = (unsigned char *)malloc(rowbuf_sz);
-	if (!rowbuf)
+/* Denoise acc and write the result to filename (the unfiltered image is
+   written next to it as *_noisy while rendering) */
+static inline bool camera_write_denoised(const t_accum *acc, const t_crop_output *crop, const char *filename,
+										 int tile_size)
+{
+	t_vec3 *pixels = (t_vec3 *)malloc((size_t)acc->width * (size_t)acc->height * sizeof(t_vec3));
+	double start = stats_wall_time();
+	bool ok = pixels && denoise_accum(acc, pixels, tile_size);
+	if (!ok)
 	{
-		fprintf(stderr, "Error: cannot allocate row buffer\n");
+		fprintf(stderr, "Warning: denoising failed, writing the unfiltered image\n");
 		free(pixels);
-		fclose(ppm_file);
+		return camera_write_image(acc, crop, filename);
+	}
+	fprintf(stderr, "Denoised in %.2fs\n", stats_wall_time() - start);
+	ok = camera_write_pixels(acc, pixels, crop, filename);
+	free(pixels);
+	return ok;
+}
+
+/* Seconds the output camera_render writes once sampling is over should
+   take: the plain image is written now (a preview, replaced at the end) and
+   timed, once per image the end writes, AOVs likewise, and the denoiser is
+   estimated from a small probe. None of it depends on the sample count, so
+   a timed render measures it after the calibration pass. streamed is the
+   path the last pass already wrote, if any. */
+static inline double camera_time_output(const t_camera *camera, const t_accum *acc, const t_crop_output *crop,
+										const char *filename, const char *noisy, const char *stem,
+										const char *streamed)
+{
+	bool denoise = camera->denoise && acc->albedo;
+	const char *path = denoise ? noisy : filename;
+	int writes = (streamed != path) + (denoise ? 1 : 0);
+	double seconds = 0.0;
+	double start = stats_wall_time();
+	if (writes > 0 && camera_write_image(acc, crop, path))
+		seconds = (stats_wall_time() - start) * (double)writes;
+	if (camera->aovs)
+	{
+		start = stats_wall_time();
+		aov_write_layers(acc, camera->aovs, stem);
+		seconds += stats_wall_time() - start;
+	}
+	if (denoise)
+		seconds += denoise_estimate_seconds(acc->width, acc->height);
+	return seconds;
+}
+
+/* Set by SIGINT during a progressive render: finish the pass, checkpoint, stop */
+static volatile sig_atomic_t g_render_interrupted = 0;
+
+static inline void camera_on_interrupt(int sig)
+{
+	(void)sig;
+	g_render_interrupted = 1;
+}
+
+/* Running state of camera_render's pass loop */
+typedef struct s_render_run
+{
+	bool adaptive;		   /* adaptive_error > 0 */
+	bool timed;			   /* time_budget > 0 */
+	int total;			   /* spp of the image (uniform), average budget (adaptive) */
+	int spp_limit;		   /* per-pixel cap */
+	int step;			   /* samples per pass after the first */
+	int last_pass;		   /* samples of the previous pass */
+	long active;		   /* pixels still sampling */
+	long spent;			   /* samples taken over the image */
+	long pixels;		   /* pixels in the crop window */
+	double start;		   /* wall time camera_render started */
+	double deadline;	   /* timed: wall time the image must be written by */
+	double render_seconds; /* timed: wall time spent in passes by this run */
+	long render_samples;   /* timed: samples taken by those passes */
+	double write_seconds;  /* timed: last intermediate image write */
+	double output_seconds; /* timed: final output, measured after the calibration pass */
+	double work_start;	   /* share of the render done when this run started */
+	int guide_pass;		   /* guiding: samples of the next training pass (0 = training over) */
+} t_render_run;
+
+/* Share of the render done so far */
+static inline double camera_run_work(const t_render_run *run, const t_accum *acc, double now)
+{
+	if (run->timed)
+		return (now - run->start) / (run->deadline - run->start);
+	if (run->adaptive)
+		return (double)run->spent / ((double)run->total * (double)run->pixels);
+	return (double)acc->samples / (double)run->total;
+}
+
+/* Plan the next pass. Returns false once sampling is over: every sample
+   taken, every pixel converged, the per-pixel cap, the sample budget
+   (adaptive) or the deadline (timed) reached. */
+static inline bool camera_plan_pass(const t_camera *camera, const t_accum *acc,
+									const t_render_run *run, t_pass_plan *plan)
+{
+	double now = stats_wall_time();
+	int n;
+	if (!run->adaptive && !run->timed)
+	{
+		if (acc->samples >= run->total)
+			return false;
+		n = (run->step < run->total - acc->samples) ? run->step : run->total - acc->samples;
+	}
+	else
+	{
+		if (run->active <= 0 || acc->samples >= run->spp_limit)
+			return false;
+		if (acc->samples == 0)
+			n = run->timed ? 1 : camera->adaptive_min_samples; /* timed: calibration pass */
+		else
+			n = run->step;
+		if (n > run->spp_limit - acc->samples)
+			n = run->spp_limit - acc->samples;
+	}
+	if (run->adaptive && !run->timed)
+	{
+		/* Do not overshoot the sample budget on the last pass */
+		long budget = (long)run->total * run->pixels;
+		if (run->spent >= budget)
+			return false;
+		long left = (budget - run->spent) / run->active;
+		if (left < n)
+			n = (left > 0) ? (int)left : 1;
+	}
+	double pass_seconds = 0.0;
+	if (run->timed)
+	{
+		/* Size the pass from the measured throughput so it ends before the
+		   deadline, leaving room for the output; grow at most 2x per pass
+		   since early estimates are noisy */
+		double left = run->deadline - run->write_seconds - run->output_seconds - now;
+		if (left <= 0.0)
+			return false;
+		if (run->render_samples > 0)
+		{
+			double per_sample = run->render_seconds / (double)run->render_samples;
+			double fit = left * TIME_BUDGET_SAFETY / (per_sample * (double)run->active);
+			if (fit < 1.0)
+				return false;
+			if (run->last_pass > 0 && n > 2 * run->last_pass)
+				n = 2 * run->last_pass;
+			if ((double)n > fit)
+				n = (int)fit;
+			pass_seconds = per_sample * (double)run->active * (double)n;
+		}
+	}
+	if (run->guide_pass > 0 && n > run->guide_pass)
+		n = run->guide_pass;
+	plan->samples = n;
+	plan->deadline = run->timed ? run->deadline - run->write_seconds - run->output_seconds : 0.0;
+	plan->work_start = run->work_start;
+	plan->work_before = camera_run_work(run, acc, now);
+	if (run->timed)
+		plan->work_pass = pass_seconds / (run->deadline - run->start);
+	else if (run->adaptive)
+		plan->work_pass = (double)n * (double)run->active / ((double)run->total * (double)run->pixels);
+	else
+		plan->work_pass = (double)n / (double)run->total;
+	plan->spp_limit = run->spp_limit;
+	return true;
+}
+
+/* Out-of-core render: each tile gets all its samples at once in a bucket of
+   its rendering thread and goes straight to the image writer, so memory is
+   a few tiles per thread whatever the image size (PNG output still keeps
+   the frame's 8-bit pixels for its encoder). Everything that needs the
+   whole accumulator is unavailable: passes, adaptive and timed sampling,
+   checkpoints, denoising, AOVs, worker processes and path guiding. */
+static inline void camera_render_buckets(const t_camera *camera, const t_hittable_list *world,
+										 const char *filename)
+{
+	double start = stats_wall_time();
+	int w = camera->image_width;
+	int h = camera->image_height;
+	int total = camera->sqrt_spp * camera->sqrt_spp;
+	if (camera->pass_samples > 0 || camera->adaptive_error > 0.0 || camera->time_budget > 0.0
+		|| camera->resume || camera->denoise || camera->aovs || camera->workers > 1 || camera->guiding)
+		fprintf(stderr, "Warning: bucket mode renders every pixel in one go; passes, adaptive and timed "
+						"sampling, checkpoints, denoising, AOVs, workers and guiding are ignored\n");
+	if (image_format_from_path(filename) == IMAGE_FORMAT_PNG)
+		fprintf(stderr, "Warning: PNG output keeps the whole image in memory (3 bytes per pixel)\n");
+	if (camera->sampler == SAMPLER_BLUE_NOISE && !sampler_blue_noise_prepare())
+		fprintf(stderr, "Warning: cannot build the blue-noise mask, using random samples\n");
+
+	t_tile window = camera_crop_window(camera);
+	unsigned char *backdrop = NULL;
+	if (camera->crop_backdrop && tile_area(&window) < w * h
+		&& !image_format_is_hdr(image_format_from_path(filename)))
+	{
+		backdrop = image_read_rgb(camera->crop_backdrop, w, h);
+		if (!backdrop)
+			fprintf(stderr, "Warning: cannot read a %dx%d backdrop from %s, writing the crop alone\n",
+					w, h, camera->crop_backdrop);
+	}
+	t_render_stats stats;
+	render_stats_init(&stats, w, h, g_object_count);
+	t_pass_plan plan = {total, 0.0, 0.0, 0.0, 1.0, total};
+	t_image_writer out;
+	fprintf(stderr, "Starting render...\n");
+	bool ok = image_writer_open(&out, w, h, &window, backdrop, camera->output_compress, filename);
+	free(backdrop);
+	if (ok)
+	{
+		out.samples = total;
+		ok = camera_render_pass(camera, world, NULL, &plan, &stats, start, &out);
+		ok = image_writer_close(&out, ok);
+	}
+	stats.seconds = stats_wall_time() - start;
+	fprintf(stderr, "\n");
+	if (ok)
+	{
+		fprintf(stderr, "\rDone.  Elapsed: %.1fs\n", stats_wall_time() - start);
+		fprintf(stderr, "Rendered image saved to: %s\n", filename);
+	}
+	char heatmap[512];
+	camera_sibling_path(heatmap, sizeof(heatmap), filename, "_heatmap", ".ppm");
+	if (render_stats_write_heatmap(&stats, heatmap))
+		fprintf(stderr, "Cost heatmap saved to: %s\n", heatmap);
+	render_stats_print(&stats);
+	render_stats_destroy(&stats);
+}
+
+/* Render function with stratified sampling. With pass_samples > 0 the image
+   is refined pass by pass: after each pass it is rewritten and, every
+   checkpoint_every passes, the accumulator is saved so a later run with
+   resume = true continues where this one stopped.
+   With adaptive_error > 0 the same spp * pixels budget is spread unevenly:
+   pixels whose luminance is known to within adaptive_error stop sampling
+   and the others keep going, up to adaptive_max_samples each.
+   With time_budget > 0 the render runs for that many wall-clock seconds
+   instead: a 1 spp pass measures throughput and the cost of the final
+   output (camera_time_output), later passes are sized to fit the time left
+   and the output is written before the deadline.
+   With a crop window only its pixels are sampled, exactly as in the full
+   render, and written alone or pasted over crop_backdrop.
+   With workers > 1 every pass is shared among that many forked processes;
+   traversal statistics then only cover the coordinator.
+   With guiding, the first GUIDE_TRAINING_SHARE of the samples (of the time
+   budget when timed) are taken in passes of 1, 2, 4... spp that train the
+   guide (guide.h) as they render; later passes sample bounces with what it
+   learned.
+   The image goes to output_path (PPM, PNG, PFM or EXR, see image_writer.h),
+   written tile by tile while its pass renders; AOVs and sample maps go next
+   to it. bucket_mode (or a whole-image buffer that cannot be allocated)
+   switches to camera_render_buckets. */
+static inline void camera_render(const t_camera *camera, FILE *out, const t_hittable_list *world)
+{
+	(void)out;
+	if (!camera)
+		return;
+	setvbuf(stderr, NULL, _IONBF, 0); /* unbuffered progress */
+
+	t_render_run run;
+	memset(&run, 0, sizeof(run));
+	run.start = stats_wall_time();
+
+	const char *filename = camera->output_path ? camera->output_path : "../output/render.ppm";
+	char noisy[512];
+	char stem[512];
+	char side[512];
+	camera_sibling_path(noisy, sizeof(noisy), filename, "_noisy", NULL);
+	camera_sibling_path(stem, sizeof(stem), filename, "", "");
+
+	if (camera->bucket_mode)
+	{
+		camera_render_buckets(camera, world, filename);
 		return;
 	}
+	int w = camera->image_width;
+	int h = camera->image_height;
+	run.total = camera->sqrt_spp * camera->sqrt_spp;
+	t_accum acc;
+	if (!accum_init(&acc, w, h, run.total))
+	{
+		fprintf(stderr, "Warning: cannot allocate the pixel buffer, rendering in buckets\n");
+		camera_render_buckets(camera, world, filename);
+		return;
+	}
+
+	if (camera->sampler == SAMPLER_BLUE_NOISE && !sampler_blue_noise_prepare())
+		fprintf(stderr, "Warning: cannot build the blue-noise mask, using random samples\n");
 
-	for (int j = 0; j < h; ++j)
+	/* Per-pixel counts let adaptive sampling stop pixels and let a timed
+	   render cut a pass short at the deadline */
+	run.adaptive = camera->adaptive_error > 0.0;
+	run.timed = camera->time_budget > 0.0;
+	if ((run.adaptive || run.timed) && !accum_enable_pixel_stats(&acc))
 	{
-		unsigned char *ptr = rowbuf;
-		for (int i = 0; i < w; ++i)
-			ptr = write_color_to_buf_bin(ptr, &pixels[j * w + i]);
-		fwrite(rowbuf, 1, rowbuf_sz, ppm_file);
+		fprintf(stderr, "Warning: cannot allocate per-pixel sample buffers, sampling uniformly\n");
+		run.adaptive = false;
+		run.timed = false;
+	}
+	/* The denoiser needs each pixel's variance and first-hit guides */
+	if (camera->denoise && ((!acc.count && !accum_enable_pixel_stats(&acc)) || !accum_enable_guides(&acc)))
+		fprintf(stderr, "Warning: cannot allocate denoiser buffers, writing the unfiltered image\n");
+	if (camera->aovs && ((!acc.albedo && !accum_enable_guides(&acc)) || !accum_enable_layers(&acc)))
+		fprintf(stderr, "Warning: cannot allocate AOV buffers, writing the beauty image only\n");
+	if (run.adaptive)
+		run.spp_limit = (camera->adaptive_max_samples > 0) ? camera->adaptive_max_samples : 4 * run.total;
+	else
+		run.spp_limit = run.total;
+	bool progressive = camera->pass_samples > 0
+					   && (run.adaptive || run.timed || camera->pass_samples < run.total);
+	if (progressive)
+		run.step = camera->pass_samples;
+	else if (run.adaptive)
+		run.step = camera->adaptive_min_samples;
+	else
+		run.step = run.timed ? run.spp_limit : run.total;
+	if (run.step < 1)
+		run.step = 1;
+	if (run.timed)
+		run.deadline = run.start + (double)camera->time_budget * (1.0 - TIME_BUDGET_RESERVE);
 
-		if ((j & 31) == 0)
+	const char *ckpt = camera->checkpoint_path;
+	t_accum_key key = {camera_crop_window(camera), camera->seed, (int)camera->sampler};
+	if (camera->resume && ckpt && accum_load(&acc, &key, ckpt))
+		fprintf(stderr, "Resuming from %s: %d/%d spp\n", ckpt, acc.samples, run.spp_limit);
+
+	/* Path guiding: the camera copy carries the guide into the render (a
+	   resumed render past its training share samples the BSDF only) */
+	t_camera guided;
+	t_guide guide;
+	memset(&guide, 0, sizeof(guide));
+	if (camera->guiding && (double)(acc.samples + 1) <= (double)run.total * GUIDE_TRAINING_SHARE)
+	{
+		t_aabb bounds = hittable_list_bounding_box(world);
+		if (guide_init(&guide, &bounds))
 		{
-			double elapsed = (double)(clock() - start_clock) / (double)CLOCKS_PER_SEC;
-			double pct = (100.0 * (double)j) / (double)h;
-			double per_line = (j > 0) ? (elapsed / (double)j) : 0.0;
-			double remain = (per_line > 0.0) ? per_line * (double)(h - j) : -1.0;
-			char elapsed_buf[32], eta_buf[32];
-			format_time(elapsed, elapsed_buf, sizeof(elapsed_buf));
-			format_time(remain, eta_buf, sizeof(eta_buf));
-			fprintf(stderr, "\rWriting : %5.1f%% | lines left: %4d | elapsed: %s | ETA: %s ",
-					pct, (h - j), elapsed_buf, eta_buf);
+			guided = *camera;
+			guided.guide = &guide;
+			camera = &guided;
+			run.guide_pass = 1;
 		}
+		else
+			fprintf(stderr, "Warning: cannot set up path guiding, sampling the BSDF only\n");
 	}
-	double total = (double)(clock() - start_clock) / (double)CLOCKS_PER_SEC;
-	fprintf(stderr, "\rDone.  Elapsed: %.1fs\n", total);
-	fprintf(stderr, "Rendered image saved to: %s\n", filename);
 
-	free(rowbuf);
-	free(pixels);
-	fclose(ppm_file);
+	/* Crop window: pixels outside it are never sampled. The backdrop is read
+	   now, before progressive writes replace a previous render at its path. */
+	t_crop_output crop = {key.window, NULL, camera->output_compress};
+	run.pixels = (long)tile_area(&crop.window);
+	if (camera->crop_backdrop && run.pixels < (long)w * (long)h
+		&& !image_format_is_hdr(image_format_from_path(filename)))
+	{
+		crop.backdrop = image_read_rgb(camera->crop_backdrop, w, h);
+		if (!crop.backdrop)
+			fprintf(stderr, "Warning: cannot read a %dx%d backdrop from %s, writing the crop alone\n",
+					w, h, camera->crop_backdrop);
+	}
+	if (acc.count)
+		for (int j = 0; j < h; ++j)
+			for (int i = 0; i < w; ++i)
+				if (i < crop.window.x0 || i >= crop.window.x1 || j < crop.window.y0 || j >= crop.window.y1)
+					acc.converged[(size_t)j * (size_t)w + (size_t)i] = 1;
+
+	/* Opt-in traversal statistics (no-ops unless built with RT_STATS) */
+	t_render_stats stats;
+	render_stats_init(&stats, w, h, g_object_count);
+	double stats_start = stats_wall_time();
+
+	void (*prev_handler)(int) = SIG_DFL;
+	if (progressive)
+	{
+		g_render_interrupted = 0;
+		prev_handler = signal(SIGINT, camera_on_interrupt);
+	}
+
+	fprintf(stderr, "Starting render...\n");
+	run.active = run.pixels;
+	if (acc.count)
+		run.active = accum_update_convergence(&acc, camera->adaptive_error,
+											  camera->adaptive_min_samples, &run.spent);
+	run.work_start = run.timed ? 0.0 : camera_run_work(&run, &acc, run.start);
+	int pass = 0;
+	bool ok = true;
+	bool unsaved = false;
+	/* Passes whose image is kept (every pass when progressive, else the last
+	   of a uniform render) stream it out tile by tile; the unfiltered image
+	   goes to *_noisy when it is denoised afterwards */
+	const char *stream_path = (camera->denoise && acc.albedo) ? noisy : filename;
+	const char *streamed = NULL;
+	t_pass_plan plan;
+	while (ok && !g_render_interrupted && camera_plan_pass(camera, &acc, &run, &plan))
+	{
+		t_image_writer out;
+		bool stream = progressive || (!run.adaptive && !run.timed && acc.samples + plan.samples >= run.total);
+		stream = stream && image_writer_open(&out, w, h, &crop.window, crop.backdrop, crop.compress,
+											  stream_path);
+		if (stream)
+			out.samples = acc.samples + plan.samples;
+		double pass_start = stats_wall_time();
+		ok = camera_render_pass(camera, world, &acc, &plan, &stats, run.start, stream ? &out : NULL);
+		double pass_seconds = stats_wall_time() - pass_start;
+		run.render_seconds += pass_seconds;
+		double write_start = stats_wall_time();
+		streamed = (stream && image_writer_close(&out, ok)) ? stream_path : NULL;
+		if (!ok)
+			break;
+		acc.samples += plan.samples;
+		run.last_pass = plan.samples;
+		if (run.guide_pass > 0)
+		{
+			guide_update(&guide, plan.samples);
+			run.guide_pass *= 2;
+			/* Timed: the next pass, twice as long, must end within the
+			   training share of the budget */
+			bool trained = run.timed ? stats_wall_time() + 2.0 * pass_seconds
+										   > run.start + (double)camera->time_budget * GUIDE_TRAINING_SHARE
+									 : acc.samples + run.guide_pass > (double)run.total * GUIDE_TRAINING_SHARE;
+			if (trained)
+			{
+				run.guide_pass = 0;
+				guide.training = false;
+			}
+		}
+		if (acc.count)
+		{
+			long before = run.spent;
+			run.active = accum_update_convergence(&acc, camera->adaptive_error,
+												  camera->adaptive_min_samples, &run.spent);
+			run.render_samples += run.spent - before;
+		}
+		++pass;
+		double write_end = stats_wall_time();
+		if (run.timed && pass == 1)
+			run.output_seconds = camera_time_output(camera, &acc, &crop, filename, noisy, stem, streamed);
+		if (!progressive)
+			continue;
+
+		/* Intermediate image every pass (streamed), accumulator every few passes */
+		run.write_seconds = write_end - write_start;
+		unsaved = true;
+		if (ckpt && camera->checkpoint_every > 0 && pass % camera->checkpoint_every == 0)
+		{
+			if (!accum_save(&acc, &key, ckpt))
+				fprintf(stderr, "\nWarning: cannot write checkpoint %s\n", ckpt);
+			unsaved = false;
+		}
+	}
+	if (progressive && ckpt && unsaved && !accum_save(&acc, &key, ckpt))
+		fprintf(stderr, "\nWarning: cannot write checkpoint %s\n", ckpt);
+	if (progressive)
+		signal(SIGINT, prev_handler == SIG_ERR ? SIG_DFL : prev_handler);
+	if (g_render_interrupted)
+		fprintf(stderr, "\nInterrupted at %d/%d spp, checkpoint: %s", acc.samples,
+				run.spp_limit, ckpt ? ckpt : "(none)");
+
+	stats.seconds = stats_wall_time() - stats_start;
+	fprintf(stderr, "\n");
+	bool denoise = camera->denoise && acc.albedo && !g_render_interrupted;
+	bool written = ok;
+	if (ok && denoise)
+	{
+		fprintf(stderr, "Starting write...\n");
+		if (streamed == noisy || camera_write_image(&acc, &crop, noisy))
+			fprintf(stderr, "Unfiltered image saved to: %s\n", noisy);
+		written = camera_write_denoised(&acc, &crop, filename, camera->tile_size);
+	}
+	else if (ok && streamed != filename)
+	{
+		fprintf(stderr, "Starting write...\n");
+		written = camera_write_image(&acc, &crop, filename);
+	}
+	if (written)
+	{
+		double elapsed = stats_wall_time() - run.start;
+		fprintf(stderr, "\rDone.  Elapsed: %.1fs\n", elapsed);
+		if (run.timed)
+			fprintf(stderr, "Time budget: %.1fs, %d passes, %.1f spp average\n",
+					(double)camera->time_budget, pass, (double)run.spent / (double)run.pixels);
+		fprintf(stderr, "Rendered image saved to: %s\n", filename);
+	}
+	if (ok && camera->aovs)
+	{
+		int layers = aov_write_layers(&acc, camera->aovs, stem);
+		if (layers > 0)
+			fprintf(stderr, "%d AOV layer(s) saved to: %s_*.pfm\n", layers, stem);
+	}
+	if (run.adaptive)
+	{
+		accum_print_sample_summary(&acc, &crop.window);
+		camera_sibling_path(side, sizeof(side), filename, "_samples", ".ppm");
+		if (accum_write_sample_map(&acc, side))
+			fprintf(stderr, "Sample-count map saved to: %s\n", side);
+	}
+
+	camera_sibling_path(side, sizeof(side), filename, "_heatmap", ".ppm");
+	if (render_stats_write_heatmap(&stats, side))
+		fprintf(stderr, "Cost heatmap saved to: %s\n", side);
+	render_stats_print(&stats);
+	render_stats_destroy(&stats);
+	if (camera->guide)
+		fprintf(stderr, "Path guiding: %d training passes, %d cells, %ld directional nodes\n",
+				guide.passes, guide.cell_count, guide_dtree_nodes(&guide));
+	guide_destroy(&guide);
+	free(crop.backdrop);
+	accum_destroy(&acc);
 }
 
 #endif
\ No newline at end of file
@@ -39,6 +39,12 @@ static inline real_t vec3_max_component(const t_vec3 *v)
 	return m;
 }
 
+/* Rec. 709 luminance of a linear color */
+static inline real_t color_luminance(const t_vec3 *c)
+{
+	return (real_t)0.2126 * c->x + (real_t)0.7152 * c->y + (real_t)0.0722 * c->z;
+}
+
 /* linear -> gamma (gamma = 2.0) with safe handling of negative inputs */
 static inline real_t linear_to_gamma(real_t v)
 {
@@ -49,4 +49,8 @@
 #include "color.h"
 #include "camera.h"
 
+/* Light sampling needs the primitives and the camera's forward declarations */
+#include "triangle.h"
+#include "light.h"
+
 #endif
\ No newline at end of file
@@ -44,6 +44,7 @@ static inline bool constant_medium_hit(const t_constant_medium *medium, const t_
 {
 	if (!medium || !rec)
 		return false;
+	RT_STAT_PRIM(STAT_PRIM_MEDIUM);
 
 	/* Get first intersection with boundary */
 	t_hit_record rec1;
@@ -0,0 +1,21 @@
+/* ============================================================================ */
+/*                          CYLINDER CALLBACKS                                  */
+/* ============================================================================ */
+
+#include "common.h"
+#include "cylinder.h"
+
+/* Thread-local current cylinder for hit_noobj */
+static __thread const t_cylinder *g_current_cylinder = NULL;
+
+void set_current_cylinder(const void *obj)
+{
+	g_current_cylinder = (const t_cylinder *)obj;
+}
+
+bool cylinder_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
+{
+	if (!g_current_cylinder)
+		return false;
+	return cylinder_hit(g_current_cylinder, r, rayt, rec);
+}
@@ -21,6 +21,8 @@
 #include "aabb.h"
 #include <math.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* Forward declaration */
 typedef struct s_material t_material;
@@ -34,8 +36,25 @@ typedef struct s_cylinder
 	real_t height;
 	t_material *mat;
 	t_aabb bbox;
+	t_vec3 frame_u; /* local x axis, perpendicular to axis */
+	t_vec3 frame_v; /* local y axis, completes the frame */
+	real_t radius2; /* radius * radius */
 } t_cylinder;
 
+/* Orthonormal frame around a unit axis (same basis as cylinder_get_uv) */
+static inline void axis_frame(const t_vec3 *axis, t_vec3 *frame_u, t_vec3 *frame_v)
+{
+	t_vec3 ref;
+	if (fabsl((long double)axis->y) > (long double)0.9)
+		ref = vec3_create((real_t)1.0, (real_t)0.0, (real_t)0.0);
+	else
+		ref = vec3_create((real_t)0.0, (real_t)1.0, (real_t)0.0);
+
+	t_vec3 u = cross(axis, &ref);
+	*frame_u = unit_vector(&u);
+	*frame_v = cross(axis, frame_u);
+}
+
 /* Create cylinder */
 static inline t_cylinder cylinder_create(const t_point3 *base, const t_vec3 *axis,
 										 real_t radius, real_t height, t_material *mat)
@@ -46,6 +65,8 @@ static inline t_cylinder cylinder_create(const t_point3 *base, const t_vec3 *axi
 	cyl.radius = (radius > 0) ? radius : (real_t)0.1;
 	cyl.height = (height > 0) ? height : (real_t)1.0;
 	cyl.mat = mat;
+	cyl.radius2 = cyl.radius * cyl.radius;
+	axis_frame(&cyl.axis, &cyl.frame_u, &cyl.frame_v);
 
 	/* Compute bounding box by finding extrema of cylinder */
 	/* Top center */
@@ -120,154 +141,138 @@ static inline void cylinder_get_uv(const t_cylinder *cyl, const t_vec3 *p,
 	*u = (theta + (real_t)PI) / ((real_t)2.0 * (real_t)PI);
 }
 
-/* Ray-cylinder intersection */
-static inline bool cylinder_hit(const t_cylinder *cyl, const t_ray *r,
-								t_interval rayt, t_hit_record *rec)
+/* Which boundary of a capped primitive produced a hit */
+typedef enum e_cap_surface
 {
-	if (!cyl || !r || !rec)
-		return false;
-
-	const real_t EPSILON = (real_t)1e-8;
+	SURFACE_SIDE = 0,
+	SURFACE_CAP_BOTTOM = 1,
+	SURFACE_CAP_TOP = 2
+} t_cap_surface;
 
-	/* Transform ray to cylinder's local space */
+/* Express the ray in the cylinder's local frame (x = frame_u, y = frame_v, z = axis) */
+static inline void cylinder_to_local(const t_cylinder *cyl, const t_ray *r, t_vec3 *o, t_vec3 *d)
+{
 	t_vec3 oc = vec3_sub(&r->orig, &cyl->base);
+	*o = vec3_create(dot(&oc, &cyl->frame_u), dot(&oc, &cyl->frame_v), dot(&oc, &cyl->axis));
+	*d = vec3_create(dot(&r->dir, &cyl->frame_u), dot(&r->dir, &cyl->frame_v), dot(&r->dir, &cyl->axis));
+}
 
-	/* Components of ray perpendicular to axis */
-	real_t d_dot_axis = dot(&r->dir, &cyl->axis);
-	real_t oc_dot_axis = dot(&oc, &cyl->axis);
-
-	/* Store intermediate results before taking address */
-	t_vec3 d_axis_comp = vec3_mul_scalar(&cyl->axis, d_dot_axis);
-	t_vec3 oc_axis_comp = vec3_mul_scalar(&cyl->axis, oc_dot_axis);
-
-	t_vec3 d_perp = vec3_sub(&r->dir, &d_axis_comp);
-	t_vec3 oc_perp = vec3_sub(&oc, &oc_axis_comp);
+/* Keep a slab denominator away from zero without branching on its sign */
+static inline real_t slab_safe_denom(real_t dz)
+{
+	const real_t EPSILON = (real_t)1e-12;
+	real_t mag = (real_t)fmax((double)fabs((double)dz), (double)EPSILON);
+	return (dz < (real_t)0.0) ? -mag : mag;
+}
 
-	/* Quadratic coefficients for side surface */
-	real_t a = vec3_length_squared(&d_perp);
-	real_t half_b = dot(&oc_perp, &d_perp);
-	real_t c = vec3_length_squared(&oc_perp) - cyl->radius * cyl->radius;
+/* Local-frame cylinder kernel: the solid is the infinite cylinder x^2+y^2 <= r^2
+   clipped by the slab 0 <= z <= h. Side roots and caps are resolved in one pass by
+   intersecting the two parametric intervals; the hit is the entry point, or the exit
+   point when the origin is inside. Returns +INFINITY on miss. */
+static inline real_t cylinder_hit_local(real_t ox, real_t oy, real_t oz,
+										real_t dx, real_t dy, real_t dz,
+										real_t r2, real_t h, real_t tmin, real_t tmax,
+										int *surface)
+{
+	const real_t EPSILON = (real_t)1e-8;
 
-	bool hit_anything = false;
-	real_t closest_t = rayt.max;
-	t_vec3 closest_normal;
-	real_t closest_u = 0, closest_v = 0;
-	bool is_cap_hit = false;
+	/* Slab along the axis: both caps at once */
+	real_t inv_dz = (real_t)1.0 / slab_safe_denom(dz);
+	real_t tz0 = -oz * inv_dz;
+	real_t tz1 = (h - oz) * inv_dz;
+	real_t cap_near = (real_t)fmin((double)tz0, (double)tz1);
+	real_t cap_far = (real_t)fmax((double)tz0, (double)tz1);
+
+	/* Infinite side: a t^2 + 2 half_b t + c <= 0 */
+	real_t a = dx * dx + dy * dy;
+	real_t half_b = ox * dx + oy * dy;
+	real_t c = ox * ox + oy * oy - r2;
+	real_t disc = half_b * half_b - a * c;
+	bool parallel = (a <= EPSILON);
+	real_t sq = (real_t)sqrt(fmax((double)disc, 0.0));
+	real_t inv_a = (real_t)1.0 / (parallel ? (real_t)1.0 : a);
+	real_t side_near = parallel ? -INFINITY : (-half_b - sq) * inv_a;
+	real_t side_far = parallel ? INFINITY : (-half_b + sq) * inv_a;
+	bool side_miss = parallel ? (c > (real_t)0.0) : (disc < (real_t)0.0);
+
+	real_t t_enter = (real_t)fmax((double)side_near, (double)cap_near);
+	real_t t_exit = (real_t)fmin((double)side_far, (double)cap_far);
+	real_t t = (t_enter >= tmin) ? t_enter : t_exit;
+	bool miss = side_miss || t_enter > t_exit || t < tmin || t >= tmax;
+
+	*surface = (t == tz0) ? SURFACE_CAP_BOTTOM : ((t == tz1) ? SURFACE_CAP_TOP : SURFACE_SIDE);
+	return miss ? INFINITY : t;
+}
 
-	/* Check side surface */
-	if (a > EPSILON)
+/* Fill the hit record for a cylinder once the winning t and surface are known */
+static inline void cylinder_fill_record(const t_cylinder *cyl, const t_ray *r, real_t t,
+										int surface, t_hit_record *rec)
+{
+	t_vec3 o, d;
+	cylinder_to_local(cyl, r, &o, &d);
+	real_t px = o.x + t * d.x;
+	real_t py = o.y + t * d.y;
+	real_t pz = o.z + t * d.z;
+
+	real_t nx = (real_t)0.0, ny = (real_t)0.0, nz = (real_t)0.0;
+	if (surface == SURFACE_SIDE)
 	{
-		real_t discriminant = half_b * half_b - a * c;
-		if (discriminant >= 0)
-		{
-			real_t sqrtd = (real_t)sqrt((double)discriminant);
-
-			/* Try both roots */
-			real_t roots[2] = {(-half_b - sqrtd) / a, (-half_b + sqrtd) / a};
-			for (int i = 0; i < 2; ++i)
-			{
-				real_t t = roots[i];
-				if (t < rayt.min || t >= closest_t)
-					continue;
-
-				/* Check if hit point is within cylinder height */
-				t_vec3 hit_pt = ray_at((t_ray *)r, t);
-				t_vec3 to_hit = vec3_sub(&hit_pt, &cyl->base);
-				real_t h = dot(&to_hit, &cyl->axis);
-
-				if (h >= 0 && h <= cyl->height)
-				{
-					hit_anything = true;
-					closest_t = t;
-					is_cap_hit = false;
-
-					/* Outward normal: radial direction */
-					t_vec3 axis_comp = vec3_mul_scalar(&cyl->axis, h);
-					t_vec3 center_at_h = vec3_add(&cyl->base, &axis_comp);
-					t_vec3 outward = vec3_sub(&hit_pt, &center_at_h);
-					closest_normal = unit_vector(&outward);
-
-					cylinder_get_uv(cyl, &hit_pt, &closest_u, &closest_v);
-				}
-			}
-		}
+		nx = px / cyl->radius;
+		ny = py / cyl->radius;
+		rec->u = ((real_t)atan2((double)py, (double)px) + (real_t)PI) / ((real_t)2.0 * (real_t)PI);
+		rec->v = pz / cyl->height;
 	}
-
-	/* Check bottom cap (at base) */
-	if (fabsl((long double)d_dot_axis) > (long double)EPSILON)
+	else
 	{
-		real_t t = -oc_dot_axis / d_dot_axis;
-		if (t >= rayt.min && t < closest_t)
-		{
-			t_vec3 hit_pt = ray_at((t_ray *)r, t);
-			t_vec3 to_hit = vec3_sub(&hit_pt, &cyl->base);
-			/* Compute perpendicular distance */
-			t_vec3 axis_proj = vec3_mul_scalar(&cyl->axis, dot(&to_hit, &cyl->axis));
-			t_vec3 perp = vec3_sub(&to_hit, &axis_proj);
-			real_t dist_sq = vec3_length_squared(&perp);
-
-			if (dist_sq <= cyl->radius * cyl->radius)
-			{
-				hit_anything = true;
-				closest_t = t;
-				is_cap_hit = true;
-				closest_normal = vec3_neg(&cyl->axis);
-				closest_u = (perp.x / cyl->radius + (real_t)1.0) * (real_t)0.5;
-				closest_v = (perp.z / cyl->radius + (real_t)1.0) * (real_t)0.5;
-			}
-		}
-
-		/* Check top cap */
-		t = (cyl->height - oc_dot_axis) / d_dot_axis;
-		if (t >= rayt.min && t < closest_t)
-		{
-			t_vec3 hit_pt = ray_at((t_ray *)r, t);
-			t_vec3 top_axis_comp = vec3_mul_scalar(&cyl->axis, cyl->height);
-			t_vec3 top_center = vec3_add(&cyl->base, &top_axis_comp);
-			t_vec3 to_hit = vec3_sub(&hit_pt, &top_center);
-			real_t dist_sq = vec3_length_squared(&to_hit);
-
-			if (dist_sq <= cyl->radius * cyl->radius)
-			{
-				hit_anything = true;
-				closest_t = t;
-				is_cap_hit = true;
-				closest_normal = cyl->axis;
-				closest_u = (to_hit.x / cyl->radius + (real_t)1.0) * (real_t)0.5;
-				closest_v = (to_hit.z / cyl->radius + (real_t)1.0) * (real_t)0.5;
-			}
-		}
+		/* Caps map the world x and z of the offset from the axis */
+		nz = (surface == SURFACE_CAP_TOP) ? (real_t)1.0 : (real_t)-1.0;
+		real_t wx = px * cyl->frame_u.x + py * cyl->frame_v.x;
+		real_t wz = px * cyl->frame_u.z + py * cyl->frame_v.z;
+		rec->u = (wx / cyl->radius + (real_t)1.0) * (real_t)0.5;
+		rec->v = (wz / cyl->radius + (real_t)1.0) * (real_t)0.5;
 	}
 
-	if (!hit_anything)
-		return false;
+	/* Local normal back to world space */
+	t_vec3 nu = vec3_mul_scalar(&cyl->frame_u, nx);
+	t_vec3 nv = vec3_mul_scalar(&cyl->frame_v, ny);
+	t_vec3 nw = vec3_mul_scalar(&cyl->axis, nz);
+	t_vec3 outward = vec3_add(&nu, &nv);
+	outward = vec3_add(&outward, &nw);
 
-	rec->t = closest_t;
-	rec->p = ray_at((t_ray *)r, closest_t);
-	rec->u = closest_u;
-	rec->v = closest_v;
+	rec->t = t;
+	rec->p = ray_at((t_ray *)r, t);
 	rec->mat = cyl->mat;
 	rec->albedo = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
-	set_face_normal(rec, r, &closest_normal);
-
-	return true;
+	set_face_normal(rec, r, &outward);
 }
 
-/* Thread-local current cylinder for hit_noobj */
-static __thread const t_cylinder *g_current_cylinder = NULL;
-
-static inline void set_current_cylinder(const void *obj)
+/* Ray-cylinder intersection (side and both caps in one pass) */
+static inline bool cylinder_hit(const t_cylinder *cyl, const t_ray *r,
+								t_interval rayt, t_hit_record *rec)
 {
-	g_current_cylinder = (const t_cylinder *)obj;
-}
+	if (!cyl || !r || !rec)
+		return false;
+	RT_STAT_PRIM(STAT_PRIM_CYLINDER);
 
-static inline bool cylinder_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
-{
-	if (!g_current_cylinder)
+	t_vec3 o, d;
+	cylinder_to_local(cyl, r, &o, &d);
+
+	int surface = SURFACE_SIDE;
+	real_t t = cylinder_hit_local(o.x, o.y, o.z, d.x, d.y, d.z,
+								  cyl->radius2, cyl->height, rayt.min, rayt.max, &surface);
+	if (t == INFINITY)
 		return false;
-	return cylinder_hit(g_current_cylinder, r, rayt, rec);
+
+	cylinder_fill_record(cyl, r, t, surface, rec);
+	return true;
 }
 
+/* Callbacks for a single cylinder, defined once in cylinder.c: every
+   translation unit then shares their address, which is how
+   cylinder_pack_list recognises cylinders added anywhere */
+void set_current_cylinder(const void *obj);
+bool cylinder_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec);
+
 /* Add cylinder to hittable list */
 static inline bool hittable_list_add_cylinder(t_hittable_list *list, const t_cylinder *cyl)
 {
@@ -288,6 +293,220 @@ static inline bool hittable_list_add_cylinder(t_hittable_list *list, const t_cyl
 	return hittable_list_add_wrapper(list, &wrap);
 }
 
+/* ============================================================================ */
+/*                    CYLINDER PACKETS (4-wide BVH leaves)                      */
+/* ============================================================================ */
+
+#define CYLINDER_PACKET_WIDTH 4
+
+/* Up to four cylinders stored as structure-of-arrays: one leaf test covers all lanes.
+   Each lane holds the base and the rows of the world-to-local rotation. */
+typedef struct s_cylinder4
+{
+	real_t bx[CYLINDER_PACKET_WIDTH];
+	real_t by[CYLINDER_PACKET_WIDTH];
+	real_t bz[CYLINDER_PACKET_WIDTH];
+	real_t ux[CYLINDER_PACKET_WIDTH];
+	real_t uy[CYLINDER_PACKET_WIDTH];
+	real_t uz[CYLINDER_PACKET_WIDTH];
+	real_t vx[CYLINDER_PACKET_WIDTH];
+	real_t vy[CYLINDER_PACKET_WIDTH];
+	real_t vz[CYLINDER_PACKET_WIDTH];
+	real_t wx[CYLINDER_PACKET_WIDTH];
+	real_t wy[CYLINDER_PACKET_WIDTH];
+	real_t wz[CYLINDER_PACKET_WIDTH];
+	real_t r2[CYLINDER_PACKET_WIDTH];
+	real_t h[CYLINDER_PACKET_WIDTH];
+	int count;
+	t_cylinder cyl[CYLINDER_PACKET_WIDTH]; /* source primitives, used to shade the winner */
+	uint32_t id[CYLINDER_PACKET_WIDTH];	   /* their wrapper ids (object-id AOV) */
+	t_aabb bbox;
+} t_cylinder4;
+
+/* Build a packet from 1..4 cylinders; unused lanes are masked out by count */
+static inline void cylinder4_init(t_cylinder4 *pk, const t_cylinder *cyls, int count)
+{
+	memset(pk, 0, sizeof(*pk));
+	pk->count = (count > CYLINDER_PACKET_WIDTH) ? CYLINDER_PACKET_WIDTH : count;
+	pk->bbox = aabb_empty();
+	for (int k = 0; k < pk->count; ++k)
+	{
+		const t_cylinder *c = &cyls[k];
+		pk->cyl[k] = *c;
+		pk->bx[k] = c->base.x;
+		pk->by[k] = c->base.y;
+		pk->bz[k] = c->base.z;
+		pk->ux[k] = c->frame_u.x;
+		pk->uy[k] = c->frame_u.y;
+		pk->uz[k] = c->frame_u.z;
+		pk->vx[k] = c->frame_v.x;
+		pk->vy[k] = c->frame_v.y;
+		pk->vz[k] = c->frame_v.z;
+		pk->wx[k] = c->axis.x;
+		pk->wy[k] = c->axis.y;
+		pk->wz[k] = c->axis.z;
+		pk->r2[k] = c->radius2;
+		pk->h[k] = c->height;
+		pk->bbox = aabb_merge(&pk->bbox, &c->bbox);
+	}
+}
+
+/* Intersect all lanes at once, then shade only the closest one */
+static inline bool cylinder4_hit(const t_cylinder4 *pk, const t_ray *r,
+								 t_interval rayt, t_hit_record *rec)
+{
+	if (!pk || !r || !rec)
+		return false;
+	RT_STAT_PRIM_N(STAT_PRIM_CYLINDER, pk->count);
+
+	real_t t_lane[CYLINDER_PACKET_WIDTH];
+	int surface_lane[CYLINDER_PACKET_WIDTH];
+
+#pragma omp simd
+	for (int k = 0; k < CYLINDER_PACKET_WIDTH; ++k)
+	{
+		real_t cx = r->orig.x - pk->bx[k];
+		real_t cy = r->orig.y - pk->by[k];
+		real_t cz = r->orig.z - pk->bz[k];
+		real_t ox = cx * pk->ux[k] + cy * pk->uy[k] + cz * pk->uz[k];
+		real_t oy = cx * pk->vx[k] + cy * pk->vy[k] + cz * pk->vz[k];
+		real_t oz = cx * pk->wx[k] + cy * pk->wy[k] + cz * pk->wz[k];
+		real_t dx = r->dir.x * pk->ux[k] + r->dir.y * pk->uy[k] + r->dir.z * pk->uz[k];
+		real_t dy = r->dir.x * pk->vx[k] + r->dir.y * pk->vy[k] + r->dir.z * pk->vz[k];
+		real_t dz = r->dir.x * pk->wx[k] + r->dir.y * pk->wy[k] + r->dir.z * pk->wz[k];
+		int surface = SURFACE_SIDE;
+		real_t t = cylinder_hit_local(ox, oy, oz, dx, dy, dz, pk->r2[k], pk->h[k],
+									  rayt.min, rayt.max, &surface);
+		t_lane[k] = (k < pk->count) ? t : INFINITY;
+		surface_lane[k] = surface;
+	}
+
+	int best = 0;
+	for (int k = 1; k < CYLINDER_PACKET_WIDTH; ++k)
+		if (t_lane[k] < t_lane[best])
+			best = k;
+	if (t_lane[best] == INFINITY)
+		return false;
+
+	cylinder_fill_record(&pk->cyl[best], r, t_lane[best], surface_lane[best], rec);
+	rec->object_id = pk->id[best];
+	return true;
+}
+
+static __thread const t_cylinder4 *g_current_cylinder4 = NULL;
+
+static inline void set_current_cylinder4(const void *obj)
+{
+	g_current_cylinder4 = (const t_cylinder4 *)obj;
+}
+
+static inline bool cylinder4_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
+{
+	if (!g_current_cylinder4)
+		return false;
+	return cylinder4_hit(g_current_cylinder4, r, rayt, rec);
+}
+
+/* Sort key used to cluster cylinders before packing */
+typedef struct s_cylinder_key
+{
+	real_t key;
+	t_cylinder cyl;
+	uint32_t id;
+} t_cylinder_key;
+
+static inline int cylinder_key_compare(const void *a, const void *b)
+{
+	real_t ka = ((const t_cylinder_key *)a)->key;
+	real_t kb = ((const t_cylinder_key *)b)->key;
+	return (ka < kb) ? -1 : ((ka > kb) ? 1 : 0);
+}
+
+/* Replace the list's individual cylinders by packets of up to four neighbours
+   (sorted along the longest axis of their union). Call it before bvh_node_create
+   so that every packet becomes a single BVH leaf. */
+static inline bool cylinder_pack_list(t_hittable_list *list)
+{
+	if (!list)
+		return false;
+
+	size_t n = 0;
+	for (size_t i = 0; i < list->count; ++i)
+		if (list->objects[i].set_current == set_current_cylinder)
+			n++;
+	if (n < 2)
+		return true;
+
+	t_cylinder_key *keys = (t_cylinder_key *)malloc(n * sizeof(t_cylinder_key));
+	if (!keys)
+		return false;
+
+	/* Pull cylinders out of the list, compacting the remaining wrappers */
+	t_aabb span = aabb_empty();
+	size_t kept = 0;
+	size_t k = 0;
+	for (size_t i = 0; i < list->count; ++i)
+	{
+		t_hittable_wrapper *w = &list->objects[i];
+		if (w->set_current != set_current_cylinder)
+		{
+			list->objects[kept++] = *w;
+			continue;
+		}
+		keys[k].cyl = *(const t_cylinder *)w->object;
+		keys[k].id = w->id;
+		span = aabb_merge(&span, &w->bbox);
+		if (w->owned)
+			free(w->object);
+		k++;
+	}
+	list->count = kept;
+
+	int axis = aabb_longest_axis(&span);
+	for (size_t i = 0; i < n; ++i)
+	{
+		const t_interval *it = aabb_axis_interval(&keys[i].cyl.bbox, axis);
+		keys[i].key = (it->min + it->max) * (real_t)0.5;
+	}
+	qsort(keys, n, sizeof(t_cylinder_key), cylinder_key_compare);
+
+	bool ok = true;
+	for (size_t start = 0; start < n; start += CYLINDER_PACKET_WIDTH)
+	{
+		int count = (int)((n - start < CYLINDER_PACKET_WIDTH) ? n - start : CYLINDER_PACKET_WIDTH);
+		if (count == 1)
+		{
+			if (hittable_list_add_cylinder(list, &keys[start].cyl))
+				list->objects[list->count - 1].id = keys[start].id;
+			else
+				ok = false;
+			continue;
+		}
+		t_cylinder group[CYLINDER_PACKET_WIDTH];
+		for (int j = 0; j < count; ++j)
+			group[j] = keys[start + (size_t)j].cyl;
+
+		t_cylinder4 *pk = (t_cylinder4 *)malloc(sizeof(t_cylinder4));
+		if (!pk)
+		{
+			ok = false;
+			continue;
+		}
+		cylinder4_init(pk, group, count);
+		for (int j = 0; j < count; ++j)
+			pk->id[j] = keys[start + (size_t)j].id;
+		t_hittable_wrapper wrap = {
+			.object = pk,
+			.owned = true,
+			.set_current = set_current_cylinder4,
+			.hit_noobj = cylinder4_hit_noobj,
+			.bbox = pk->bbox};
+		ok = hittable_list_add_wrapper(list, &wrap) && ok;
+	}
+	free(keys);
+	return ok;
+}
+
 /* ============================================================================ */
 /*                          CONE (bonus primitive)                              */
 /* ============================================================================ */
@@ -300,6 +519,9 @@ typedef struct s_cone
 	real_t height; /* distance from apex to base */
 	t_material *mat;
 	t_aabb bbox;
+	t_vec3 frame_u; /* local x axis, perpendicular to axis */
+	t_vec3 frame_v; /* local y axis, completes the frame */
+	real_t tan2;	/* tan(angle)^2 */
 } t_cone;
 
 static inline t_cone cone_create(const t_point3 *apex, const t_vec3 *axis,
@@ -311,6 +533,9 @@ static inline t_cone cone_create(const t_point3 *apex, const t_vec3 *axis,
 	cone.angle = degrees_to_radians(angle_deg);
 	cone.height = (height > 0) ? height : (real_t)1.0;
 	cone.mat = mat;
+	cone.tan2 = (real_t)tan((double)cone.angle);
+	cone.tan2 *= cone.tan2;
+	axis_frame(&cone.axis, &cone.frame_u, &cone.frame_v);
 
 	/* Compute bounding box */
 	real_t base_radius = cone.height * (real_t)tan((double)cone.angle);
@@ -339,107 +564,97 @@ static inline t_cone cone_create(const t_point3 *apex, const t_vec3 *axis,
 	return cone;
 }
 
-/* Ray-cone intersection (truncated cone with base cap) */
+/* Express the ray in the cone's local frame (origin at apex, z along axis) */
+static inline void cone_to_local(const t_cone *cone, const t_ray *r, t_vec3 *o, t_vec3 *d)
+{
+	t_vec3 co = vec3_sub(&r->orig, &cone->apex);
+	*o = vec3_create(dot(&co, &cone->frame_u), dot(&co, &cone->frame_v), dot(&co, &cone->axis));
+	*d = vec3_create(dot(&r->dir, &cone->frame_u), dot(&r->dir, &cone->frame_v), dot(&r->dir, &cone->axis));
+}
+
+/* Ray-cone intersection (truncated cone with base cap).
+   In the local frame the solid is x^2+y^2 <= tan^2 * z^2 clipped by the slab 0 <= z <= h.
+   Inside the slab only the upper nappe remains, which is convex, so the hit is found the
+   same way as for the cylinder: intersect the nappe interval with the slab interval. */
 static inline bool cone_hit(const t_cone *cone, const t_ray *r,
 							t_interval rayt, t_hit_record *rec)
 {
 	if (!cone || !r || !rec)
 		return false;
+	RT_STAT_PRIM(STAT_PRIM_CONE);
 
 	const real_t EPSILON = (real_t)1e-8;
+	t_vec3 o, d;
+	cone_to_local(cone, r, &o, &d);
+
+	/* Slab: apex plane (z = 0) and base cap (z = h) */
+	real_t inv_dz = (real_t)1.0 / slab_safe_denom(d.z);
+	real_t tz0 = -o.z * inv_dz;
+	real_t tz1 = (cone->height - o.z) * inv_dz;
+	real_t cap_near = (real_t)fmin((double)tz0, (double)tz1);
+	real_t cap_far = (real_t)fmax((double)tz0, (double)tz1);
+
+	/* Double cone: a t^2 + 2 half_b t + c <= 0 */
+	real_t k2 = cone->tan2;
+	real_t a = d.x * d.x + d.y * d.y - k2 * d.z * d.z;
+	real_t half_b = o.x * d.x + o.y * d.y - k2 * o.z * d.z;
+	real_t c = o.x * o.x + o.y * o.y - k2 * o.z * o.z;
+	real_t disc = half_b * half_b - a * c;
+	if (disc < (real_t)0.0 && a >= (real_t)0.0)
+		return false;
 
-	t_vec3 co = vec3_sub(&r->orig, &cone->apex);
-
-	real_t cos_a = (real_t)cos((double)cone->angle);
-	real_t sin_a = (real_t)sin((double)cone->angle);
-	real_t cos2 = cos_a * cos_a;
-	real_t sin2 = sin_a * sin_a;
-
-	real_t d_dot_v = dot(&r->dir, &cone->axis);
-	real_t co_dot_v = dot(&co, &cone->axis);
-
-	/* Quadratic coefficients */
-	real_t tan2 = sin2 / cos2;
-
-	real_t a = dot(&r->dir, &r->dir) - (1 + tan2) * d_dot_v * d_dot_v;
-	real_t half_b = dot(&r->dir, &co) - (1 + tan2) * d_dot_v * co_dot_v;
-	real_t c_coef = dot(&co, &co) - (1 + tan2) * co_dot_v * co_dot_v;
-
-	bool hit_anything = false;
-	real_t closest_t = rayt.max;
-	t_vec3 closest_normal;
-
-	if (fabsl((long double)a) > (long double)EPSILON)
+	real_t sq = (real_t)sqrt(fmax((double)disc, 0.0));
+	real_t safe_a = (fabs((double)a) > (double)EPSILON) ? a : ((a < (real_t)0.0) ? -EPSILON : EPSILON);
+	real_t r0 = (-half_b - sq) / safe_a;
+	real_t r1 = (-half_b + sq) / safe_a;
+	real_t lo = (real_t)fmin((double)r0, (double)r1);
+	real_t hi = (real_t)fmax((double)r0, (double)r1);
+
+	/* Shallow rays are inside between the roots; steep rays are inside outside the roots,
+	   and only the piece heading into +z belongs to the upper nappe */
+	real_t side_near = lo;
+	real_t side_far = hi;
+	if (a < (real_t)0.0)
 	{
-		real_t discriminant = half_b * half_b - a * c_coef;
-		if (discriminant >= 0)
-		{
-			real_t sqrtd = (real_t)sqrt((double)discriminant);
-			real_t roots[2] = {(-half_b - sqrtd) / a, (-half_b + sqrtd) / a};
-
-			for (int i = 0; i < 2; ++i)
-			{
-				real_t t = roots[i];
-				if (t < rayt.min || t >= closest_t)
-					continue;
-
-				t_vec3 hit_pt = ray_at((t_ray *)r, t);
-				t_vec3 to_hit = vec3_sub(&hit_pt, &cone->apex);
-				real_t h = dot(&to_hit, &cone->axis);
-
-				/* Must be between apex and base */
-				if (h >= 0 && h <= cone->height)
-				{
-					hit_anything = true;
-					closest_t = t;
-
-					/* Normal computation for cone surface */
-					t_vec3 axis_pt = vec3_mul_scalar(&cone->axis, h);
-					t_vec3 radial = vec3_sub(&to_hit, &axis_pt);
-					t_vec3 radial_unit = unit_vector(&radial);
-
-					/* Normal = radial * cos(angle) - axis * sin(angle) */
-					t_vec3 n1 = vec3_mul_scalar(&radial_unit, cos_a);
-					t_vec3 n2 = vec3_mul_scalar(&cone->axis, -sin_a);
-					closest_normal = vec3_add(&n1, &n2);
-					closest_normal = unit_vector(&closest_normal);
-				}
-			}
-		}
+		side_near = (d.z > (real_t)0.0) ? hi : -INFINITY;
+		side_far = (d.z > (real_t)0.0) ? INFINITY : lo;
 	}
-
-	/* Check base cap */
-	if (fabsl((long double)d_dot_v) > (long double)EPSILON)
+	if (disc < (real_t)0.0)
 	{
-		real_t t = (cone->height - co_dot_v) / d_dot_v;
-		if (t >= rayt.min && t < closest_t)
-		{
-			t_vec3 hit_pt = ray_at((t_ray *)r, t);
-			t_vec3 base_axis_comp = vec3_mul_scalar(&cone->axis, cone->height);
-			t_vec3 base_center = vec3_add(&cone->apex, &base_axis_comp);
-			t_vec3 to_hit = vec3_sub(&hit_pt, &base_center);
-			real_t dist_sq = vec3_length_squared(&to_hit);
-			real_t base_radius = cone->height * (real_t)tan((double)cone->angle);
-
-			if (dist_sq <= base_radius * base_radius)
-			{
-				hit_anything = true;
-				closest_t = t;
-				closest_normal = cone->axis;
-			}
-		}
+		side_near = -INFINITY;
+		side_far = INFINITY;
 	}
 
-	if (!hit_anything)
+	real_t t_enter = (real_t)fmax((double)side_near, (double)cap_near);
+	real_t t_exit = (real_t)fmin((double)side_far, (double)cap_far);
+	real_t t = (t_enter >= rayt.min) ? t_enter : t_exit;
+	if (t_enter > t_exit || t < rayt.min || t >= rayt.max)
 		return false;
 
-	rec->t = closest_t;
-	rec->p = ray_at((t_ray *)r, closest_t);
+	t_vec3 outward;
+	if (t == tz1)
+		outward = cone->axis;
+	else
+	{
+		/* Gradient of x^2 + y^2 - tan^2 z^2 points out of the solid */
+		real_t px = o.x + t * d.x;
+		real_t py = o.y + t * d.y;
+		real_t pz = o.z + t * d.z;
+		t_vec3 nu = vec3_mul_scalar(&cone->frame_u, px);
+		t_vec3 nv = vec3_mul_scalar(&cone->frame_v, py);
+		t_vec3 nw = vec3_mul_scalar(&cone->axis, -k2 * pz);
+		outward = vec3_add(&nu, &nv);
+		outward = vec3_add(&outward, &nw);
+		outward = unit_vector(&outward);
+	}
+
+	rec->t = t;
+	rec->p = ray_at((t_ray *)r, t);
 	rec->u = 0;
 	rec->v = 0;
 	rec->mat = cone->mat;
 	rec->albedo = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
-	set_face_normal(rec, r, &closest_normal);
+	set_face_normal(rec, r, &outward);
 
 	return true;
 }
@@ -0,0 +1,231 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   denoise.h                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/07 10:26:53 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/07 10:26:53 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "vector.h"
+#include "color.h"
+#include "framebuffer.h"
+#include "tile.h"
+#include "stats.h"
+
+/* Edge-avoiding a-trous wavelet denoiser (Dammertz et al., with the
+   variance-driven luminance weight of SVGF). The image is divided by its
+   first-hit albedo, so textures are kept out of the filter, then smoothed by
+   a 5x5 B-spline kernel whose taps spread 1, 2, 4, ... pixels apart. Each
+   tap is weighted down when its depth, normal or luminance differs from the
+   centre pixel's; the luminance tolerance follows the pixel's own Monte
+   Carlo variance, which is filtered along with the colour. Needs the
+   accumulator's per-pixel stats and guides. */
+
+#define DENOISE_ITERATIONS 5
+#define DENOISE_SIGMA_LUM 4.0	 /* luminance tolerance, in standard deviations */
+#define DENOISE_NORMAL_POWER 64.0 /* cos(angle)^p normal weight */
+#define DENOISE_SIGMA_DEPTH 0.02 /* relative depth change allowed per pixel of distance */
+#define DENOISE_ALBEDO_FLOOR 0.01
+#define DENOISE_PROBE_SIZE 64 /* side of the image denoise_estimate_seconds times */
+
+typedef struct s_denoise_guides
+{
+	int width;
+	int height;
+	t_vec3 *albedo; /* mean first-hit albedo */
+	t_vec3 *normal; /* normalized mean first-hit normal */
+	float *depth;	/* mean first-hit distance (0 = sky) */
+} t_denoise_guides;
+
+static const double g_denoise_kernel[5] = {1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+
+/* Weight of tap q for centre p, all guide values given */
+static inline double denoise_weight(double lum_p, double lum_q, double sigma_lum,
+									const t_vec3 *n_p, const t_vec3 *n_q,
+									float z_p, float z_q, double dist)
+{
+	double w = 1.0;
+	if ((z_p > 0.0f) != (z_q > 0.0f))
+		return 0.0;
+	if (z_p > 0.0f)
+		w *= exp(-fabs((double)(z_p - z_q)) / (DENOISE_SIGMA_DEPTH * (double)z_p * dist + 1e-6));
+	double c = (double)dot(n_p, n_q);
+	w *= (c > 0.0) ? pow(c, DENOISE_NORMAL_POWER) : 0.0;
+	w *= exp(-fabs(lum_p - lum_q) / (sigma_lum + 1e-6));
+	return w;
+}
+
+/* One a-trous level with taps `step` pixels apart over the rows of one tile:
+   colour and variance from (c_in, v_in) into (c_out, v_out) */
+static inline void denoise_level_tile(const t_denoise_guides *g, const t_tile *tile, int step,
+									  const t_vec3 *c_in, const float *v_in,
+									  t_vec3 *c_out, float *v_out)
+{
+	int w = g->width;
+	int h = g->height;
+	for (int y = tile->y0; y < tile->y1; ++y)
+		for (int x = tile->x0; x < tile->x1; ++x)
+		{
+			size_t p = (size_t)y * (size_t)w + (size_t)x;
+			/* 3x3 blurred variance steadies the luminance tolerance */
+			double var_blur = 0.0;
+			double blur_w = 0.0;
+			for (int dy = -1; dy <= 1; ++dy)
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					int qx = x + dx;
+					int qy = y + dy;
+					if (qx < 0 || qx >= w || qy < 0 || qy >= h)
+						continue;
+					double k = (dx == 0 ? 0.5 : 0.25) * (dy == 0 ? 0.5 : 0.25);
+					var_blur += k * (double)v_in[(size_t)qy * (size_t)w + (size_t)qx];
+					blur_w += k;
+				}
+			double sigma_lum = DENOISE_SIGMA_LUM * sqrt(var_blur / blur_w);
+			double lum_p = (double)color_luminance(&c_in[p]);
+
+			t_vec3 sum = vec3_zero();
+			double sum_w = 0.0;
+			double sum_v = 0.0;
+			for (int ky = 0; ky < 5; ++ky)
+				for (int kx = 0; kx < 5; ++kx)
+				{
+					int qx = x + (kx - 2) * step;
+					int qy = y + (ky - 2) * step;
+					if (qx < 0 || qx >= w || qy < 0 || qy >= h)
+						continue;
+					size_t q = (size_t)qy * (size_t)w + (size_t)qx;
+					double wq = g_denoise_kernel[kx] * g_denoise_kernel[ky];
+					if (q != p)
+					{
+						double dist = step * sqrt((double)((kx - 2) * (kx - 2) + (ky - 2) * (ky - 2)));
+						wq *= denoise_weight(lum_p, (double)color_luminance(&c_in[q]), sigma_lum,
+											 &g->normal[p], &g->normal[q], g->depth[p], g->depth[q], dist);
+					}
+					t_vec3 c = vec3_mul_scalar(&c_in[q], (real_t)wq);
+					sum = vec3_add(&sum, &c);
+					sum_w += wq;
+					sum_v += wq * wq * (double)v_in[q];
+				}
+			c_out[p] = vec3_div_scalar(&sum, (real_t)sum_w);
+			v_out[p] = (float)(sum_v / (sum_w * sum_w));
+		}
+}
+
+/* Seconds denoise_accum should take on a width x height image, from one
+   filter level timed on a small flat image. Every tap of it is computed
+   (nothing is sky), so the estimate errs on the long side. */
+static inline double denoise_estimate_seconds(int width, int height)
+{
+	const int side = DENOISE_PROBE_SIZE;
+	size_t n = (size_t)side * (size_t)side;
+	t_denoise_guides g = {side, side, NULL, NULL, NULL};
+	g.normal = (t_vec3 *)malloc(n * sizeof(t_vec3));
+	g.depth = (float *)malloc(n * sizeof(float));
+	t_vec3 *c = (t_vec3 *)malloc(2 * n * sizeof(t_vec3));
+	float *v = (float *)malloc(2 * n * sizeof(float));
+	double seconds = 0.0;
+	if (g.normal && g.depth && c && v)
+	{
+		for (size_t k = 0; k < n; ++k)
+		{
+			g.normal[k] = vec3_create((real_t)0.0, (real_t)0.0, (real_t)1.0);
+			g.depth[k] = 1.0f;
+			c[k] = vec3_create((real_t)0.5, (real_t)0.5, (real_t)0.5);
+			v[k] = 0.01f;
+		}
+		t_tile tile = {0, 0, side, side};
+		double start = stats_wall_time();
+		denoise_level_tile(&g, &tile, 1, c, v, c + n, v + n);
+		double per_pixel = (stats_wall_time() - start) / (double)n;
+#ifdef _OPENMP
+		int threads = omp_get_max_threads();
+#else
+		int threads = 1;
+#endif
+		seconds = per_pixel * (double)width * (double)height * DENOISE_ITERATIONS / (double)threads;
+	}
+	free(g.normal);
+	free(g.depth);
+	free(c);
+	free(v);
+	return seconds;
+}
+
+/* Denoise acc into out (width * height colours). Returns false if acc has no
+   per-pixel stats or guides, or on allocation failure. */
+static inline bool denoise_accum(const t_accum *acc, t_vec3 *out, int tile_size)
+{
+	if (!acc->count || !acc->albedo)
+		return false;
+	int w = acc->width;
+	int h = acc->height;
+	size_t n = (size_t)w * (size_t)h;
+	t_denoise_guides g = {w, h, NULL, NULL, NULL};
+	g.albedo = (t_vec3 *)malloc(n * sizeof(t_vec3));
+	g.normal = (t_vec3 *)malloc(n * sizeof(t_vec3));
+	g.depth = (float *)malloc(n * sizeof(float));
+	t_vec3 *tmp = (t_vec3 *)malloc(n * sizeof(t_vec3));
+	float *var = (float *)malloc(2 * n * sizeof(float));
+	int tile_count = 0;
+	t_tile *tiles = tile_list_create(w, h, tile_size, TILE_ORDER_SCANLINE, &tile_count);
+	bool ok = g.albedo && g.normal && g.depth && tmp && var && tiles;
+
+	/* Guides, demodulated colour and variance of each pixel's mean */
+	for (size_t k = 0; ok && k < n; ++k)
+	{
+		int s = acc->count[k];
+		real_t inv = (s > 0) ? (real_t)1.0 / (real_t)s : (real_t)0.0;
+		g.albedo[k] = vec3_mul_scalar(&acc->albedo[k], inv);
+		g.normal[k] = vec3_near_zero(&acc->normal[k]) ? acc->normal[k] : unit_vector(&acc->normal[k]);
+		g.depth[k] = acc->depth[k] * (float)inv;
+		const real_t lo = (real_t)DENOISE_ALBEDO_FLOOR;
+		g.albedo[k] = vec3_create(fmax(g.albedo[k].x, lo), fmax(g.albedo[k].y, lo), fmax(g.albedo[k].z, lo));
+		t_vec3 mean = vec3_mul_scalar(&acc->sum[k], inv);
+		out[k] = vec3_create(mean.x / g.albedo[k].x, mean.y / g.albedo[k].y, mean.z / g.albedo[k].z);
+		double m = (s > 0) ? (double)acc->lum[k] / s : 0.0;
+		double v = (s > 1) ? ((double)acc->lum_sq[k] - s * m * m) / (double)(s - 1) / (double)s : 1.0;
+		double a = (double)color_luminance(&g.albedo[k]);
+		var[k] = (float)((v > 0.0 ? v : 0.0) / (a * a));
+	}
+
+	/* Ping-pong between out and tmp; the last level lands in out */
+	t_vec3 *c_bufs[2] = {out, tmp};
+	float *v_bufs[2] = {var, var + n};
+	int cur = 0;
+	for (int level = 0; ok && level < DENOISE_ITERATIONS; ++level)
+	{
+		int step = 1 << level;
+#pragma omp parallel for schedule(dynamic)
+		for (int t = 0; t < tile_count; ++t)
+			denoise_level_tile(&g, &tiles[t], step, c_bufs[cur], v_bufs[cur],
+							   c_bufs[cur ^ 1], v_bufs[cur ^ 1]);
+		cur ^= 1;
+	}
+	if (ok && cur != 0)
+		memcpy(out, tmp, n * sizeof(t_vec3));
+	for (size_t k = 0; ok && k < n; ++k)
+		out[k] = vec3_mul_elem(&out[k], &g.albedo[k]);
+
+	free(g.albedo);
+	free(g.normal);
+	free(g.depth);
+	free(tmp);
+	free(var);
+	free(tiles);
+	return ok;
+}
+
+#endif
@@ -0,0 +1,357 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   envmap.h                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/09 16:41:08 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/09 16:41:08 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef ENVMAP_H
+#define ENVMAP_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "settings.h"
+#include "types.h"
+#include "vector.h"
+#include "random.h"
+#include "texture.h"
+
+/* Image-based lighting: an equirectangular environment map gives the
+   radiance arriving from every direction that leaves the scene. Row 0 is
+   the zenith (+y), the bottom row the nadir; columns go once around y,
+   starting and ending at -x. Maps are read from PFM (linear HDR) or PNG
+   (sRGB, converted to linear), or built from pixels in memory.
+
+   For light sampling every pixel gets a weight, its luminance times the
+   solid angle it covers, and the weights go into alias tables: one over
+   the rows, one per row over its pixels. A direction is then drawn in
+   constant time with two random numbers, whatever the resolution, and
+   bright spots such as the sun are found in a handful of samples. */
+
+typedef struct s_envmap
+{
+	int width;
+	int height;
+	float *rgb;			/* linear radiance, width x height, top row first */
+	float *pixel_prob;	/* per row: alias tables over its pixels */
+	int *pixel_alias;
+	float *row_prob;	/* alias table over the rows */
+	int *row_alias;
+	float *pdf;			/* chance of drawing each pixel */
+	real_t scale;		/* radiance multiplier (exposure) */
+} t_envmap;
+
+/* Walker/Vose alias table over n weights: entry k keeps k with
+   probability prob[k] and gives alias[k] otherwise. work holds 2n ints.
+   False when every weight is zero. */
+static inline bool envmap_build_alias(const double *weights, int n, float *prob, int *alias, int *work)
+{
+	double total = 0.0;
+	for (int k = 0; k < n; ++k)
+		total += weights[k];
+	if (!(total > 0.0))
+		return false;
+	int *small = work;
+	int *large = work + n;
+	int ns = 0;
+	int nl = 0;
+	double *scaled = (double *)malloc((size_t)n * sizeof(double));
+	if (!scaled)
+		return false;
+	for (int k = 0; k < n; ++k)
+	{
+		scaled[k] = weights[k] * (double)n / total;
+		if (scaled[k] < 1.0)
+			small[ns++] = k;
+		else
+			large[nl++] = k;
+	}
+	while (ns > 0 && nl > 0)
+	{
+		int s = small[--ns];
+		int l = large[--nl];
+		prob[s] = (float)scaled[s];
+		alias[s] = l;
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0)
+			small[ns++] = l;
+		else
+			large[nl++] = l;
+	}
+	/* Leftovers are 1 up to rounding */
+	while (nl > 0)
+	{
+		int l = large[--nl];
+		prob[l] = 1.0f;
+		alias[l] = l;
+	}
+	while (ns > 0)
+	{
+		int s = small[--ns];
+		prob[s] = 1.0f;
+		alias[s] = s;
+	}
+	free(scaled);
+	return true;
+}
+
+/* Entry drawn from an alias table with u in [0,1); u is rescaled to a
+   fresh [0,1) number for further use */
+static inline int envmap_alias_draw(const float *prob, const int *alias, int n, real_t *u)
+{
+	real_t x = *u * (real_t)n;
+	int k = (int)x;
+	if (k >= n)
+		k = n - 1;
+	real_t coin = x - (real_t)k;
+	if (coin < (real_t)prob[k] || prob[k] >= 1.0f)
+	{
+		*u = coin / (real_t)prob[k];
+		return k;
+	}
+	*u = (coin - (real_t)prob[k]) / ((real_t)1.0 - (real_t)prob[k]);
+	return alias[k];
+}
+
+static inline void envmap_destroy(t_envmap *env)
+{
+	if (!env)
+		return;
+	free(env->rgb);
+	free(env->pixel_prob);
+	free(env->pixel_alias);
+	free(env->row_prob);
+	free(env->row_alias);
+	free(env->pdf);
+	memset(env, 0, sizeof(*env));
+}
+
+/* Environment from width x height linear RGB pixels (copied, top row
+   first). Returns false when out of memory. A black map is valid: it is
+   seen but never sampled. */
+static inline bool envmap_init(t_envmap *env, int width, int height, const float *rgb)
+{
+	memset(env, 0, sizeof(*env));
+	env->scale = (real_t)1.0;
+	if (width <= 0 || height <= 0 || !rgb)
+		return false;
+	size_t n = (size_t)width * (size_t)height;
+	env->width = width;
+	env->height = height;
+	env->rgb = (float *)malloc(n * 3 * sizeof(float));
+	env->pixel_prob = (float *)malloc(n * sizeof(float));
+	env->pixel_alias = (int *)malloc(n * sizeof(int));
+	env->row_prob = (float *)malloc((size_t)height * sizeof(float));
+	env->row_alias = (int *)malloc((size_t)height * sizeof(int));
+	env->pdf = (float *)calloc(n, sizeof(float));
+	double *weights = (double *)malloc(n * sizeof(double));
+	double *row_weights = (double *)malloc((size_t)height * sizeof(double));
+	int longest = (width > height) ? width : height;
+	int *work = (int *)malloc((size_t)longest * 2 * sizeof(int));
+	if (!env->rgb || !env->pixel_prob || !env->pixel_alias || !env->row_prob || !env->row_alias || !env->pdf
+		|| !weights || !row_weights || !work)
+	{
+		free(weights);
+		free(row_weights);
+		free(work);
+		envmap_destroy(env);
+		return false;
+	}
+	memcpy(env->rgb, rgb, n * 3 * sizeof(float));
+
+	/* Weight: luminance times the solid angle of the pixel (sin theta) */
+	double total = 0.0;
+	for (int j = 0; j < height; ++j)
+	{
+		double sin_theta = sin(PI * ((double)j + 0.5) / (double)height);
+		row_weights[j] = 0.0;
+		for (int i = 0; i < width; ++i)
+		{
+			const float *c = env->rgb + ((size_t)j * (size_t)width + (size_t)i) * 3;
+			double lum = 0.2126 * (double)c[0] + 0.7152 * (double)c[1] + 0.0722 * (double)c[2];
+			double w = (lum > 0.0 && isfinite(lum)) ? lum * sin_theta : 0.0;
+			weights[(size_t)j * (size_t)width + (size_t)i] = w;
+			row_weights[j] += w;
+		}
+		total += row_weights[j];
+		if (!envmap_build_alias(weights + (size_t)j * (size_t)width, width,
+								env->pixel_prob + (size_t)j * (size_t)width,
+								env->pixel_alias + (size_t)j * (size_t)width, work))
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				env->pixel_prob[(size_t)j * (size_t)width + (size_t)i] = 1.0f;
+				env->pixel_alias[(size_t)j * (size_t)width + (size_t)i] = i;
+			}
+		}
+	}
+	if (envmap_build_alias(row_weights, height, env->row_prob, env->row_alias, work))
+		for (size_t k = 0; k < n; ++k)
+			env->pdf[k] = (float)(weights[k] / total);
+	else
+	{
+		free(env->row_prob);
+		env->row_prob = NULL;
+	}
+	free(weights);
+	free(row_weights);
+	free(work);
+	return true;
+}
+
+/* Portable float map: "PF" (RGB) or "Pf" (grey), bottom row first,
+   negative scale = little endian */
+static inline bool envmap_load_pfm(t_envmap *env, const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return false;
+	char magic[3] = {0};
+	int w = 0;
+	int h = 0;
+	double scale = 0.0;
+	bool ok = fscanf(f, "%2s %d %d %lf", magic, &w, &h, &scale) == 4 && magic[0] == 'P'
+			  && (magic[1] == 'F' || magic[1] == 'f') && w > 0 && h > 0 && scale != 0.0 && fgetc(f) != EOF;
+	int channels = (magic[1] == 'F') ? 3 : 1;
+	size_t n = ok ? (size_t)w * (size_t)h : 0;
+	float *data = ok ? (float *)malloc(n * (size_t)channels * sizeof(float)) : NULL;
+	float *rgb = ok ? (float *)malloc(n * 3 * sizeof(float)) : NULL;
+	ok = ok && data && rgb && fread(data, sizeof(float) * (size_t)channels, n, f) == n;
+	fclose(f);
+	if (ok)
+	{
+		const uint16_t probe = 1;
+		bool little = *(const unsigned char *)&probe == 1;
+		bool swap = (scale < 0.0) != little;
+		for (size_t k = 0; k < n * (size_t)channels; ++k)
+		{
+			if (swap)
+			{
+				unsigned char *b = (unsigned char *)&data[k];
+				unsigned char t = b[0];
+				b[0] = b[3];
+				b[3] = t;
+				t = b[1];
+				b[1] = b[2];
+				b[2] = t;
+			}
+		}
+		for (int j = 0; j < h; ++j)
+			for (int i = 0; i < w; ++i)
+				for (int c = 0; c < 3; ++c)
+				{
+					size_t src = ((size_t)(h - 1 - j) * (size_t)w + (size_t)i) * (size_t)channels;
+					rgb[((size_t)j * (size_t)w + (size_t)i) * 3 + (size_t)c] = data[src + (channels == 3 ? (size_t)c : 0)];
+				}
+		ok = envmap_init(env, w, h, rgb);
+	}
+	free(data);
+	free(rgb);
+	return ok;
+}
+
+/* PNG through the png_writer decoder, sRGB to linear */
+static inline bool envmap_load_png(t_envmap *env, const char *path)
+{
+	t_lode_image image;
+	lode_image_init(&image);
+	unsigned err = lode_image_load_png(&image, path);
+	if (err)
+	{
+		fprintf(stderr, "lodepng error %u: %s (%s)\n", err, lodepng_error_text(err), path);
+		return false;
+	}
+	size_t n = (size_t)image.w * (size_t)image.h;
+	float *rgb = (float *)malloc(n * 3 * sizeof(float));
+	bool ok = rgb != NULL;
+	if (ok)
+	{
+		for (unsigned j = 0; j < image.h; ++j)
+			for (unsigned i = 0; i < image.w; ++i)
+			{
+				const unsigned char *p = lode_image_pixel_rgb(&image, (int)i, (int)j);
+				for (int c = 0; c < 3; ++c)
+					rgb[((size_t)j * image.w + i) * 3 + (size_t)c] = (float)srgb_to_linear(p[c]);
+			}
+		ok = envmap_init(env, (int)image.w, (int)image.h, rgb);
+	}
+	free(rgb);
+	lode_image_cleanup(&image);
+	return ok;
+}
+
+/* Environment from an image file: .pfm as linear HDR, PNG otherwise */
+static inline bool envmap_load(t_envmap *env, const char *path)
+{
+	size_t len = path ? strlen(path) : 0;
+	if (len >= 4 && (strcmp(path + len - 4, ".pfm") == 0 || strcmp(path + len - 4, ".PFM") == 0))
+		return envmap_load_pfm(env, path);
+	return path && envmap_load_png(env, path);
+}
+
+/* Pixel seen along unit direction dir */
+static inline size_t envmap_pixel(const t_envmap *env, const t_vec3 *dir, real_t *sin_theta)
+{
+	real_t y = (dir->y > (real_t)1.0) ? (real_t)1.0 : (dir->y < (real_t)-1.0 ? (real_t)-1.0 : dir->y);
+	real_t theta = (real_t)acos((double)y);
+	real_t phi = (real_t)atan2((double)-dir->z, (double)dir->x) + (real_t)PI;
+	int i = (int)(phi * (real_t)(0.5 / PI) * (real_t)env->width);
+	int j = (int)(theta * (real_t)(1.0 / PI) * (real_t)env->height);
+	i = (i < 0) ? 0 : (i >= env->width ? env->width - 1 : i);
+	j = (j < 0) ? 0 : (j >= env->height ? env->height - 1 : j);
+	*sin_theta = (real_t)sqrt(fmax(0.0, 1.0 - (double)(y * y)));
+	return (size_t)j * (size_t)env->width + (size_t)i;
+}
+
+/* Radiance arriving from direction dir (any length) */
+static inline t_color envmap_radiance(const t_envmap *env, const t_vec3 *dir)
+{
+	t_vec3 d = unit_vector(dir);
+	real_t sin_theta;
+	const float *c = env->rgb + envmap_pixel(env, &d, &sin_theta) * 3;
+	return vec3_create((real_t)c[0] * env->scale, (real_t)c[1] * env->scale, (real_t)c[2] * env->scale);
+}
+
+/* Solid-angle density of envmap_sample drawing unit direction dir */
+static inline real_t envmap_pdf(const t_envmap *env, const t_vec3 *dir)
+{
+	if (!env->row_prob)
+		return (real_t)0.0;
+	real_t sin_theta;
+	real_t p = (real_t)env->pdf[envmap_pixel(env, dir, &sin_theta)];
+	if (p <= (real_t)0.0 || sin_theta <= (real_t)0.0)
+		return (real_t)0.0;
+	return p * (real_t)env->width * (real_t)env->height / ((real_t)(2.0 * PI * PI) * sin_theta);
+}
+
+/* Unit direction drawn in proportion to the map's light, uniformly within
+   the chosen pixel; *pdf gets its solid-angle density. False for a black
+   map. */
+static inline bool envmap_sample(const t_envmap *env, t_vec3 *dir, real_t *pdf)
+{
+	if (!env->row_prob)
+		return false;
+	real_t u = random_real();
+	real_t v = random_real();
+	int j = envmap_alias_draw(env->row_prob, env->row_alias, env->height, &u);
+	size_t row = (size_t)j * (size_t)env->width;
+	int i = envmap_alias_draw(env->pixel_prob + row, env->pixel_alias + row, env->width, &v);
+	real_t phi = ((real_t)i + u) * (real_t)(2.0 * PI) / (real_t)env->width - (real_t)PI;
+	real_t theta = ((real_t)j + v) * (real_t)PI / (real_t)env->height;
+	real_t sin_theta = (real_t)sin((double)theta);
+	*dir = vec3_create((real_t)cos((double)phi) * sin_theta, (real_t)cos((double)theta),
+					   -(real_t)sin((double)phi) * sin_theta);
+	*pdf = envmap_pdf(env, dir);
+	return *pdf > (real_t)0.0;
+}
+
+#endif
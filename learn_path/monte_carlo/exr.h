@@ -0,0 +1,251 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   exr.h                                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/08 17:03:12 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/08 17:03:12 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef EXR_H
+#define EXR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tile.h"
+#include "lode_image.h"
+
+/* Minimal OpenEXR encoder: single part, tiled, one level, half-float R, G,
+   B. Tiles may be written in any order (line order RANDOM_Y); the offset
+   table after the header is reserved up front and filled in at the end, so
+   tiles go to disk as soon as they are encoded. Each tile is stored raw or
+   ZIP-compressed (byte split, delta predictor, zlib), whichever is smaller,
+   as OpenEXR readers expect. Half floats keep about 3 significant digits
+   over 2^-24 .. 65504, plenty for re-exposing or compositing a render. */
+
+#define EXR_TILE_SIZE 64
+#define EXR_CHUNK_HEADER 20 /* tile x, tile y, level x, level y, data size */
+
+/* IEEE 754 binary16 nearest to f (ties to even); overflow goes to infinity */
+static inline uint16_t half_from_float(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000U;
+	uint32_t mag = x & 0x7FFFFFFFU;
+	if (mag >= 0x7F800000U)
+		return (uint16_t)(sign | 0x7C00U | (mag > 0x7F800000U ? 0x200U : 0U));
+	if (mag >= 0x477FF000U) /* 65520 and up round past the largest half */
+		return (uint16_t)(sign | 0x7C00U);
+	if (mag < 0x38800000U) /* below 2^-14: denormal half */
+	{
+		if (mag < 0x33000000U)
+			return (uint16_t)sign;
+		uint32_t m = (mag & 0x7FFFFFU) | 0x800000U;
+		uint32_t shift = 126U - (mag >> 23);
+		uint32_t h = m >> shift;
+		uint32_t rem = m & ((1U << shift) - 1U);
+		uint32_t halfway = 1U << (shift - 1U);
+		if (rem > halfway || (rem == halfway && (h & 1U)))
+			++h;
+		return (uint16_t)(sign | h);
+	}
+	uint32_t h = (mag >> 13) - (112U << 10);
+	uint32_t rem = mag & 0x1FFFU;
+	if (rem > 0x1000U || (rem == 0x1000U && (h & 1U)))
+		++h;
+	return (uint16_t)(sign | h);
+}
+
+static inline unsigned char *exr_put_u32(unsigned char *p, uint32_t v)
+{
+	for (int k = 0; k < 4; ++k)
+		*p++ = (unsigned char)(v >> (8 * k));
+	return p;
+}
+
+static inline unsigned char *exr_put_u64(unsigned char *p, uint64_t v)
+{
+	for (int k = 0; k < 8; ++k)
+		*p++ = (unsigned char)(v >> (8 * k));
+	return p;
+}
+
+static inline unsigned char *exr_put_float(unsigned char *p, float f)
+{
+	uint32_t v;
+	memcpy(&v, &f, sizeof(v));
+	return exr_put_u32(p, v);
+}
+
+/* Attribute header: name, type, value size */
+static inline unsigned char *exr_put_attr(unsigned char *p, const char *name, const char *type, uint32_t size)
+{
+	size_t n = strlen(name) + 1;
+	memcpy(p, name, n);
+	p += n;
+	n = strlen(type) + 1;
+	memcpy(p, type, n);
+	p += n;
+	return exr_put_u32(p, size);
+}
+
+static inline unsigned char *exr_put_box(unsigned char *p, int x0, int y0, int x1, int y1)
+{
+	p = exr_put_u32(p, (uint32_t)x0);
+	p = exr_put_u32(p, (uint32_t)y0);
+	p = exr_put_u32(p, (uint32_t)x1);
+	return exr_put_u32(p, (uint32_t)y1);
+}
+
+/* Tiles across and down a data window */
+static inline void exr_tile_grid(const t_tile *window, int tile_size, int *nx, int *ny)
+{
+	*nx = (window->x1 - window->x0 + tile_size - 1) / tile_size;
+	*ny = (window->y1 - window->y0 + tile_size - 1) / tile_size;
+}
+
+/* Write the header of a width x height image whose pixels cover `window`,
+   then a zeroed offset table; *table_pos gets the table's file offset */
+static inline bool exr_write_header(FILE *f, const t_tile *window, int width, int height, bool zip,
+									long *table_pos)
+{
+	unsigned char buf[512];
+	unsigned char *p = buf;
+	static const char *const channels[3] = {"B", "G", "R"}; /* sorted by name */
+	p = exr_put_u32(p, 20000630U);
+	p = exr_put_u32(p, 2U | 0x200U); /* version 2, tiled */
+	p = exr_put_attr(p, "channels", "chlist", 3 * 18 + 1);
+	for (int c = 0; c < 3; ++c)
+	{
+		*p++ = (unsigned char)channels[c][0];
+		*p++ = 0;
+		p = exr_put_u32(p, 1U); /* HALF */
+		memset(p, 0, 4);		/* pLinear, reserved */
+		p += 4;
+		p = exr_put_u32(p, 1U);
+		p = exr_put_u32(p, 1U);
+	}
+	*p++ = 0;
+	p = exr_put_attr(p, "compression", "compression", 1);
+	*p++ = zip ? 3 : 0; /* ZIP_COMPRESSION : NO_COMPRESSION */
+	p = exr_put_attr(p, "dataWindow", "box2i", 16);
+	p = exr_put_box(p, window->x0, window->y0, window->x1 - 1, window->y1 - 1);
+	p = exr_put_attr(p, "displayWindow", "box2i", 16);
+	p = exr_put_box(p, 0, 0, width - 1, height - 1);
+	p = exr_put_attr(p, "lineOrder", "lineOrder", 1);
+	*p++ = 2; /* RANDOM_Y */
+	p = exr_put_attr(p, "pixelAspectRatio", "float", 4);
+	p = exr_put_float(p, 1.0f);
+	p = exr_put_attr(p, "screenWindowCenter", "v2f", 8);
+	p = exr_put_float(p, 0.0f);
+	p = exr_put_float(p, 0.0f);
+	p = exr_put_attr(p, "screenWindowWidth", "float", 4);
+	p = exr_put_float(p, 1.0f);
+	p = exr_put_attr(p, "tiles", "tiledesc", 9);
+	p = exr_put_u32(p, EXR_TILE_SIZE);
+	p = exr_put_u32(p, EXR_TILE_SIZE);
+	*p++ = 0; /* ONE_LEVEL, ROUND_DOWN */
+	*p++ = 0;
+	if (fwrite(buf, 1, (size_t)(p - buf), f) != (size_t)(p - buf))
+		return false;
+	*table_pos = ftell(f);
+	int nx;
+	int ny;
+	exr_tile_grid(window, EXR_TILE_SIZE, &nx, &ny);
+	memset(buf, 0, 8);
+	for (long t = 0; t < (long)nx * ny; ++t)
+		if (fwrite(buf, 1, 8, f) != 8)
+			return false;
+	return *table_pos >= 0;
+}
+
+/* Fill in the offset table (one file offset per tile, row by row) */
+static inline bool exr_write_offsets(FILE *f, long table_pos, const uint64_t *offsets, int count)
+{
+	if (fseek(f, table_pos, SEEK_SET) != 0)
+		return false;
+	unsigned char buf[8];
+	for (int t = 0; t < count; ++t)
+	{
+		exr_put_u64(buf, offsets[t]);
+		if (fwrite(buf, 1, 8, f) != 8)
+			return false;
+	}
+	return fseek(f, 0, SEEK_END) == 0;
+}
+
+/* Encode a tile of w x h half RGB pixels (rgb, row stride in pixels) as a
+   chunk: header then data, planar per scanline in channel order B, G, R.
+   Returns the malloc'd chunk and its size, NULL when out of memory. */
+static inline unsigned char *exr_encode_tile(const uint16_t *rgb, size_t stride, int w, int h, int tile_x,
+											 int tile_y, bool zip, size_t *chunk_size)
+{
+	size_t raw_size = (size_t)w * (size_t)h * 3 * sizeof(uint16_t);
+	unsigned char *chunk = (unsigned char *)malloc(EXR_CHUNK_HEADER + raw_size);
+	unsigned char *tmp = zip ? (unsigned char *)malloc(raw_size) : NULL;
+	if (!chunk || (zip && !tmp))
+	{
+		free(chunk);
+		free(tmp);
+		return NULL;
+	}
+	unsigned char *raw = chunk + EXR_CHUNK_HEADER;
+	unsigned char *p = raw;
+	for (int y = 0; y < h; ++y)
+		for (int c = 2; c >= 0; --c)
+			for (int x = 0; x < w; ++x)
+			{
+				uint16_t v = rgb[(size_t)y * stride * 3 + (size_t)x * 3 + (size_t)c];
+				*p++ = (unsigned char)(v & 0xFF);
+				*p++ = (unsigned char)(v >> 8);
+			}
+	size_t data_size = raw_size;
+	if (zip)
+	{
+		/* Even bytes then odd bytes, then deltas: smooth data turns into runs */
+		unsigned char *lo = tmp;
+		unsigned char *hi = tmp + (raw_size + 1) / 2;
+		for (size_t k = 0; k < raw_size; k += 2)
+		{
+			*lo++ = raw[k];
+			if (k + 1 < raw_size)
+				*hi++ = raw[k + 1];
+		}
+		int prev = tmp[0];
+		for (size_t k = 1; k < raw_size; ++k)
+		{
+			int d = (int)tmp[k] - prev + (128 + 256);
+			prev = tmp[k];
+			tmp[k] = (unsigned char)d;
+		}
+		LodePNGCompressSettings settings;
+		lodepng_compress_settings_init(&settings);
+		settings.windowsize = 32768;
+		unsigned char *packed = NULL;
+		size_t packed_size = 0;
+		if (zlib_compress(&packed, &packed_size, tmp, raw_size, &settings) == 0 && packed_size < raw_size)
+		{
+			memcpy(raw, packed, packed_size);
+			data_size = packed_size;
+		}
+		lodepng_free(packed);
+		free(tmp);
+	}
+	unsigned char *q = chunk;
+	q = exr_put_u32(q, (uint32_t)tile_x);
+	q = exr_put_u32(q, (uint32_t)tile_y);
+	q = exr_put_u32(q, 0U);
+	q = exr_put_u32(q, 0U);
+	exr_put_u32(q, (uint32_t)data_size);
+	*chunk_size = EXR_CHUNK_HEADER + data_size;
+	return chunk;
+}
+
+#endif
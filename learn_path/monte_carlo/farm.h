@@ -0,0 +1,355 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   farm.h                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/07 17:12:40 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/07 17:12:40 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FARM_H
+#define FARM_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "framebuffer.h"
+#include "tile.h"
+
+/* Render farm of local worker processes. The coordinator forks the workers,
+   which share the scene copy-on-write, and hands out tile indices over one
+   command pipe per worker, a couple ahead so no worker waits. A worker
+   renders each tile into its copy of the accumulator, single threaded (an
+   OpenMP runtime does not survive fork), and streams the tile's pixels back
+   over its result pipe; the coordinator copies them into its own buffers.
+   Samples are a pure function of (seed, pixel, sample index), so the merged
+   image matches a single-process render bit for bit. */
+
+#define FARM_PREFETCH 2		 /* tiles queued ahead in each worker */
+#define FARM_MAX_BUFFERS 10 /* accumulator arrays a worker sends back */
+
+typedef struct s_farm_job
+{
+	/* Runs in a worker: add the tile's samples to acc */
+	void (*render)(void *ctx, const t_tile *tile, t_accum *acc);
+	/* Runs in the coordinator once a tile is merged (may be NULL) */
+	void (*progress)(void *ctx, const t_tile *tile, int tiles_left);
+	void *ctx;
+} t_farm_job;
+
+typedef struct s_farm_buffer
+{
+	unsigned char *data;
+	size_t elem;
+} t_farm_buffer;
+
+typedef struct s_farm_worker
+{
+	pid_t pid;
+	int cmd_fd;	   /* coordinator -> worker: int32 tile index, -1 = stop */
+	int result_fd; /* worker -> coordinator: int32 tile index, then its pixels */
+	int in_flight;
+} t_farm_worker;
+
+/* The accumulator arrays a tile render writes (the converged map is only
+   updated by the coordinator, between passes) */
+static inline int farm_buffers(const t_accum *acc, t_farm_buffer *out)
+{
+	int n = 0;
+	out[n++] = (t_farm_buffer){(unsigned char *)acc->sum, sizeof(t_vec3)};
+	if (acc->count)
+	{
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->count, sizeof(int)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->lum_sq, sizeof(float)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->lum, sizeof(float)};
+	}
+	if (acc->albedo)
+	{
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->albedo, sizeof(t_vec3)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->normal, sizeof(t_vec3)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->depth, sizeof(float)};
+	}
+	if (acc->direct)
+	{
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->direct, sizeof(t_vec3)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->material_id, sizeof(uint32_t)};
+		out[n++] = (t_farm_buffer){(unsigned char *)acc->object_id, sizeof(uint32_t)};
+	}
+	return n;
+}
+
+/* Bytes of one pixel across all buffers */
+static inline size_t farm_pixel_bytes(const t_farm_buffer *bufs, int count)
+{
+	size_t bytes = 0;
+	for (int b = 0; b < count; ++b)
+		bytes += bufs[b].elem;
+	return bytes;
+}
+
+/* Copy the tile's rows of every buffer into packed (to_packed) or back out of it */
+static inline void farm_tile_copy(const t_accum *acc, const t_farm_buffer *bufs, int count,
+								  const t_tile *tile, unsigned char *packed, bool to_packed)
+{
+	size_t row = (size_t)(tile->x1 - tile->x0);
+	for (int b = 0; b < count; ++b)
+		for (int y = tile->y0; y < tile->y1; ++y)
+		{
+			unsigned char *px = bufs[b].data + ((size_t)y * (size_t)acc->width + (size_t)tile->x0) * bufs[b].elem;
+			if (to_packed)
+				memcpy(packed, px, row * bufs[b].elem);
+			else
+				memcpy(px, packed, row * bufs[b].elem);
+			packed += row * bufs[b].elem;
+		}
+}
+
+static inline bool farm_write_all(int fd, const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	while (size > 0)
+	{
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+static inline bool farm_read_all(int fd, void *data, size_t size)
+{
+	unsigned char *p = (unsigned char *)data;
+	while (size > 0)
+	{
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+/* Worker loop: render the tiles the coordinator names until told to stop */
+static inline void farm_worker_main(t_accum *acc, const t_tile *tiles, int tile_count,
+									const t_farm_job *job, int cmd_fd, int result_fd)
+{
+	t_farm_buffer bufs[FARM_MAX_BUFFERS];
+	int nbufs = farm_buffers(acc, bufs);
+	size_t pixel_bytes = farm_pixel_bytes(bufs, nbufs);
+	unsigned char *packed = NULL;
+	size_t packed_size = 0;
+	int32_t t;
+	int status = 0;
+	while (farm_read_all(cmd_fd, &t, sizeof(t)) && t >= 0 && t < tile_count)
+	{
+		const t_tile *tile = &tiles[t];
+		size_t size = (size_t)tile_area(tile) * pixel_bytes;
+		if (size > packed_size)
+		{
+			free(packed);
+			packed = (unsigned char *)malloc(size);
+			packed_size = packed ? size : 0;
+		}
+		if (!packed)
+		{
+			status = 1;
+			break;
+		}
+		job->render(job->ctx, tile, acc);
+		farm_tile_copy(acc, bufs, nbufs, tile, packed, true);
+		if (!farm_write_all(result_fd, &t, sizeof(t)) || !farm_write_all(result_fd, packed, size))
+		{
+			status = 1;
+			break;
+		}
+	}
+	free(packed);
+	_exit(status); /* skip atexit handlers and the coordinator's stdio buffers */
+}
+
+/* Hand the next tile to worker w, or tell it to stop once none are left */
+static inline bool farm_dispatch(t_farm_worker *w, int *next_tile, int tile_count)
+{
+	int32_t t = (*next_tile < tile_count) ? (int32_t)(*next_tile)++ : -1;
+	if (!farm_write_all(w->cmd_fd, &t, sizeof(t)))
+		return false;
+	if (t >= 0)
+		++w->in_flight;
+	else
+	{
+		close(w->cmd_fd);
+		w->cmd_fd = -1;
+	}
+	return true;
+}
+
+/* Stop every worker (closing a command pipe ends its loop) and reap it.
+   Returns false if one of them failed. */
+static inline bool farm_shutdown(t_farm_worker *workers, int count)
+{
+	bool ok = true;
+	for (int k = 0; k < count; ++k)
+	{
+		if (workers[k].cmd_fd >= 0)
+			close(workers[k].cmd_fd);
+		if (workers[k].result_fd >= 0)
+			close(workers[k].result_fd);
+		workers[k].cmd_fd = -1;
+		workers[k].result_fd = -1;
+	}
+	for (int k = 0; k < count; ++k)
+	{
+		int status = 0;
+		if (workers[k].pid <= 0)
+			continue;
+		while (waitpid(workers[k].pid, &status, 0) < 0)
+			if (errno != EINTR)
+			{
+				status = 1;
+				break;
+			}
+		ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+	return ok;
+}
+
+/* Render every tile with worker_count processes and merge their pixels into
+   acc. Returns false if a worker could not be started or failed. */
+static inline bool farm_render(t_accum *acc, const t_tile *tiles, int tile_count,
+							   int worker_count, const t_farm_job *job)
+{
+	if (worker_count > tile_count)
+		worker_count = tile_count;
+	if (worker_count < 1)
+		return true;
+	t_farm_buffer bufs[FARM_MAX_BUFFERS];
+	int nbufs = farm_buffers(acc, bufs);
+	size_t pixel_bytes = farm_pixel_bytes(bufs, nbufs);
+	t_farm_worker *workers = (t_farm_worker *)calloc((size_t)worker_count, sizeof(t_farm_worker));
+	struct pollfd *fds = (struct pollfd *)calloc((size_t)worker_count, sizeof(struct pollfd));
+	int max_area = 0;
+	for (int t = 0; t < tile_count; ++t)
+		if (tile_area(&tiles[t]) > max_area)
+			max_area = tile_area(&tiles[t]);
+	unsigned char *packed = (unsigned char *)malloc((size_t)max_area * pixel_bytes);
+	if (!workers || !fds || !packed)
+	{
+		free(workers);
+		free(fds);
+		free(packed);
+		return false;
+	}
+
+	/* Start the workers; each closes the pipe ends that are not its own */
+	fflush(NULL);
+	bool ok = true;
+	int started = 0;
+	for (int k = 0; ok && k < worker_count; ++k)
+	{
+		int cmd[2];
+		int result[2];
+		if (pipe(cmd) != 0)
+		{
+			ok = false;
+			break;
+		}
+		if (pipe(result) != 0)
+		{
+			close(cmd[0]);
+			close(cmd[1]);
+			ok = false;
+			break;
+		}
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			for (int o = 0; o < started; ++o)
+			{
+				close(workers[o].cmd_fd);
+				close(workers[o].result_fd);
+			}
+			close(cmd[1]);
+			close(result[0]);
+			farm_worker_main(acc, tiles, tile_count, job, cmd[0], result[1]);
+		}
+		close(cmd[0]);
+		close(result[1]);
+		if (pid < 0)
+		{
+			close(cmd[1]);
+			close(result[0]);
+			ok = false;
+			break;
+		}
+		workers[k] = (t_farm_worker){pid, cmd[1], result[0], 0};
+		++started;
+	}
+
+	/* Prime every worker, then refill each one as its tiles come back */
+	int next_tile = 0;
+	int tiles_left = tile_count;
+	for (int f = 0; f < FARM_PREFETCH; ++f)
+		for (int k = 0; ok && k < started; ++k)
+			if (workers[k].cmd_fd >= 0)
+				ok = farm_dispatch(&workers[k], &next_tile, tile_count);
+	while (ok && tiles_left > 0)
+	{
+		for (int k = 0; k < started; ++k)
+		{
+			fds[k].fd = (workers[k].in_flight > 0) ? workers[k].result_fd : -1;
+			fds[k].events = POLLIN;
+			fds[k].revents = 0;
+		}
+		if (poll(fds, (nfds_t)started, -1) < 0)
+		{
+			ok = (errno == EINTR);
+			continue;
+		}
+		for (int k = 0; ok && k < started; ++k)
+		{
+			if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			int32_t t;
+			ok = farm_read_all(workers[k].result_fd, &t, sizeof(t)) && t >= 0 && t < tile_count;
+			if (!ok)
+				break;
+			const t_tile *tile = &tiles[t];
+			ok = farm_read_all(workers[k].result_fd, packed, (size_t)tile_area(tile) * pixel_bytes);
+			if (!ok)
+				break;
+			farm_tile_copy(acc, bufs, nbufs, tile, packed, false);
+			--workers[k].in_flight;
+			--tiles_left;
+			if (job->progress)
+				job->progress(job->ctx, tile, tiles_left);
+			if (workers[k].cmd_fd >= 0)
+				ok = farm_dispatch(&workers[k], &next_tile, tile_count);
+		}
+	}
+	if (!ok)
+		fprintf(stderr, "\nError: render worker failed\n");
+	ok = farm_shutdown(workers, started) && ok;
+	free(workers);
+	free(fds);
+	free(packed);
+	return ok;
+}
+
+#endif
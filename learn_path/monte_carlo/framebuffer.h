@@ -0,0 +1,490 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   framebuffer.h                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/06 09:15:48 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/06 09:15:48 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "vector.h"
+#include "stats.h"
+#include "tile.h"
+
+/* Accumulation buffer for progressive rendering: every pass adds its samples
+   to per-pixel sums, the image is sum / samples. The whole state can be
+   checkpointed to disk and loaded back to resume an interrupted render.
+
+   With per-pixel stats (adaptive or time-budgeted renders) each pixel also
+   keeps its own sample count and luminance moments, so its variance is
+   known; pixels whose confidence interval is small enough are marked
+   converged and receive no more samples. A pass cut short by a deadline
+   leaves some pixels one pass behind, which the counts account for.
+
+   With guides (denoising, AOVs), each pixel also sums the albedo, normal and
+   depth of its samples' first non-specular hit; with AOV layers it also sums
+   the direct light of its samples and keeps the material and object ids
+   seen by its first sample.
+
+   A bucket is an accumulator for a single tile (x0, y0 = its corner in the
+   image): out-of-core renders sample each tile completely in one, hand it
+   to the image writer and reuse it for the next tile. */
+
+#define ACCUM_MAGIC "RTACCUM4"
+#define ACCUM_FLAG_PIXEL_STATS 1
+#define ACCUM_FLAG_GUIDES 2
+#define ACCUM_FLAG_LAYERS 4
+#define ACCUM_FLAG_FLOAT 8 /* written by a single-precision build */
+
+#define ADAPTIVE_Z 1.96			/* 95% confidence interval */
+#define ADAPTIVE_DARK_FLOOR 0.01 /* error is relative to max(mean, floor) */
+
+typedef struct s_accum
+{
+	int width;
+	int height;
+	int x0;			   /* image pixel of sum[0]: 0, 0 except for buckets */
+	int y0;
+	int samples;	   /* samples per pixel accumulated so far (most-sampled active pixels) */
+	int total_samples; /* samples per pixel of the finished image (average when adaptive) */
+	t_vec3 *sum;
+	int *count;				 /* per-pixel stats: samples of each pixel, NULL otherwise */
+	float *lum_sq;			 /* per-pixel stats: sum of squared sample luminance */
+	float *lum;				 /* per-pixel stats: sum of sample luminance */
+	unsigned char *converged; /* per-pixel stats: 1 once a pixel stops sampling */
+	t_vec3 *albedo;			 /* guides: sum of first-hit albedo, NULL otherwise */
+	t_vec3 *normal;			 /* guides: sum of first-hit normals */
+	float *depth;			 /* guides: sum of first-hit distances (0 = sky) */
+	t_vec3 *direct;			 /* layers: sum of direct light, NULL otherwise */
+	uint32_t *material_id;	 /* layers: first-hit material of sample 0 (0 = none) */
+	uint32_t *object_id;	 /* layers: first-hit object of sample 0 (0 = none) */
+} t_accum;
+
+typedef struct s_accum_header
+{
+	char magic[8];
+	int32_t width;
+	int32_t height;
+	int32_t samples;
+	int32_t total_samples;
+	int32_t flags;
+	int32_t crop[4]; /* rendered window: x0, y0, x1, y1 */
+	int32_t sampler; /* t_sampler_kind of the sample sequence */
+	uint64_t seed;
+} t_accum_header;
+
+/* What the accumulated samples depend on besides the image and sample
+   budget: the window rendered and the (seed, sampler) sequence. Resuming
+   with another key would mix two sequences. */
+typedef struct s_accum_key
+{
+	t_tile window;
+	uint64_t seed;
+	int sampler;
+} t_accum_key;
+
+static inline bool accum_init(t_accum *acc, int width, int height, int total_samples)
+{
+	acc->width = width;
+	acc->height = height;
+	acc->x0 = 0;
+	acc->y0 = 0;
+	acc->samples = 0;
+	acc->total_samples = total_samples;
+	acc->count = NULL;
+	acc->lum_sq = NULL;
+	acc->lum = NULL;
+	acc->converged = NULL;
+	acc->albedo = NULL;
+	acc->normal = NULL;
+	acc->depth = NULL;
+	acc->direct = NULL;
+	acc->material_id = NULL;
+	acc->object_id = NULL;
+	acc->sum = (t_vec3 *)calloc((size_t)width * (size_t)height, sizeof(t_vec3));
+	return acc->sum != NULL;
+}
+
+static inline void accum_destroy(t_accum *acc)
+{
+	free(acc->sum);
+	free(acc->count);
+	free(acc->lum_sq);
+	free(acc->lum);
+	free(acc->converged);
+	free(acc->albedo);
+	free(acc->normal);
+	free(acc->depth);
+	free(acc->direct);
+	free(acc->material_id);
+	free(acc->object_id);
+	acc->sum = NULL;
+	acc->count = NULL;
+	acc->lum_sq = NULL;
+	acc->lum = NULL;
+	acc->converged = NULL;
+	acc->albedo = NULL;
+	acc->normal = NULL;
+	acc->depth = NULL;
+	acc->direct = NULL;
+	acc->material_id = NULL;
+	acc->object_id = NULL;
+}
+
+/* Allocate the per-pixel statistics used by adaptive and time-budgeted renders */
+static inline bool accum_enable_pixel_stats(t_accum *acc)
+{
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	acc->count = (int *)calloc(n, sizeof(int));
+	acc->lum_sq = (float *)calloc(n, sizeof(float));
+	acc->lum = (float *)calloc(n, sizeof(float));
+	acc->converged = (unsigned char *)calloc(n, 1);
+	if (!acc->count || !acc->lum_sq || !acc->lum || !acc->converged)
+	{
+		free(acc->count);
+		free(acc->lum_sq);
+		free(acc->lum);
+		free(acc->converged);
+		acc->count = NULL;
+		acc->lum_sq = NULL;
+		acc->lum = NULL;
+		acc->converged = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* Allocate the first-hit guide buffers used by the denoiser */
+static inline bool accum_enable_guides(t_accum *acc)
+{
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	acc->albedo = (t_vec3 *)calloc(n, sizeof(t_vec3));
+	acc->normal = (t_vec3 *)calloc(n, sizeof(t_vec3));
+	acc->depth = (float *)calloc(n, sizeof(float));
+	if (!acc->albedo || !acc->normal || !acc->depth)
+	{
+		free(acc->albedo);
+		free(acc->normal);
+		free(acc->depth);
+		acc->albedo = NULL;
+		acc->normal = NULL;
+		acc->depth = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* Allocate the direct-light and id layers written as AOVs */
+static inline bool accum_enable_layers(t_accum *acc)
+{
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	acc->direct = (t_vec3 *)calloc(n, sizeof(t_vec3));
+	acc->material_id = (uint32_t *)calloc(n, sizeof(uint32_t));
+	acc->object_id = (uint32_t *)calloc(n, sizeof(uint32_t));
+	if (!acc->direct || !acc->material_id || !acc->object_id)
+	{
+		free(acc->direct);
+		free(acc->material_id);
+		free(acc->object_id);
+		acc->direct = NULL;
+		acc->material_id = NULL;
+		acc->object_id = NULL;
+		return false;
+	}
+	return true;
+}
+
+static inline int accum_flags(const t_accum *acc)
+{
+	return (acc->count ? ACCUM_FLAG_PIXEL_STATS : 0) | (acc->albedo ? ACCUM_FLAG_GUIDES : 0)
+		   | (acc->direct ? ACCUM_FLAG_LAYERS : 0) | (sizeof(real_t) == sizeof(float) ? ACCUM_FLAG_FLOAT : 0);
+}
+
+/* A bucket holding up to `pixels` pixels (sums only); see accum_bucket_place */
+static inline bool accum_bucket_init(t_accum *acc, int pixels, int total_samples)
+{
+	return accum_init(acc, pixels, 1, total_samples);
+}
+
+/* Move a bucket onto the width x height pixels at (x0, y0), cleared */
+static inline void accum_bucket_place(t_accum *acc, int x0, int y0, int width, int height)
+{
+	acc->x0 = x0;
+	acc->y0 = y0;
+	acc->width = width;
+	acc->height = height;
+	acc->samples = 0;
+	memset(acc->sum, 0, (size_t)width * (size_t)height * sizeof(t_vec3));
+}
+
+/* Index of image pixel (i, j) in the buffers */
+static inline size_t accum_index(const t_accum *acc, int i, int j)
+{
+	return (size_t)(j - acc->y0) * (size_t)acc->width + (size_t)(i - acc->x0);
+}
+
+static inline int accum_pixel_samples(const t_accum *acc, size_t idx)
+{
+	return acc->count ? acc->count[idx] : acc->samples;
+}
+
+/* Current estimate of pixel (i, j) */
+static inline t_vec3 accum_pixel(const t_accum *acc, int i, int j)
+{
+	size_t idx = accum_index(acc, i, j);
+	int n = accum_pixel_samples(acc, idx);
+	if (n <= 0)
+		return vec3_zero();
+	return vec3_div_scalar(&acc->sum[idx], (real_t)n);
+}
+
+/* True when the confidence interval of pixel idx's mean luminance is within
+   max_error of the mean (darks are compared against ADAPTIVE_DARK_FLOOR) */
+static inline bool accum_pixel_converged(const t_accum *acc, size_t idx, double max_error)
+{
+	int n = acc->count[idx];
+	if (n < 2)
+		return false;
+	double mean = (double)acc->lum[idx] / n;
+	double var = ((double)acc->lum_sq[idx] - (double)n * mean * mean) / (double)(n - 1);
+	if (var < 0.0)
+		var = 0.0;
+	double half_width = ADAPTIVE_Z * sqrt(var / (double)n);
+	double ref = (mean > ADAPTIVE_DARK_FLOOR) ? mean : ADAPTIVE_DARK_FLOOR;
+	return half_width <= max_error * ref;
+}
+
+/* Mark pixels that reached min_samples and max_error (> 0) as converged. A pixel
+   only stops once its 3x3 neighbourhood passes the test too, so a pixel that
+   simply has not found a light yet is kept alive by its noisy neighbours.
+   Returns the number of pixels still sampling; *spent gets the samples
+   taken so far over the whole image. */
+static inline long accum_update_convergence(t_accum *acc, double max_error, int min_samples, long *spent)
+{
+	enum { OPEN = 0, DONE = 1, PASSES = 2, STOPS = 3 };
+	int w = acc->width;
+	int h = acc->height;
+	unsigned char *c = acc->converged;
+	long total = 0;
+	for (size_t k = 0; k < (size_t)w * (size_t)h; ++k)
+	{
+		total += acc->count[k];
+		if (c[k] == OPEN && max_error > 0.0 && acc->count[k] >= min_samples
+			&& accum_pixel_converged(acc, k, max_error))
+			c[k] = PASSES;
+	}
+	for (int j = 0; j < h; ++j)
+		for (int i = 0; i < w; ++i)
+		{
+			if (c[j * w + i] != PASSES)
+				continue;
+			bool stop = true;
+			for (int dj = -1; dj <= 1 && stop; ++dj)
+				for (int di = -1; di <= 1; ++di)
+				{
+					int x = i + di;
+					int y = j + dj;
+					if (x >= 0 && x < w && y >= 0 && y < h && c[y * w + x] == OPEN)
+					{
+						stop = false;
+						break;
+					}
+				}
+			if (stop)
+				c[j * w + i] = STOPS;
+		}
+	long active = 0;
+	for (size_t k = 0; k < (size_t)w * (size_t)h; ++k)
+	{
+		c[k] = (c[k] == DONE || c[k] == STOPS) ? DONE : OPEN;
+		active += (c[k] == OPEN);
+	}
+	*spent = total;
+	return active;
+}
+
+/* Write header + sums to `path`, through a temporary file renamed into place
+   so an interrupted write never corrupts the previous checkpoint. `key`
+   identifies the samples; only its window's pixels hold any. */
+static inline bool accum_save(const t_accum *acc, const t_accum_key *key, const char *path)
+{
+	char tmp[512];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *f = fopen(tmp, "wb");
+	if (!f)
+		return false;
+
+	t_accum_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, ACCUM_MAGIC, sizeof(hdr.magic));
+	hdr.width = acc->width;
+	hdr.height = acc->height;
+	hdr.samples = acc->samples;
+	hdr.total_samples = acc->total_samples;
+	hdr.flags = accum_flags(acc);
+	hdr.crop[0] = key->window.x0;
+	hdr.crop[1] = key->window.y0;
+	hdr.crop[2] = key->window.x1;
+	hdr.crop[3] = key->window.y1;
+	hdr.sampler = key->sampler;
+	hdr.seed = key->seed;
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(acc->sum, sizeof(t_vec3), n, f) == n;
+	if (ok && acc->count)
+		ok = fwrite(acc->count, sizeof(int), n, f) == n
+			 && fwrite(acc->lum_sq, sizeof(float), n, f) == n
+			 && fwrite(acc->lum, sizeof(float), n, f) == n
+			 && fwrite(acc->converged, 1, n, f) == n;
+	if (ok && acc->albedo)
+		ok = fwrite(acc->albedo, sizeof(t_vec3), n, f) == n
+			 && fwrite(acc->normal, sizeof(t_vec3), n, f) == n
+			 && fwrite(acc->depth, sizeof(float), n, f) == n;
+	if (ok && acc->direct)
+		ok = fwrite(acc->direct, sizeof(t_vec3), n, f) == n
+			 && fwrite(acc->material_id, sizeof(uint32_t), n, f) == n
+			 && fwrite(acc->object_id, sizeof(uint32_t), n, f) == n;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok || rename(tmp, path) != 0)
+	{
+		remove(tmp);
+		return false;
+	}
+	return true;
+}
+
+/* Load a checkpoint written for the same image size, key, sample budget and
+   buffers */
+static inline bool accum_load(t_accum *acc, const t_accum_key *key, const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return false;
+	t_accum_header hdr;
+	bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1
+			  && memcmp(hdr.magic, ACCUM_MAGIC, sizeof(hdr.magic)) == 0
+			  && hdr.width == acc->width && hdr.height == acc->height
+			  && hdr.total_samples == acc->total_samples
+			  && hdr.flags == accum_flags(acc)
+			  && hdr.crop[0] == key->window.x0 && hdr.crop[1] == key->window.y0
+			  && hdr.crop[2] == key->window.x1 && hdr.crop[3] == key->window.y1
+			  && hdr.sampler == key->sampler && hdr.seed == key->seed
+			  && hdr.samples >= 0 && (acc->count || hdr.samples <= hdr.total_samples);
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	if (ok)
+		ok = fread(acc->sum, sizeof(t_vec3), n, f) == n;
+	if (ok && acc->count)
+		ok = fread(acc->count, sizeof(int), n, f) == n
+			 && fread(acc->lum_sq, sizeof(float), n, f) == n
+			 && fread(acc->lum, sizeof(float), n, f) == n
+			 && fread(acc->converged, 1, n, f) == n;
+	if (ok && acc->albedo)
+		ok = fread(acc->albedo, sizeof(t_vec3), n, f) == n
+			 && fread(acc->normal, sizeof(t_vec3), n, f) == n
+			 && fread(acc->depth, sizeof(float), n, f) == n;
+	if (ok && acc->direct)
+		ok = fread(acc->direct, sizeof(t_vec3), n, f) == n
+			 && fread(acc->material_id, sizeof(uint32_t), n, f) == n
+			 && fread(acc->object_id, sizeof(uint32_t), n, f) == n;
+	fclose(f);
+	if (!ok)
+	{
+		memset(acc->sum, 0, n * sizeof(t_vec3));
+		if (acc->count)
+		{
+			memset(acc->count, 0, n * sizeof(int));
+			memset(acc->lum_sq, 0, n * sizeof(float));
+			memset(acc->lum, 0, n * sizeof(float));
+			memset(acc->converged, 0, n);
+		}
+		if (acc->albedo)
+		{
+			memset(acc->albedo, 0, n * sizeof(t_vec3));
+			memset(acc->normal, 0, n * sizeof(t_vec3));
+			memset(acc->depth, 0, n * sizeof(float));
+		}
+		if (acc->direct)
+		{
+			memset(acc->direct, 0, n * sizeof(t_vec3));
+			memset(acc->material_id, 0, n * sizeof(uint32_t));
+			memset(acc->object_id, 0, n * sizeof(uint32_t));
+		}
+		return false;
+	}
+	acc->samples = hdr.samples;
+	return true;
+}
+
+/* Write the per-pixel sample count as a binary PPM heatmap (linear scale) */
+static inline bool accum_write_sample_map(const t_accum *acc, const char *filename)
+{
+	if (!acc->count)
+		return false;
+	size_t n = (size_t)acc->width * (size_t)acc->height;
+	int max_count = 1;
+	for (size_t k = 0; k < n; ++k)
+		if (acc->count[k] > max_count)
+			max_count = acc->count[k];
+
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+		return false;
+	fprintf(f, "P6\n%d %d\n255\n", acc->width, acc->height);
+	unsigned char *row = (unsigned char *)malloc((size_t)acc->width * 3);
+	if (!row)
+	{
+		fclose(f);
+		return false;
+	}
+	for (int j = 0; j < acc->height; ++j)
+	{
+		for (int i = 0; i < acc->width; ++i)
+		{
+			int c = acc->count[(size_t)j * (size_t)acc->width + (size_t)i];
+			stats_heat_color((float)c / (float)max_count, &row[i * 3]);
+		}
+		fwrite(row, 1, (size_t)acc->width * 3, f);
+	}
+	free(row);
+	return fclose(f) == 0;
+}
+
+/* One-line summary of where the samples went inside the rendered window */
+static inline void accum_print_sample_summary(const t_accum *acc, const t_tile *window)
+{
+	if (!acc->count || tile_area(window) <= 0)
+		return;
+	size_t first = (size_t)window->y0 * (size_t)acc->width + (size_t)window->x0;
+	long total = 0;
+	long converged = 0;
+	int lo = acc->count[first];
+	int hi = acc->count[first];
+	for (int j = window->y0; j < window->y1; ++j)
+		for (int i = window->x0; i < window->x1; ++i)
+		{
+			size_t k = (size_t)j * (size_t)acc->width + (size_t)i;
+			total += acc->count[k];
+			converged += acc->converged[k];
+			if (acc->count[k] < lo)
+				lo = acc->count[k];
+			if (acc->count[k] > hi)
+				hi = acc->count[k];
+		}
+	double n = (double)tile_area(window);
+	fprintf(stderr, "Adaptive sampling: %.1f spp average (min %d, max %d), %.1f%% of pixels converged\n",
+			(double)total / n, lo, hi, 100.0 * (double)converged / n);
+}
+
+#endif
@@ -0,0 +1,561 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   guide.h                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/09 13:02:26 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/09 13:02:26 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef GUIDE_H
+#define GUIDE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "vector.h"
+#include "aabb.h"
+#include "random.h"
+#include "color.h"
+
+/* Path guiding with a spatial-directional tree (SD-tree, after Mueller et al.,
+   "Practical Path Guiding"). A binary tree splits the scene's bounding cube
+   into cells; each cell holds two quadtrees over the sphere of directions
+   (cylindrical mapping u = (cos theta + 1) / 2, v = phi / 2pi, which keeps
+   areas): one learned during the previous training pass, sampled now, and
+   one being filled by this pass.
+   Every path vertex records the radiance its path brought back along the
+   direction it took, divided by the density that direction was drawn with,
+   into the building quadtree of its cell. After each training pass, cells
+   that received many records split, the filled quadtrees become the
+   sampling ones, and quadrants holding more than GUIDE_DTREE_THRESHOLD of
+   a cell's energy are subdivided for the next pass. Bounces then draw from
+   the learned distribution part of the time and from the BSDF otherwise,
+   weighted by the density of the mixture, so every direction the BSDF can
+   take keeps a non-zero density and the estimate stays unbiased. */
+
+#define GUIDE_BSDF_FRACTION 0.7		 /* share of guided bounces still sampling the BSDF */
+#define GUIDE_TRAINING_SHARE 0.25	 /* of the spp spent in training passes (1, 2, 4... spp) */
+#define GUIDE_SPATIAL_THRESHOLD 4000 /* records a cell takes before splitting, x sqrt(pass spp) */
+#define GUIDE_DTREE_THRESHOLD 0.01	 /* energy share above which a quadrant is subdivided */
+#define GUIDE_DTREE_MAX_DEPTH 20
+#define GUIDE_MAX_CELLS (1 << 16)
+#define GUIDE_MAX_VERTICES 16		 /* vertices of a path that record */
+
+/* Quadtree node: quadrant q = (u >= 1/2) + 2 (v >= 1/2) of its square */
+typedef struct s_dnode
+{
+	float sum[4]; /* energy recorded in each quadrant */
+	int child[4]; /* node subdividing the quadrant, 0 = none */
+} t_dnode;
+
+typedef struct s_dtree
+{
+	t_dnode *nodes; /* nodes[0] is the whole square */
+	int count;
+	int capacity;
+	float total; /* sampling trees: energy of the whole square */
+} t_dtree;
+
+/* Binary tree node: the two halves of its box along axis, or a cell */
+typedef struct s_snode
+{
+	int child[2]; /* 0 = this node is a cell */
+	int axis;
+	int cell;
+} t_snode;
+
+typedef struct s_guide_cell
+{
+	t_dtree sampling;
+	t_dtree building;
+	long records; /* vertices recorded this pass */
+} t_guide_cell;
+
+typedef struct s_guide
+{
+	t_aabb bounds; /* cube around the scene */
+	t_snode *nodes;
+	int node_count;
+	int node_capacity;
+	t_guide_cell *cells;
+	int cell_count;
+	int cell_capacity;
+	bool training; /* paths record their radiance */
+	int passes;	   /* training passes learned from */
+} t_guide;
+
+/* Where one bounce drew its direction from */
+typedef struct s_guide_mix
+{
+	const t_dtree *dtree; /* learned distribution, NULL = BSDF only */
+	int cell;			  /* cell of the vertex, -1 = not guided */
+	t_vec3 normal;		  /* surface normal at the vertex */
+} t_guide_mix;
+
+/* A path vertex waiting for the radiance its path brings back */
+typedef struct s_guide_vertex
+{
+	int cell;
+	t_vec3 dir;
+	real_t pdf;			/* density the direction was drawn with */
+	t_color radiance;	/* radiance of the path before this direction */
+	t_color throughput; /* weight of what arrives along it */
+} t_guide_vertex;
+
+/* ============================================================================ */
+/*                           DIRECTIONAL QUADTREE                               */
+/* ============================================================================ */
+
+static inline void guide_dir_to_square(const t_vec3 *dir, real_t *u, real_t *v)
+{
+	t_vec3 d = unit_vector(dir);
+	real_t cos_theta = (d.z < (real_t)-1.0) ? (real_t)-1.0 : ((d.z > (real_t)1.0) ? (real_t)1.0 : d.z);
+	real_t phi = (real_t)atan2((double)d.y, (double)d.x);
+	if (phi < (real_t)0.0)
+		phi += (real_t)(2.0 * PI);
+	*u = (cos_theta + (real_t)1.0) * (real_t)0.5;
+	*v = phi / (real_t)(2.0 * PI);
+	if (*u >= (real_t)1.0)
+		*u = (real_t)0.99999;
+	if (*v >= (real_t)1.0)
+		*v = (real_t)0.99999;
+}
+
+static inline t_vec3 guide_square_to_dir(real_t u, real_t v)
+{
+	real_t cos_theta = (real_t)2.0 * u - (real_t)1.0;
+	real_t sin_theta = (real_t)sqrt(fmax(0.0, 1.0 - (double)(cos_theta * cos_theta)));
+	real_t phi = (real_t)(2.0 * PI) * v;
+	return vec3_create(sin_theta * (real_t)cos((double)phi), sin_theta * (real_t)sin((double)phi), cos_theta);
+}
+
+/* Append an empty node; its index, or -1 when out of memory */
+static inline int dtree_push(t_dtree *t)
+{
+	if (t->count >= t->capacity)
+	{
+		int cap = (t->capacity == 0) ? 16 : 2 * t->capacity;
+		t_dnode *nodes = (t_dnode *)realloc(t->nodes, (size_t)cap * sizeof(t_dnode));
+		if (!nodes)
+			return -1;
+		t->nodes = nodes;
+		t->capacity = cap;
+	}
+	memset(&t->nodes[t->count], 0, sizeof(t_dnode));
+	return t->count++;
+}
+
+/* A tree of one empty node */
+static inline bool dtree_init(t_dtree *t)
+{
+	memset(t, 0, sizeof(*t));
+	return dtree_push(t) == 0;
+}
+
+static inline void dtree_destroy(t_dtree *t)
+{
+	free(t->nodes);
+	memset(t, 0, sizeof(*t));
+}
+
+static inline bool dtree_copy(t_dtree *dst, const t_dtree *src)
+{
+	*dst = *src;
+	dst->nodes = (t_dnode *)malloc((size_t)src->capacity * sizeof(t_dnode));
+	if (!dst->nodes)
+	{
+		memset(dst, 0, sizeof(*dst));
+		return false;
+	}
+	memcpy(dst->nodes, src->nodes, (size_t)src->count * sizeof(t_dnode));
+	return true;
+}
+
+/* Quadrant of (u, v) and its coordinates inside it */
+static inline int dtree_quadrant(real_t *u, real_t *v)
+{
+	int q = 0;
+	*u *= (real_t)2.0;
+	*v *= (real_t)2.0;
+	if (*u >= (real_t)1.0)
+	{
+		q |= 1;
+		*u -= (real_t)1.0;
+	}
+	if (*v >= (real_t)1.0)
+	{
+		q |= 2;
+		*v -= (real_t)1.0;
+	}
+	return q;
+}
+
+/* Add value to the smallest quadrant holding (u, v); thread safe */
+static inline void dtree_record(t_dtree *t, real_t u, real_t v, float value)
+{
+	int n = 0;
+	for (;;)
+	{
+		int q = dtree_quadrant(&u, &v);
+		int c = t->nodes[n].child[q];
+		if (c == 0)
+		{
+#pragma omp atomic
+			t->nodes[n].sum[q] += value;
+			return;
+		}
+		n = c;
+	}
+}
+
+/* Sum every subdivided quadrant up from its children; returns node n's energy */
+static inline float dtree_build_node(t_dtree *t, int n)
+{
+	float total = 0.0f;
+	for (int q = 0; q < 4; ++q)
+	{
+		if (t->nodes[n].child[q])
+			t->nodes[n].sum[q] = dtree_build_node(t, t->nodes[n].child[q]);
+		total += t->nodes[n].sum[q];
+	}
+	return total;
+}
+
+static inline void dtree_build(t_dtree *t)
+{
+	t->total = dtree_build_node(t, 0);
+}
+
+/* Density of (u, v) over the unit square */
+static inline real_t dtree_pdf(const t_dtree *t, real_t u, real_t v)
+{
+	if (!(t->total > 0.0f))
+		return (real_t)0.0;
+	real_t pdf = (real_t)1.0;
+	int n = 0;
+	for (;;)
+	{
+		const t_dnode *node = &t->nodes[n];
+		float total = node->sum[0] + node->sum[1] + node->sum[2] + node->sum[3];
+		int q = dtree_quadrant(&u, &v);
+		if (!(total > 0.0f) || !(node->sum[q] > 0.0f))
+			return (real_t)0.0;
+		pdf *= (real_t)4.0 * (real_t)(node->sum[q] / total);
+		if (node->child[q] == 0)
+			return pdf;
+		n = node->child[q];
+	}
+}
+
+/* Point of the unit square drawn proportionally to the learned energy */
+static inline void dtree_sample(const t_dtree *t, real_t *u, real_t *v)
+{
+	real_t x0 = (real_t)0.0;
+	real_t y0 = (real_t)0.0;
+	real_t size = (real_t)1.0;
+	int n = 0;
+	for (;;)
+	{
+		const t_dnode *node = &t->nodes[n];
+		float total = node->sum[0] + node->sum[1] + node->sum[2] + node->sum[3];
+		real_t pick = random_real() * (real_t)total;
+		int q = 0;
+		while (q < 3 && (pick >= (real_t)node->sum[q] || !(node->sum[q] > 0.0f)))
+		{
+			pick -= (real_t)node->sum[q];
+			++q;
+		}
+		size *= (real_t)0.5;
+		x0 += (q & 1) ? size : (real_t)0.0;
+		y0 += (q & 2) ? size : (real_t)0.0;
+		if (node->child[q] == 0)
+			break;
+		n = node->child[q];
+	}
+	*u = x0 + size * random_real();
+	*v = y0 + size * random_real();
+}
+
+/* Subdivide node dn of dst like node sn of src (-1 = below src's leaves,
+   whose energy `sum` is assumed spread evenly) wherever a quadrant holds
+   more than the threshold share of total */
+static inline bool dtree_refine_node(t_dtree *dst, int dn, const t_dtree *src, int sn, float sum,
+									 float total, int depth)
+{
+	for (int q = 0; q < 4; ++q)
+	{
+		float s = (sn >= 0) ? src->nodes[sn].sum[q] : sum * 0.25f;
+		if (depth >= GUIDE_DTREE_MAX_DEPTH || s <= total * (float)GUIDE_DTREE_THRESHOLD)
+			continue;
+		int c = dtree_push(dst);
+		if (c < 0)
+			return false;
+		dst->nodes[dn].child[q] = c;
+		int sc = (sn >= 0 && src->nodes[sn].child[q]) ? src->nodes[sn].child[q] : -1;
+		if (!dtree_refine_node(dst, c, src, sc, s, total, depth + 1))
+			return false;
+	}
+	return true;
+}
+
+/* Empty tree shaped after the energy learned in src */
+static inline bool dtree_refine(t_dtree *dst, const t_dtree *src)
+{
+	if (!dtree_init(dst))
+		return false;
+	if (!(src->total > 0.0f))
+		return true;
+	if (dtree_refine_node(dst, 0, src, 0, src->total, src->total, 1))
+		return true;
+	dtree_destroy(dst);
+	return dtree_init(dst);
+}
+
+/* ============================================================================ */
+/*                              SPATIAL TREE                                    */
+/* ============================================================================ */
+
+static inline int guide_push_cell(t_guide *g)
+{
+	if (g->cell_count >= g->cell_capacity)
+	{
+		int cap = (g->cell_capacity == 0) ? 16 : 2 * g->cell_capacity;
+		t_guide_cell *cells = (t_guide_cell *)realloc(g->cells, (size_t)cap * sizeof(t_guide_cell));
+		if (!cells)
+			return -1;
+		g->cells = cells;
+		g->cell_capacity = cap;
+	}
+	memset(&g->cells[g->cell_count], 0, sizeof(t_guide_cell));
+	return g->cell_count++;
+}
+
+static inline int guide_push_node(t_guide *g, int axis, int cell)
+{
+	if (g->node_count >= g->node_capacity)
+	{
+		int cap = (g->node_capacity == 0) ? 16 : 2 * g->node_capacity;
+		t_snode *nodes = (t_snode *)realloc(g->nodes, (size_t)cap * sizeof(t_snode));
+		if (!nodes)
+			return -1;
+		g->nodes = nodes;
+		g->node_capacity = cap;
+	}
+	g->nodes[g->node_count] = (t_snode){{0, 0}, axis, cell};
+	return g->node_count++;
+}
+
+static inline void guide_destroy(t_guide *g)
+{
+	for (int c = 0; c < g->cell_count; ++c)
+	{
+		dtree_destroy(&g->cells[c].sampling);
+		dtree_destroy(&g->cells[c].building);
+	}
+	free(g->cells);
+	free(g->nodes);
+	memset(g, 0, sizeof(*g));
+}
+
+/* One cell over the cube around scene_box, nothing learned yet */
+static inline bool guide_init(t_guide *g, const t_aabb *scene_box)
+{
+	memset(g, 0, sizeof(*g));
+	t_vec3 lo = vec3_create(scene_box->x.min, scene_box->y.min, scene_box->z.min);
+	t_vec3 hi = vec3_create(scene_box->x.max, scene_box->y.max, scene_box->z.max);
+	real_t size = fmax(hi.x - lo.x, fmax(hi.y - lo.y, hi.z - lo.z));
+	if (!(size > (real_t)0.0) || !isfinite((double)size))
+		return false;
+	size *= (real_t)1.001;
+	t_vec3 c = vec3_create((lo.x + hi.x) * (real_t)0.5, (lo.y + hi.y) * (real_t)0.5, (lo.z + hi.z) * (real_t)0.5);
+	real_t r = size * (real_t)0.5;
+	g->bounds = (t_aabb){interval(c.x - r, c.x + r), interval(c.y - r, c.y + r), interval(c.z - r, c.z + r)};
+	int cell = guide_push_cell(g);
+	bool ok = cell == 0 && guide_push_node(g, 0, 0) == 0;
+	ok = ok && dtree_init(&g->cells[0].sampling) && dtree_init(&g->cells[0].building);
+	if (!ok)
+		guide_destroy(g);
+	g->training = ok;
+	return ok;
+}
+
+/* Cell holding point p */
+static inline int guide_cell_at(const t_guide *g, const t_point3 *p)
+{
+	real_t lo[3] = {g->bounds.x.min, g->bounds.y.min, g->bounds.z.min};
+	real_t hi[3] = {g->bounds.x.max, g->bounds.y.max, g->bounds.z.max};
+	real_t x[3] = {p->x, p->y, p->z};
+	int n = 0;
+	while (g->nodes[n].child[0])
+	{
+		int a = g->nodes[n].axis;
+		real_t mid = (lo[a] + hi[a]) * (real_t)0.5;
+		if (x[a] < mid)
+		{
+			hi[a] = mid;
+			n = g->nodes[n].child[0];
+		}
+		else
+		{
+			lo[a] = mid;
+			n = g->nodes[n].child[1];
+		}
+	}
+	return g->nodes[n].cell;
+}
+
+/* How a bounce at p, normal n, is sampled: its cell, and what the cell has
+   learned */
+static inline t_guide_mix guide_mix_at(const t_guide *g, const t_point3 *p, const t_vec3 *n)
+{
+	t_guide_mix mix = {NULL, guide_cell_at(g, p), *n};
+	if (g->cells[mix.cell].sampling.total > 0.0f)
+		mix.dtree = &g->cells[mix.cell].sampling;
+	return mix;
+}
+
+/* Solid-angle density of dir under the learned distribution */
+static inline real_t guide_pdf(const t_dtree *t, const t_vec3 *dir)
+{
+	real_t u;
+	real_t v;
+	guide_dir_to_square(dir, &u, &v);
+	return dtree_pdf(t, u, v) / (real_t)(4.0 * PI);
+}
+
+/* Direction drawn from the learned distribution. A cell spans surfaces of
+   several orientations, so directions below this one are mirrored above it
+   rather than wasted. */
+static inline t_vec3 guide_sample(const t_guide_mix *mix)
+{
+	real_t u;
+	real_t v;
+	dtree_sample(mix->dtree, &u, &v);
+	t_vec3 dir = guide_square_to_dir(u, v);
+	if (dot(&dir, &mix->normal) < (real_t)0.0)
+		dir = vec3_reflect(&dir, &mix->normal);
+	return dir;
+}
+
+/* Density of guide_sample drawing dir: both dir and its mirror image */
+static inline real_t guide_sample_pdf(const t_guide_mix *mix, const t_vec3 *dir)
+{
+	real_t cos_theta = dot(dir, &mix->normal);
+	if (cos_theta <= (real_t)0.0)
+		return (real_t)0.0;
+	t_vec3 mirrored = vec3_reflect(dir, &mix->normal);
+	return guide_pdf(mix->dtree, dir) + guide_pdf(mix->dtree, &mirrored);
+}
+
+/* Density of dir under the bounce's sampling strategy (bsdf_pdf alone when
+   nothing was learned, or without a guide) */
+static inline real_t guide_mix_pdf(const t_guide_mix *mix, real_t bsdf_pdf, const t_vec3 *dir)
+{
+	if (!mix || !mix->dtree)
+		return bsdf_pdf;
+	return (real_t)GUIDE_BSDF_FRACTION * bsdf_pdf
+		   + (real_t)(1.0 - GUIDE_BSDF_FRACTION) * guide_sample_pdf(mix, dir);
+}
+
+/* Record radiance arriving at a vertex of cell along dir, over the density
+   dir was drawn with; thread safe */
+static inline void guide_record(t_guide *g, int cell, const t_vec3 *dir, double value)
+{
+#pragma omp atomic
+	g->cells[cell].records += 1;
+	if (!(value > 0.0) || !isfinite(value))
+		return;
+	real_t u;
+	real_t v;
+	guide_dir_to_square(dir, &u, &v);
+	dtree_record(&g->cells[cell].building, u, v, (float)value);
+}
+
+/* Record what a finished path brought back to each of its vertices: the
+   radiance gathered after the vertex, over the throughput up to it */
+static inline void guide_record_path(t_guide *g, const t_guide_vertex *verts, int count, const t_color *radiance)
+{
+	for (int k = 0; k < count; ++k)
+	{
+		const t_guide_vertex *vk = &verts[k];
+		t_color li = vec3_sub(radiance, &vk->radiance);
+		li.x = (vk->throughput.x > (real_t)0.0) ? li.x / vk->throughput.x : (real_t)0.0;
+		li.y = (vk->throughput.y > (real_t)0.0) ? li.y / vk->throughput.y : (real_t)0.0;
+		li.z = (vk->throughput.z > (real_t)0.0) ? li.z / vk->throughput.z : (real_t)0.0;
+		guide_record(g, vk->cell, &vk->dir, (double)color_luminance(&li) / (double)vk->pdf);
+	}
+}
+
+/* Split cell node n in two along its axis, both halves starting from what
+   the cell has learned; false when out of memory or cells */
+static inline bool guide_split(t_guide *g, int n)
+{
+	if (g->cell_count >= GUIDE_MAX_CELLS)
+		return false;
+	int old = g->nodes[n].cell;
+	int cell = guide_push_cell(g);
+	if (cell < 0)
+		return false;
+	if (!dtree_copy(&g->cells[cell].building, &g->cells[old].building))
+	{
+		--g->cell_count;
+		return false;
+	}
+	g->cells[cell].records = g->cells[old].records / 2;
+	g->cells[old].records -= g->cells[cell].records;
+	int axis = (g->nodes[n].axis + 1) % 3;
+	int c0 = guide_push_node(g, axis, old);
+	int c1 = (c0 < 0) ? -1 : guide_push_node(g, axis, cell);
+	if (c1 < 0)
+	{
+		dtree_destroy(&g->cells[cell].building);
+		--g->cell_count;
+		if (c0 >= 0)
+			--g->node_count;
+		return false;
+	}
+	g->nodes[n].child[0] = c0;
+	g->nodes[n].child[1] = c1;
+	return true;
+}
+
+/* End of a training pass of pass_spp samples per pixel: split busy cells,
+   sample what was learned from now on and reshape the quadtrees to fill */
+static inline void guide_update(t_guide *g, int pass_spp)
+{
+	for (int c = 0; c < g->cell_count; ++c)
+		dtree_build(&g->cells[c].building);
+	long threshold = (long)(GUIDE_SPATIAL_THRESHOLD * sqrt((double)pass_spp));
+	for (int n = 0; n < g->node_count; ++n)
+		if (!g->nodes[n].child[0] && g->cells[g->nodes[n].cell].records > threshold)
+			guide_split(g, n);
+	for (int c = 0; c < g->cell_count; ++c)
+	{
+		t_guide_cell *cell = &g->cells[c];
+		t_dtree next;
+		if (!dtree_refine(&next, &cell->building))
+			continue; /* out of memory: keep filling the same tree */
+		dtree_destroy(&cell->sampling);
+		cell->sampling = cell->building;
+		cell->building = next;
+		cell->records = 0;
+	}
+	++g->passes;
+}
+
+/* Directional nodes over every cell */
+static inline long guide_dtree_nodes(const t_guide *g)
+{
+	long n = 0;
+	for (int c = 0; c < g->cell_count; ++c)
+		n += g->cells[c].sampling.count;
+	return n;
+}
+
+#endif
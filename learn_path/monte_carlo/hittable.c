@@ -0,0 +1,7 @@
+/* ============================================================================ */
+/*                                 OBJECT IDS                                   */
+/* ============================================================================ */
+
+#include "common.h"
+
+uint32_t g_object_count = 0;
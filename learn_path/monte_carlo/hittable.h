@@ -17,7 +17,10 @@
 #include "vector.h"
 #include "ray.h"
 #include "aabb.h"
+#include "stats.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Forward declaration of material to avoid circular dependency */
 typedef struct s_material t_material;
@@ -35,9 +38,29 @@ typedef struct s_hittable_wrapper
 	bool owned;
 	t_set_current_fn set_current;
 	t_hit_noobj_fn hit_noobj;
-	t_aabb bbox;
+	t_aabb bbox;	 /* bounds over the whole shutter interval */
+	bool moving;	 /* when set, box0/box1 bound the object at shutter open/close */
+	t_aabb box0;
+	t_aabb box1;
+	uint32_t id; /* creation order from 1, given by hittable_list_add_wrapper (0 = none) */
 } t_hittable_wrapper;
 
+/* Objects added to lists so far, shared by every translation unit (hittable.c) */
+extern uint32_t g_object_count;
+
+static inline uint32_t hittable_next_id(void)
+{
+	return ++g_object_count;
+}
+
+/* Bounds of a wrapped object at normalized shutter time t (0..1) */
+static inline t_aabb hittable_wrapper_box_at(const t_hittable_wrapper *w, real_t t)
+{
+	if (!w->moving)
+		return w->bbox;
+	return aabb_lerp(&w->box0, &w->box1, t);
+}
+
 /* Hit record: store intersection point, normal, material and t. */
 struct s_hit_record
 {
@@ -50,6 +73,7 @@ struct s_hit_record
 	real_t u;
 	real_t v;
 	t_material *mat; /* pointer to material that determines scattering behavior */
+	uint32_t object_id; /* id of the innermost wrapper hit that has one (AOVs) */
 };
 
 /* set_face_normal: outward_normal is assumed unit length. */
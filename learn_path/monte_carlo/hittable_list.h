@@ -66,7 +66,10 @@ static inline bool hittable_list_add_wrapper(t_hittable_list *list, const t_hitt
 		list->objects = newarr;
 		list->capacity = newcap;
 	}
-	list->objects[list->count++] = *wrap;
+	list->objects[list->count] = *wrap;
+	if (!wrap->id)
+		list->objects[list->count].id = hittable_next_id();
+	list->count++;
 
 	/* Merge the new object's bounding box into the list's bounding box */
 	list->bbox = aabb_merge(&list->bbox, &wrap->bbox);
@@ -87,6 +90,14 @@ static inline bool hittable_list_add_sphere(t_hittable_list *list, const t_spher
 		.set_current = set_current_sphere,
 		.hit_noobj = sphere_hit_noobj,
 		.bbox = s->bbox};
+	/* Moving spheres keep their start/end boxes so the BVH can interpolate them */
+	if (s->center.center_velocity.x != 0 || s->center.center_velocity.y != 0
+		|| s->center.center_velocity.z != 0)
+	{
+		wrap.moving = true;
+		wrap.box0 = sphere_box_at(s, 0);
+		wrap.box1 = sphere_box_at(s, 1);
+	}
 	return hittable_list_add_wrapper(list, &wrap);
 }
 
@@ -124,8 +135,14 @@ static inline bool hittable_list_hit(const t_hittable_list *list, const t_ray *r
 			continue;
 		w->set_current(w->object);
 		/* pass a t_interval [rayt.min, closest_so_far] to the per-object callback */
-		if (w->hit_noobj(r, interval(rayt.min, (real_t)closest_so_far), &temp_rec))
+		temp_rec.object_id = 0;
+		RT_STAT_OBJECT_BEGIN(cost);
+		bool hit = w->hit_noobj(r, interval(rayt.min, (real_t)closest_so_far), &temp_rec);
+		RT_STAT_OBJECT_END(cost, w->id);
+		if (hit)
 		{
+			if (!temp_rec.object_id)
+				temp_rec.object_id = w->id;
 			hit_anything = true;
 			closest_so_far = (real_t)temp_rec.t;
 			if (rec)
@@ -135,6 +152,26 @@ static inline bool hittable_list_hit(const t_hittable_list *list, const t_ray *r
 	return hit_anything;
 }
 
+/* Occlusion query for shadow rays: true as soon as any object is hit inside
+   rayt (the closest hit is not needed, so the list stops at the first one) */
+static inline bool hittable_list_occluded(const t_hittable_list *list, const t_ray *r, t_interval rayt)
+{
+	t_hit_record temp_rec;
+	for (size_t i = 0; i < list->count; ++i)
+	{
+		const t_hittable_wrapper *w = &list->objects[i];
+		if (!w->set_current || !w->hit_noobj)
+			continue;
+		w->set_current(w->object);
+		RT_STAT_OBJECT_BEGIN(cost);
+		bool hit = w->hit_noobj(r, rayt, &temp_rec);
+		RT_STAT_OBJECT_END(cost, w->id);
+		if (hit)
+			return true;
+	}
+	return false;
+}
+
 static __thread const t_hittable_list *g_current_list = NULL;
 static inline void set_current_hlist(const void *obj) { g_current_list = (const t_hittable_list *)obj; }
 static inline bool hittable_list_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
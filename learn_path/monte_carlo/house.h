@@ -36,8 +36,11 @@ void build_large_window(t_hittable_list *world, const t_point3 *center,
 void build_moon_outside(t_hittable_list *world, const t_point3 *window_center,
 						t_material *moon_mat);
 
+/* Emitter builders also register their lights in `lights` for direct
+   sampling when it is not NULL (light_list_build it once the scene is up) */
+
 void build_stars(t_hittable_list *world, const t_point3 *window_center,
-				 real_t width, real_t height, t_material *star_mat);
+				 real_t width, real_t height, t_material *star_mat, t_light_list *lights);
 
 void build_moonlight(t_hittable_list *world, const t_point3 *window_center,
 					 real_t width, real_t height, t_material *light_mat);
@@ -74,12 +77,15 @@ void build_sofa(t_hittable_list *world, const t_point3 *pos,
 void build_plant_pot(t_hittable_list *world, const t_point3 *pos, t_material *pot_mat);
 
 void build_menhir_lamp(t_hittable_list *world, const t_point3 *pos,
-					   real_t base_radius, real_t height, int num_lights);
+					   real_t base_radius, real_t height, int num_lights, t_light_list *lights);
 
 void build_rug(t_hittable_list *world, const t_point3 *center,
 			   real_t width, real_t depth, t_material *mat);
 
 void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
-					   real_t width, real_t height, int num_leds);
+					   real_t width, real_t height, int num_leds, t_light_list *lights);
+
+/* Pack cylinders into 4-wide leaves and build the BVH; returns the list to render */
+const t_hittable_list *build_house_accel(t_hittable_list *world, t_hittable_list *accel);
 
 #endif
\ No newline at end of file
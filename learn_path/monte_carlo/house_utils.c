@@ -226,7 +226,7 @@ void build_moon_outside(t_hittable_list *world, const t_point3 *window_center,
 }
 
 void build_stars(t_hittable_list *world, const t_point3 *window_center,
-				 real_t width, real_t height, t_material *star_mat)
+				 real_t width, real_t height, t_material *star_mat, t_light_list *lights)
 {
 	real_t star_distance = 800.0;
 	for (int i = 0; i < 40; ++i)
@@ -240,6 +240,8 @@ void build_stars(t_hittable_list *world, const t_point3 *window_center,
 			window_center->z + offset_z);
 		t_sphere star = create_sphere(&star_pos, star_size, vec3_create(1.0, 1.0, 1.0), star_mat);
 		hittable_list_add_sphere(world, &star);
+		if (lights)
+			light_list_add_sphere(lights, &star);
 	}
 }
 
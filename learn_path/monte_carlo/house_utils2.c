@@ -310,7 +310,7 @@ void build_plant_pot(t_hittable_list *world, const t_point3 *pos, t_material *po
 }
 
 void build_menhir_lamp(t_hittable_list *world, const t_point3 *pos,
-					   real_t base_radius, real_t height, int num_lights)
+					   real_t base_radius, real_t height, int num_lights, t_light_list *lights)
 {
 	t_material *marble_body = dielectric_create(1.45);
 	t_material *marble_solid = lambertian_create(vec3_create(0.92, 0.90, 0.88));
@@ -354,6 +354,8 @@ void build_menhir_lamp(t_hittable_list *world, const t_point3 *pos,
 		t_point3 light_center = point3_create(pos->x, pos->y + y_offset + section_height * 0.35, pos->z);
 		t_sphere light_sphere = create_sphere(&light_center, section_r * 0.6, vec3_create(1.0, 1.0, 1.0), light_mat);
 		hittable_list_add_sphere(world, &light_sphere);
+		if (lights)
+			light_list_add_sphere(lights, &light_sphere);
 
 		if (i < num_lights - 1)
 		{
@@ -372,7 +374,7 @@ void build_menhir_lamp(t_hittable_list *world, const t_point3 *pos,
 
 /* Build LED lights around mirror frame */
 void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
-					   real_t width, real_t height, int num_leds)
+					   real_t width, real_t height, int num_leds, t_light_list *lights)
 {
 	/* LED colors - vibrant neon colors */
 	t_vec3 led_colors[6] = {
@@ -411,6 +413,8 @@ void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
 		t_material *led_mat = diffuse_light_create(emit);
 		t_sphere led = create_sphere(&led_pos, led_radius, vec3_create(1.0, 1.0, 1.0), led_mat);
 		hittable_list_add_sphere(world, &led);
+		if (lights)
+			light_list_add_sphere(lights, &led);
 		color_idx++;
 	}
 
@@ -428,6 +432,8 @@ void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
 		t_material *led_mat = diffuse_light_create(emit);
 		t_sphere led = create_sphere(&led_pos, led_radius, vec3_create(1.0, 1.0, 1.0), led_mat);
 		hittable_list_add_sphere(world, &led);
+		if (lights)
+			light_list_add_sphere(lights, &led);
 		color_idx++;
 	}
 
@@ -448,6 +454,8 @@ void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
 		t_material *led_mat = diffuse_light_create(emit);
 		t_sphere led = create_sphere(&led_pos, led_radius, vec3_create(1.0, 1.0, 1.0), led_mat);
 		hittable_list_add_sphere(world, &led);
+		if (lights)
+			light_list_add_sphere(lights, &led);
 		color_idx++;
 	}
 
@@ -465,6 +473,8 @@ void build_mirror_leds(t_hittable_list *world, const t_point3 *mirror_corner,
 		t_material *led_mat = diffuse_light_create(emit);
 		t_sphere led = create_sphere(&led_pos, led_radius, vec3_create(1.0, 1.0, 1.0), led_mat);
 		hittable_list_add_sphere(world, &led);
+		if (lights)
+			light_list_add_sphere(lights, &led);
 		color_idx++;
 	}
 }
@@ -482,4 +492,24 @@ void build_rug(t_hittable_list *world, const t_point3 *center,
 		*rug_copy = rug_q;
 		hittable_list_add_nonowned(world, rug_copy, set_current_quad, quad_hit_noobj, &rug_q.bbox);
 	}
-}
\ No newline at end of file
+}
+
+/* Group the house's cylinders into 4-wide leaves, then put the whole list
+   under one BVH in `accel`. Returns the list to render: `accel`, or the
+   flat world when the BVH cannot be built. */
+const t_hittable_list *build_house_accel(t_hittable_list *world, t_hittable_list *accel)
+{
+	hittable_list_init(accel);
+	cylinder_pack_list(world);
+	t_bvh_node *world_bvh = bvh_node_create(world);
+	if (!world_bvh)
+		return world;
+	t_hittable_wrapper bvh_wrap = {
+		.object = world_bvh,
+		.owned = true,
+		.set_current = set_current_bvh,
+		.hit_noobj = bvh_node_hit,
+		.bbox = world_bvh->bbox};
+	hittable_list_add_wrapper(accel, &bvh_wrap);
+	return accel;
+}
@@ -0,0 +1,513 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   image_writer.h                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/08 14:20:51 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/09 10:12:47 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#ifndef LODEPNG_COMPILE_DISK
+#define LODEPNG_COMPILE_DISK
+#endif
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "types.h"
+#include "vector.h"
+#include "color.h"
+#include "tile.h"
+#include "framebuffer.h"
+#include "lode_image.h"
+#include "exr.h"
+
+/* Output stage of a render. Tiles are encoded into the output's pixel
+   format (8-bit sRGB, or linear float / half float for HDR) by whichever
+   thread finished them, as soon as they finish, from the whole-image
+   accumulator or from a bucket holding just that tile.
+   PPM and PFM files have a fixed layout: the file is sized up front and
+   mapped, and pixels are stored straight into it, so the image never has
+   to fit in memory. EXR tiles (64x64) are buffered only until every render
+   tile across them is in, then compressed by the thread that completed
+   them and appended to the file in any order. A PNG is encoded from a
+   whole-frame buffer once the render is done (the in-tree encoder
+   compresses a whole image at a time).
+   The file is written as <path>.part and renamed over <path> at the end,
+   so viewers never see half an image. HDR formats hold the unclamped linear
+   radiance; they are written for the window alone (EXR records where it
+   sits in the image), never over a backdrop. */
+
+#define IMAGE_WRITE_BAND 16 /* rows per job of image_write (8-bit and PFM) */
+
+typedef enum e_image_format
+{
+	IMAGE_FORMAT_PPM, /* 8-bit sRGB (gamma 2) */
+	IMAGE_FORMAT_PNG, /* 8-bit sRGB (gamma 2) */
+	IMAGE_FORMAT_PFM, /* 32-bit float linear */
+	IMAGE_FORMAT_EXR  /* 16-bit half float linear, tiled */
+} t_image_format;
+
+typedef struct s_image_writer
+{
+	t_image_format format;
+	bool compress;		  /* EXR: ZIP-compress tiles (lossless) */
+	int width;			  /* of the image */
+	int height;
+	const t_vec3 *pixels; /* width * height colours written instead of the accumulator's (NULL = none) */
+	int samples;		  /* spp of accumulators without per-pixel counts */
+	t_tile window;		  /* pixels rendered */
+	t_tile frame;		  /* pixels written: the window, or the whole image over a backdrop */
+	size_t pixel_bytes;	  /* of one encoded pixel */
+	unsigned char *data;  /* PPM, PFM, PNG: the frame's pixels in file order */
+	unsigned char *map;	  /* PPM, PFM: the mapped file (NULL = data is malloc'd, written at close) */
+	size_t map_size;
+	char header[64];	  /* PPM, PFM */
+	size_t header_size;
+	unsigned char **tiles; /* EXR: pixels of each tile being filled (NULL = not started, or written) */
+	int *tile_pending;	  /* EXR: pixels of each tile not encoded yet */
+	int tiles_x;		  /* EXR */
+	int tiles_y;
+	int tiles_written;
+	uint64_t *offsets;	  /* EXR: file offset of each tile */
+	long table_pos;		  /* EXR: where the offset table goes */
+	bool failed;		  /* a tile could not be buffered, encoded or written */
+	FILE *file;			  /* EXR */
+	char path[512];
+	char part_path[520];
+} t_image_writer;
+
+/* True if path ends with ext (given in lower case), in any case */
+static inline bool image_path_has_ext(const char *path, const char *ext)
+{
+	size_t n = strlen(path);
+	size_t e = strlen(ext);
+	if (n < e)
+		return false;
+	for (size_t k = 0; k < e; ++k)
+		if (tolower((unsigned char)path[n - e + k]) != ext[k])
+			return false;
+	return true;
+}
+
+/* By extension: .png, .pfm, .exr, PPM otherwise */
+static inline t_image_format image_format_from_path(const char *path)
+{
+	if (image_path_has_ext(path, ".png"))
+		return IMAGE_FORMAT_PNG;
+	if (image_path_has_ext(path, ".pfm"))
+		return IMAGE_FORMAT_PFM;
+	if (image_path_has_ext(path, ".exr"))
+		return IMAGE_FORMAT_EXR;
+	return IMAGE_FORMAT_PPM;
+}
+
+static inline bool image_format_is_hdr(t_image_format format)
+{
+	return format == IMAGE_FORMAT_PFM || format == IMAGE_FORMAT_EXR;
+}
+
+/* Create the directory path lives in if it is missing (one level) */
+static inline void image_make_parent_dir(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	if (!slash || slash == path)
+		return;
+	char dir[512];
+	snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+	struct stat st;
+	if (stat(dir, &st) == -1)
+		mkdir(dir, 0755);
+}
+
+/* 8-bit RGB (P6 PPM, maxval 255, or PNG) of exactly width x height in a
+   malloc'd buffer; NULL if it is missing or does not match */
+static inline unsigned char *image_read_rgb(const char *path, int width, int height)
+{
+	size_t n = (size_t)width * (size_t)height * 3;
+	if (image_format_from_path(path) == IMAGE_FORMAT_PNG)
+	{
+		unsigned char *data = NULL;
+		unsigned w = 0;
+		unsigned h = 0;
+		unsigned char *rgb = NULL;
+		if (lodepng_decode24_file(&data, &w, &h, path) == 0 && (int)w == width && (int)h == height)
+			rgb = (unsigned char *)malloc(n);
+		if (rgb)
+			memcpy(rgb, data, n);
+		lodepng_free(data);
+		return rgb;
+	}
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	int w = 0;
+	int h = 0;
+	int maxval = 0;
+	unsigned char *rgb = NULL;
+	if (fscanf(f, "P6 %d %d %d", &w, &h, &maxval) == 3 && w == width && h == height
+		&& maxval == 255 && fgetc(f) != EOF)
+		rgb = (unsigned char *)malloc(n);
+	if (rgb && fread(rgb, 1, n, f) != n)
+	{
+		free(rgb);
+		rgb = NULL;
+	}
+	fclose(f);
+	return rgb;
+}
+
+/* Gamma-encode and quantize one colour into dst[0..2] */
+static inline unsigned char *write_color_to_buf_bin(unsigned char *dst, const t_vec3 *pixel)
+{
+	real_t r = linear_to_gamma(pixel->x);
+	real_t g = linear_to_gamma(pixel->y);
+	real_t b = linear_to_gamma(pixel->z);
+
+	static const t_interval intensity = {0.000, 0.999, true};
+	*dst++ = (unsigned char)component_to_byte(r, &intensity);
+	*dst++ = (unsigned char)component_to_byte(g, &intensity);
+	*dst++ = (unsigned char)component_to_byte(b, &intensity);
+	return dst;
+}
+
+/* Current colour of pixel (i, j), from acc unless the writer has pixels */
+static inline t_vec3 image_writer_color(const t_image_writer *w, const t_accum *acc, int i, int j)
+{
+	if (w->pixels)
+		return w->pixels[(size_t)j * (size_t)w->width + (size_t)i];
+	if (acc->count)
+		return accum_pixel(acc, i, j);
+	if (w->samples <= 0)
+		return vec3_zero();
+	return vec3_div_scalar(&acc->sum[accum_index(acc, i, j)], (real_t)w->samples);
+}
+
+/* Encode one colour in the writer's pixel format */
+static inline void image_writer_encode(const t_image_writer *w, unsigned char *dst, const t_vec3 *c)
+{
+	if (w->format == IMAGE_FORMAT_PFM)
+	{
+		float rgb[3] = {(float)c->x, (float)c->y, (float)c->z};
+		memcpy(dst, rgb, sizeof(rgb));
+	}
+	else if (w->format == IMAGE_FORMAT_EXR)
+	{
+		uint16_t rgb[3] = {half_from_float((float)c->x), half_from_float((float)c->y),
+						   half_from_float((float)c->z)};
+		memcpy(dst, rgb, sizeof(rgb));
+	}
+	else
+		write_color_to_buf_bin(dst, c);
+}
+
+/* Pixels of EXR tile b, in image coordinates */
+static inline t_tile image_writer_exr_tile(const t_image_writer *w, int b)
+{
+	t_tile t = {w->frame.x0 + (b % w->tiles_x) * EXR_TILE_SIZE, w->frame.y0 + (b / w->tiles_x) * EXR_TILE_SIZE, 0, 0};
+	t.x1 = (t.x0 + EXR_TILE_SIZE < w->frame.x1) ? t.x0 + EXR_TILE_SIZE : w->frame.x1;
+	t.y1 = (t.y0 + EXR_TILE_SIZE < w->frame.y1) ? t.y0 + EXR_TILE_SIZE : w->frame.y1;
+	return t;
+}
+
+/* PPM, PFM, PNG: where image row j starts in data (PFM stores the bottom row first) */
+static inline unsigned char *image_writer_row(const t_image_writer *w, int j)
+{
+	int row = (w->format == IMAGE_FORMAT_PFM) ? w->frame.y1 - 1 - j : j - w->frame.y0;
+	return w->data + (size_t)row * (size_t)(w->frame.x1 - w->frame.x0) * w->pixel_bytes;
+}
+
+/* EXR: encode a completed tile, append it to the file and drop its pixels */
+static inline void image_writer_write_tile(t_image_writer *w, int b)
+{
+	t_tile t = image_writer_exr_tile(w, b);
+	unsigned char *pixels = w->tiles[b];
+	size_t size = 0;
+	unsigned char *chunk = NULL;
+	if (pixels)
+		chunk = exr_encode_tile((const uint16_t *)pixels, (size_t)(t.x1 - t.x0), t.x1 - t.x0, t.y1 - t.y0,
+								b % w->tiles_x, b / w->tiles_x, w->compress, &size);
+#pragma omp critical(image_writer)
+	{
+		long pos = ftell(w->file);
+		if (!chunk || pos < 0 || fwrite(chunk, 1, size, w->file) != size)
+			w->failed = true;
+		w->offsets[b] = (uint64_t)pos;
+		w->tiles[b] = NULL;
+		++w->tiles_written;
+	}
+	free(chunk);
+	free(pixels);
+}
+
+/* PPM, PFM: create the .part file at its final size (header, then the
+   backdrop or zeros, which also reserves the disk space) and map it.
+   False if mapping is not possible; data is then malloc'd instead. */
+static inline bool image_writer_map(t_image_writer *w, const unsigned char *backdrop, size_t raster)
+{
+	int fd = open(w->part_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	bool ok = write(fd, w->header, w->header_size) == (ssize_t)w->header_size;
+	static const unsigned char zeros[1 << 16];
+	for (size_t done = 0; ok && done < raster;)
+	{
+		size_t n = raster - done;
+		const unsigned char *src = backdrop ? backdrop + done : zeros;
+		if (!backdrop && n > sizeof(zeros))
+			n = sizeof(zeros);
+		ssize_t put = write(fd, src, n);
+		ok = put > 0;
+		done += ok ? (size_t)put : 0;
+	}
+	w->map_size = w->header_size + raster;
+	void *map = ok ? mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		remove(w->part_path);
+		return false;
+	}
+	w->map = (unsigned char *)map;
+	w->data = w->map + w->header_size;
+	return true;
+}
+
+static inline void image_writer_free(t_image_writer *w)
+{
+	if (w->map)
+		munmap(w->map, w->map_size);
+	else
+		free(w->data);
+	if (w->tiles)
+		for (int b = 0; b < w->tiles_x * w->tiles_y; ++b)
+			free(w->tiles[b]);
+	free(w->tiles);
+	free(w->tile_pending);
+	free(w->offsets);
+	w->map = NULL;
+	w->data = NULL;
+	w->tiles = NULL;
+	w->tile_pending = NULL;
+	w->offsets = NULL;
+}
+
+/* Start writing the window of a width x height image to path, alone or
+   over backdrop (8-bit RGB of the whole image; ignored by HDR formats).
+   compress: ZIP-compress EXR tiles. Set pixels and samples before the
+   first tile goes in. */
+static inline bool image_writer_open(t_image_writer *w, int width, int height, const t_tile *window,
+									 const unsigned char *backdrop, bool compress, const char *path)
+{
+	memset(w, 0, sizeof(*w));
+	t_tile image = {0, 0, width, height};
+	w->format = image_format_from_path(path);
+	w->compress = compress;
+	w->width = width;
+	w->height = height;
+	w->window = window ? *window : image;
+	if (image_format_is_hdr(w->format))
+		backdrop = NULL;
+	w->frame = backdrop ? image : w->window;
+	snprintf(w->path, sizeof(w->path), "%s", path);
+	snprintf(w->part_path, sizeof(w->part_path), "%s.part", path);
+	int frame_w = w->frame.x1 - w->frame.x0;
+	int frame_h = w->frame.y1 - w->frame.y0;
+	size_t frame_px = (size_t)frame_w * (size_t)frame_h;
+	w->pixel_bytes = (w->format == IMAGE_FORMAT_PFM)   ? 3 * sizeof(float)
+					 : (w->format == IMAGE_FORMAT_EXR) ? 3 * sizeof(uint16_t)
+													   : 3;
+	image_make_parent_dir(path);
+	bool ok = true;
+	if (w->format == IMAGE_FORMAT_EXR)
+	{
+		exr_tile_grid(&w->frame, EXR_TILE_SIZE, &w->tiles_x, &w->tiles_y);
+		int count = w->tiles_x * w->tiles_y;
+		w->tiles = (unsigned char **)calloc((size_t)count, sizeof(unsigned char *));
+		w->tile_pending = (int *)calloc((size_t)count, sizeof(int));
+		w->offsets = (uint64_t *)calloc((size_t)count, sizeof(uint64_t));
+		ok = w->tiles && w->tile_pending && w->offsets;
+		for (int b = 0; ok && b < count; ++b)
+		{
+			t_tile t = image_writer_exr_tile(w, b);
+			w->tile_pending[b] = tile_area(&t);
+		}
+		w->file = ok ? fopen(w->part_path, "wb") : NULL;
+		if (w->file)
+			setvbuf(w->file, NULL, _IOFBF, 1 << 20);
+		ok = w->file && exr_write_header(w->file, &w->frame, width, height, compress, &w->table_pos);
+	}
+	else
+	{
+		if (w->format == IMAGE_FORMAT_PPM)
+			w->header_size = (size_t)snprintf(w->header, sizeof(w->header), "P6\n%d %d\n255\n", frame_w, frame_h);
+		else if (w->format == IMAGE_FORMAT_PFM)
+		{
+			const uint16_t probe = 1;
+			bool little = *(const unsigned char *)&probe == 1;
+			w->header_size = (size_t)snprintf(w->header, sizeof(w->header), "PF\n%d %d\n%s\n", frame_w, frame_h,
+											  little ? "-1.0" : "1.0");
+		}
+		if (w->format == IMAGE_FORMAT_PNG || !image_writer_map(w, backdrop, frame_px * w->pixel_bytes))
+		{
+			w->data = (unsigned char *)calloc(frame_px, w->pixel_bytes);
+			ok = w->data != NULL;
+			if (ok && backdrop)
+				memcpy(w->data, backdrop, frame_px * 3);
+		}
+	}
+	if (!ok)
+	{
+		fprintf(stderr, "Error: cannot open file %s for writing\n", w->part_path);
+		if (w->file)
+			fclose(w->file);
+		remove(w->part_path);
+		image_writer_free(w);
+		return false;
+	}
+	return true;
+}
+
+/* Encode a finished tile of the window from acc (the image's accumulator,
+   or a bucket holding the tile); safe to call from several threads at once
+   for disjoint tiles */
+static inline void image_writer_put_tile(t_image_writer *w, const t_accum *acc, const t_tile *tile)
+{
+	if (w->format != IMAGE_FORMAT_EXR)
+	{
+		for (int j = tile->y0; j < tile->y1; ++j)
+		{
+			unsigned char *dst = image_writer_row(w, j) + (size_t)(tile->x0 - w->frame.x0) * w->pixel_bytes;
+			for (int i = tile->x0; i < tile->x1; ++i)
+			{
+				t_vec3 c = image_writer_color(w, acc, i, j);
+				image_writer_encode(w, dst, &c);
+				dst += w->pixel_bytes;
+			}
+		}
+		return;
+	}
+
+	/* EXR tiles the tile overlaps: fill in their part, write the ones it completes */
+	int bx0 = (tile->x0 - w->frame.x0) / EXR_TILE_SIZE;
+	int bx1 = (tile->x1 - 1 - w->frame.x0) / EXR_TILE_SIZE;
+	int by0 = (tile->y0 - w->frame.y0) / EXR_TILE_SIZE;
+	int by1 = (tile->y1 - 1 - w->frame.y0) / EXR_TILE_SIZE;
+	for (int by = by0; by <= by1; ++by)
+		for (int bx = bx0; bx <= bx1; ++bx)
+		{
+			int b = by * w->tiles_x + bx;
+			t_tile block = image_writer_exr_tile(w, b);
+			t_tile part = block;
+			if (tile_list_clip(&part, 1, tile) == 0)
+				continue;
+			unsigned char *pixels;
+#pragma omp critical(image_writer_tiles)
+			{
+				if (!w->tiles[b])
+					w->tiles[b] = (unsigned char *)malloc((size_t)tile_area(&block) * w->pixel_bytes);
+				pixels = w->tiles[b];
+			}
+			for (int j = part.y0; pixels && j < part.y1; ++j)
+			{
+				unsigned char *dst = pixels + ((size_t)(j - block.y0) * (size_t)(block.x1 - block.x0)
+											   + (size_t)(part.x0 - block.x0)) * w->pixel_bytes;
+				for (int i = part.x0; i < part.x1; ++i)
+				{
+					t_vec3 c = image_writer_color(w, acc, i, j);
+					image_writer_encode(w, dst, &c);
+					dst += w->pixel_bytes;
+				}
+			}
+			int left;
+#pragma omp atomic capture
+			left = w->tile_pending[b] -= tile_area(&part);
+			if (left == 0)
+				image_writer_write_tile(w, b);
+		}
+}
+
+/* Finish the file (encode it, for PNG) and move it to its path; with
+   keep = false the partial file is dropped instead */
+static inline bool image_writer_close(t_image_writer *w, bool keep)
+{
+	bool ok = keep && !w->failed;
+	if (w->format == IMAGE_FORMAT_EXR)
+	{
+		int count = w->tiles_x * w->tiles_y;
+		ok = ok && w->tiles_written == count && exr_write_offsets(w->file, w->table_pos, w->offsets, count);
+		ok = (fclose(w->file) == 0) && ok;
+	}
+	else if (w->map)
+	{
+		ok = (munmap(w->map, w->map_size) == 0) && ok;
+		w->map = NULL;
+		w->data = NULL;
+	}
+	else if (ok && w->format == IMAGE_FORMAT_PNG)
+	{
+		unsigned err = lodepng_encode24_file(w->part_path, w->data, (unsigned)(w->frame.x1 - w->frame.x0),
+											 (unsigned)(w->frame.y1 - w->frame.y0));
+		if (err)
+			fprintf(stderr, "Error: cannot encode %s: %s\n", w->path, lodepng_error_text(err));
+		ok = (err == 0);
+	}
+	else if (ok)
+	{
+		/* PPM or PFM that could not be mapped */
+		size_t raster = (size_t)(w->frame.x1 - w->frame.x0) * (size_t)(w->frame.y1 - w->frame.y0) * w->pixel_bytes;
+		FILE *f = fopen(w->part_path, "wb");
+		ok = f && fwrite(w->header, 1, w->header_size, f) == w->header_size
+			 && fwrite(w->data, 1, raster, f) == raster;
+		ok = (f && fclose(f) == 0) && ok;
+	}
+	if (ok && rename(w->part_path, w->path) != 0)
+	{
+		fprintf(stderr, "Error: cannot write %s\n", w->path);
+		ok = false;
+	}
+	if (!ok)
+		remove(w->part_path);
+	image_writer_free(w);
+	w->file = NULL;
+	return ok;
+}
+
+/* Write the window of acc (or `pixels`, width * height colours) to path in
+   one go, bands of rows encoded in parallel */
+static inline bool image_write(const t_accum *acc, const t_vec3 *pixels, const t_tile *window,
+							   const unsigned char *backdrop, bool compress, const char *path)
+{
+	t_image_writer w;
+	if (!image_writer_open(&w, acc->width, acc->height, window, backdrop, compress, path))
+		return false;
+	w.pixels = pixels;
+	w.samples = acc->samples;
+	int band = (w.format == IMAGE_FORMAT_EXR) ? EXR_TILE_SIZE : IMAGE_WRITE_BAND;
+	int bands = (w.window.y1 - w.window.y0 + band - 1) / band;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int b = 0; b < bands; ++b)
+	{
+		t_tile t = {w.window.x0, w.window.y0 + b * band, w.window.x1, w.window.y0 + (b + 1) * band};
+		if (t.y1 > w.window.y1)
+			t.y1 = w.window.y1;
+		image_writer_put_tile(&w, acc, &t);
+	}
+	return image_writer_close(&w, true);
+}
+
+#endif
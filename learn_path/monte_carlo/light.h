@@ -0,0 +1,721 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   light.h                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/06 14:21:37 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/06 14:21:37 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "types.h"
+#include "vector.h"
+#include "ray.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "pdf.h"
+#include "quad.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "guide.h"
+#include "envmap.h"
+
+/* Scene light list for next-event estimation. Each emitter the scene wants
+   sampled directly is registered here (a copy of its geometry); at every
+   non-delta bounce the camera picks one light, samples a point on it and
+   traces a shadow ray. Light samples and BSDF samples that reach a
+   registered light are combined with the power heuristic (MIS), so small
+   lights and sharp lobes are both handled; unregistered emitters are only
+   found by BSDF sampling and keep their full weight.
+
+   With many lights, light_list_build arranges them in a light BVH: every
+   node bounds its emitters' positions, the directions they face (a cone of
+   normals) and their total power, and the light is picked by walking down
+   the tree, choosing each child in proportion to how much it could light
+   the shading point. Lights behind the surface, facing away or far off are
+   then rarely picked, and noise stays flat as lights are added. */
+
+#define LIGHT_BVH_BINS 12		 /* split candidates per axis */
+#define LIGHT_BVH_SAOH_DEPTH 32	 /* deeper ranges are simply halved */
+#define LIGHT_BVH_STACK 72		 /* >= deepest tree + 1 */
+#define LIGHT_MIN_RADIANCE 1e-4 /* no emitter is ruled out on its estimated power */
+#define LIGHT_ENVIRONMENT_SHARE 0.5 /* light samples given to the environment map when there are lights too */
+
+typedef enum e_light_kind
+{
+	LIGHT_QUAD,
+	LIGHT_SPHERE,
+	LIGHT_TRIANGLE
+} t_light_kind;
+
+typedef struct s_light
+{
+	t_light_kind kind;
+	union
+	{
+		t_quad quad;
+		t_sphere sphere;
+		t_triangle tri;
+	} shape;
+	const t_material *mat;
+} t_light;
+
+/* What a group of emitters can send out: where they are, which way they
+   face (normals within acos(cos_o) of axis, or of -axis too when two_sided;
+   cos_o = -1 for all ways) and how much power they emit */
+typedef struct s_light_bounds
+{
+	t_aabb box;
+	t_vec3 axis;
+	real_t cos_o;
+	bool two_sided;
+	real_t power;
+} t_light_bounds;
+
+typedef struct s_light_node
+{
+	t_light_bounds bounds;
+	int child; /* first of two consecutive children, -1 = leaf */
+	int light; /* leaf: index into the light list */
+} t_light_node;
+
+typedef struct s_light_list
+{
+	t_light *items;
+	size_t count;
+	size_t capacity;
+	t_light_node *nodes; /* light BVH, root first; NULL = uniform choice */
+	size_t node_count;
+} t_light_list;
+
+static inline void light_list_init(t_light_list *lights)
+{
+	lights->items = NULL;
+	lights->count = 0;
+	lights->capacity = 0;
+	lights->nodes = NULL;
+	lights->node_count = 0;
+}
+
+static inline void light_list_clear(t_light_list *lights)
+{
+	if (!lights)
+		return;
+	free(lights->items);
+	free(lights->nodes);
+	light_list_init(lights);
+}
+
+/* Adding a light drops the light BVH: build it again once all are in */
+static inline bool light_list_add(t_light_list *lights, const t_light *light)
+{
+	if (!light->mat)
+		return false;
+	free(lights->nodes);
+	lights->nodes = NULL;
+	lights->node_count = 0;
+	if (lights->count + 1 > lights->capacity)
+	{
+		size_t newcap = (lights->capacity == 0) ? 4 : lights->capacity * 2;
+		t_light *arr = (t_light *)realloc(lights->items, newcap * sizeof(t_light));
+		if (!arr)
+			return false;
+		lights->items = arr;
+		lights->capacity = newcap;
+	}
+	lights->items[lights->count++] = *light;
+	return true;
+}
+
+static inline bool light_list_add_quad(t_light_list *lights, const t_quad *quad)
+{
+	t_light l = {.kind = LIGHT_QUAD, .shape.quad = *quad, .mat = quad->mat};
+	return light_list_add(lights, &l);
+}
+
+static inline bool light_list_add_sphere(t_light_list *lights, const t_sphere *s)
+{
+	t_light l = {.kind = LIGHT_SPHERE, .shape.sphere = *s, .mat = s->mat};
+	return light_list_add(lights, &l);
+}
+
+static inline bool light_list_add_triangle(t_light_list *lights, const t_triangle *tri)
+{
+	t_light l = {.kind = LIGHT_TRIANGLE, .shape.tri = *tri, .mat = tri->mat};
+	return light_list_add(lights, &l);
+}
+
+static inline bool light_list_empty(const t_light_list *lights)
+{
+	return !lights || lights->count == 0;
+}
+
+/* Direction from origin toward a random point of the light */
+static inline t_vec3 light_random(const t_light *light, const t_point3 *origin, real_t time)
+{
+	if (light->kind == LIGHT_QUAD)
+		return quad_light_random(&light->shape.quad, origin);
+	if (light->kind == LIGHT_SPHERE)
+		return sphere_light_random(&light->shape.sphere, origin, time);
+	return triangle_light_random(&light->shape.tri, origin);
+}
+
+/* Solid-angle density of r->dir under light_random */
+static inline real_t light_pdf(const t_light *light, const t_ray *r)
+{
+	if (light->kind == LIGHT_QUAD)
+		return quad_light_pdf(&light->shape.quad, r);
+	if (light->kind == LIGHT_SPHERE)
+		return sphere_light_pdf(&light->shape.sphere, r);
+	return triangle_light_pdf(&light->shape.tri, r);
+}
+
+/* Intersect the light alone (for the emission at the sampled point) */
+static inline bool light_hit(const t_light *light, const t_ray *r, t_hit_record *rec)
+{
+	t_interval all = interval((real_t)0.0, INFINITY);
+	if (light->kind == LIGHT_QUAD)
+		return quad_hit(&light->shape.quad, r, all, rec);
+	if (light->kind == LIGHT_TRIANGLE)
+		return triangle_hit(&light->shape.tri, r, all, rec);
+	set_current_sphere(&light->shape.sphere);
+	return sphere_hit_noobj(r, all, rec);
+}
+
+/* ========================================================================== */
+/*                               LIGHT BVH                                    */
+/* ========================================================================== */
+
+/* Emitted radiance of a light, averaged over a few points of its surface */
+static inline real_t light_radiance_estimate(const t_light *light, const t_point3 *center)
+{
+	real_t sum = (real_t)0.0;
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+		{
+			t_color le = light->mat->emitted(light->mat, (real_t)(0.25 * (i + 1)), (real_t)(0.25 * (j + 1)), center);
+			sum += color_luminance(&le);
+		}
+	sum /= (real_t)9.0;
+	return (sum > (real_t)LIGHT_MIN_RADIANCE) ? sum : (real_t)LIGHT_MIN_RADIANCE;
+}
+
+/* Bounds of a single light. Spheres emit every way; quads and triangles
+   emit from both faces. */
+static inline t_light_bounds light_bounds_of(const t_light *light)
+{
+	t_light_bounds b;
+	real_t area;
+	if (light->kind == LIGHT_SPHERE)
+	{
+		real_t r = light->shape.sphere.radius;
+		b.box = light->shape.sphere.bbox;
+		b.axis = vec3_create((real_t)0.0, (real_t)0.0, (real_t)1.0);
+		b.cos_o = (real_t)-1.0;
+		b.two_sided = false;
+		area = (real_t)(4.0 * PI) * r * r;
+	}
+	else if (light->kind == LIGHT_QUAD)
+	{
+		t_vec3 n = cross(&light->shape.quad.u, &light->shape.quad.v);
+		b.box = light->shape.quad.bbox;
+		b.axis = light->shape.quad.normal;
+		b.cos_o = (real_t)1.0;
+		b.two_sided = true;
+		area = vec3_length(&n);
+	}
+	else
+	{
+		t_vec3 n = cross(&light->shape.tri.e1, &light->shape.tri.e2);
+		b.box = light->shape.tri.bbox;
+		b.axis = light->shape.tri.normal;
+		b.cos_o = (real_t)1.0;
+		b.two_sided = true;
+		area = (real_t)0.5 * vec3_length(&n);
+	}
+	/* Flat emitters get some thickness, or rays would never cross their box */
+	real_t extent = (real_t)fmax(fmax(fabs((double)b.box.x.min), fabs((double)b.box.x.max)),
+								 fmax(fmax(fabs((double)b.box.y.min), fabs((double)b.box.y.max)),
+									  fmax(fabs((double)b.box.z.min), fabs((double)b.box.z.max))));
+	real_t pad = (real_t)1e-4 * ((real_t)1.0 + extent);
+	b.box.x = interval_expand(b.box.x.min, b.box.x.max, pad);
+	b.box.y = interval_expand(b.box.y.min, b.box.y.max, pad);
+	b.box.z = interval_expand(b.box.z.min, b.box.z.max, pad);
+	t_point3 c = vec3_create((b.box.x.min + b.box.x.max) * (real_t)0.5, (b.box.y.min + b.box.y.max) * (real_t)0.5,
+							 (b.box.z.min + b.box.z.max) * (real_t)0.5);
+	b.power = area * light_radiance_estimate(light, &c);
+	return b;
+}
+
+/* Smallest cone holding the normals of both cones (angles in radians) */
+static inline void light_cone_union(t_vec3 *axis, real_t *theta, const t_vec3 *axis_b, real_t theta_b)
+{
+	real_t d = dot(axis, axis_b);
+	real_t theta_d = (real_t)acos(d < (real_t)-1.0 ? -1.0 : (d > (real_t)1.0 ? 1.0 : (double)d));
+	if (fmin((double)(theta_d + theta_b), PI) <= (double)*theta)
+		return;
+	if (fmin((double)(theta_d + *theta), PI) <= (double)theta_b)
+	{
+		*axis = *axis_b;
+		*theta = theta_b;
+		return;
+	}
+	real_t theta_o = (*theta + theta_d + theta_b) * (real_t)0.5;
+	t_vec3 k = cross(axis, axis_b);
+	real_t k_len = vec3_length(&k);
+	if (theta_o >= (real_t)PI || k_len <= (real_t)1e-6)
+	{
+		*theta = (real_t)PI;
+		return;
+	}
+	/* Rotate axis towards axis_b by theta_o - theta (Rodrigues, k _|_ axis) */
+	real_t rot = theta_o - *theta;
+	k = vec3_mul_scalar(&k, (real_t)1.0 / k_len);
+	t_vec3 kxa = cross(&k, axis);
+	t_vec3 a = vec3_mul_scalar(axis, (real_t)cos((double)rot));
+	kxa = vec3_mul_scalar(&kxa, (real_t)sin((double)rot));
+	a = vec3_add(&a, &kxa);
+	*axis = unit_vector(&a);
+	*theta = theta_o;
+}
+
+static inline t_light_bounds light_bounds_union(const t_light_bounds *a, const t_light_bounds *b)
+{
+	t_light_bounds u;
+	u.box = aabb_merge(&a->box, &b->box);
+	u.power = a->power + b->power;
+	u.axis = a->axis;
+	u.two_sided = a->two_sided && b->two_sided;
+	if (a->two_sided != b->two_sided || a->cos_o <= (real_t)-1.0 || b->cos_o <= (real_t)-1.0)
+	{
+		u.cos_o = (real_t)-1.0;
+		u.two_sided = false;
+		return u;
+	}
+	t_vec3 axis_b = b->axis;
+	if (u.two_sided && dot(&u.axis, &axis_b) < (real_t)0.0)
+		axis_b = vec3_neg(&axis_b);
+	real_t theta = (real_t)acos((double)a->cos_o);
+	light_cone_union(&u.axis, &theta, &axis_b, (real_t)acos((double)b->cos_o));
+	u.cos_o = (real_t)cos((double)theta);
+	if (theta >= (real_t)PI)
+	{
+		u.cos_o = (real_t)-1.0;
+		u.two_sided = false;
+	}
+	return u;
+}
+
+/* cos(max(0, a - b)) from cos a and cos b, a and b in [0, pi] */
+static inline real_t light_cos_sub(real_t cos_a, real_t cos_b)
+{
+	if (cos_a >= cos_b)
+		return (real_t)1.0;
+	real_t sin_a = (real_t)sqrt(fmax(0.0, 1.0 - (double)(cos_a * cos_a)));
+	real_t sin_b = (real_t)sqrt(fmax(0.0, 1.0 - (double)(cos_b * cos_b)));
+	return cos_a * cos_b + sin_a * sin_b;
+}
+
+/* Upper estimate of the light a group of emitters sends to a surface at p
+   with normal n: power over squared distance, times the best emitter and
+   receiver cosines any point of the box could have. 0 only when none of
+   them can light the surface. */
+static inline real_t light_bounds_importance(const t_light_bounds *b, const t_point3 *p, const t_vec3 *n)
+{
+	t_vec3 lo = vec3_create(b->box.x.min, b->box.y.min, b->box.z.min);
+	t_vec3 hi = vec3_create(b->box.x.max, b->box.y.max, b->box.z.max);
+	t_vec3 c = vec3_add(&lo, &hi);
+	c = vec3_mul_scalar(&c, (real_t)0.5);
+	t_vec3 diag = vec3_sub(&hi, &lo);
+	real_t r2 = (real_t)0.25 * dot(&diag, &diag);
+	t_vec3 w = vec3_sub(p, &c);
+	real_t d2 = dot(&w, &w);
+	if (d2 <= r2)
+		return (r2 > (real_t)0.0) ? b->power / r2 : b->power;
+
+	/* The box covers a cone of half-angle u around the direction to c */
+	real_t cos_u = (real_t)sqrt(1.0 - (double)(r2 / d2));
+	real_t inv_d = (real_t)1.0 / (real_t)sqrt((double)d2);
+	real_t cos_i = light_cos_sub(-dot(n, &w) * inv_d, cos_u);
+	if (cos_i <= (real_t)0.0)
+		return (real_t)0.0;
+	real_t cos_w = dot(&b->axis, &w) * inv_d;
+	if (b->two_sided)
+		cos_w = (real_t)fabs((double)cos_w);
+	real_t cos_e = light_cos_sub(light_cos_sub(cos_w, b->cos_o), cos_u);
+	if (cos_e <= (real_t)0.0)
+		return (real_t)0.0;
+	return b->power * cos_i * cos_e / d2;
+}
+
+/* Chance of going to the first child of an inner node from p, n; -1 when
+   neither child can light the surface */
+static inline real_t light_bvh_first_prob(const t_light_list *lights, const t_light_node *node,
+										  const t_point3 *p, const t_vec3 *n)
+{
+	real_t a = light_bounds_importance(&lights->nodes[node->child].bounds, p, n);
+	real_t b = light_bounds_importance(&lights->nodes[node->child + 1].bounds, p, n);
+	if (!(a + b > (real_t)0.0))
+		return (real_t)-1.0;
+	return a / (a + b);
+}
+
+/* Solid angle the normals of a cone spread light into, for the build cost */
+static inline real_t light_bounds_orientation(const t_light_bounds *b)
+{
+	double theta_o = acos((double)b->cos_o);
+	double theta_w = fmin(theta_o + PI / 2.0, PI);
+	double sin_o = sin(theta_o);
+	double m = 2.0 * PI * (1.0 - (double)b->cos_o)
+			   + PI / 2.0 * (2.0 * theta_w * sin_o - cos(theta_o - 2.0 * theta_w) - 2.0 * theta_o * sin_o
+							 + (double)b->cos_o);
+	if (b->two_sided)
+		m = fmin(2.0 * m, 4.0 * PI * PI);
+	return (real_t)m;
+}
+
+/* Build cost of a group: power times spatial and angular extent */
+static inline real_t light_bounds_cost(const t_light_bounds *b)
+{
+	return b->power * aabb_surface_area(&b->box) * light_bounds_orientation(b);
+}
+
+static inline real_t light_bounds_centroid(const t_light_bounds *b, int axis)
+{
+	const t_interval *span = aabb_axis_interval(&b->box, axis);
+	return (span->min + span->max) * (real_t)0.5;
+}
+
+/* Where to split order[start, end): the cheapest of the binned planes
+   across the three axes (Conty Estevez and Kulla's SAOH), or halfway */
+static inline int light_bvh_split(const t_light_bounds *lb, int *order, int start, int end,
+								  const t_light_bounds *parent, int depth)
+{
+	int half = start + (end - start) / 2;
+	if (depth >= LIGHT_BVH_SAOH_DEPTH)
+		return half;
+	t_aabb cbox = aabb_empty();
+	for (int k = start; k < end; ++k)
+	{
+		t_point3 c = vec3_create(light_bounds_centroid(&lb[order[k]], 0), light_bounds_centroid(&lb[order[k]], 1),
+								 light_bounds_centroid(&lb[order[k]], 2));
+		t_aabb point = aabb_from_points(&c, &c);
+		cbox = aabb_merge(&cbox, &point);
+	}
+	const t_interval *spans[3] = {&cbox.x, &cbox.y, &cbox.z};
+	const t_interval *pspans[3] = {&parent->box.x, &parent->box.y, &parent->box.z};
+	real_t longest = (real_t)0.0;
+	for (int a = 0; a < 3; ++a)
+		if (interval_size(pspans[a]) > longest)
+			longest = interval_size(pspans[a]);
+	real_t best = INFINITY;
+	int best_axis = -1;
+	int best_bin = 0;
+	for (int a = 0; a < 3; ++a)
+	{
+		real_t extent = interval_size(spans[a]);
+		if (!(extent > (real_t)0.0))
+			continue;
+		t_light_bounds bins[LIGHT_BVH_BINS];
+		int counts[LIGHT_BVH_BINS] = {0};
+		for (int k = start; k < end; ++k)
+		{
+			int bin = (int)((light_bounds_centroid(&lb[order[k]], a) - spans[a]->min) / extent * LIGHT_BVH_BINS);
+			bin = (bin < 0) ? 0 : (bin >= LIGHT_BVH_BINS ? LIGHT_BVH_BINS - 1 : bin);
+			bins[bin] = counts[bin] ? light_bounds_union(&bins[bin], &lb[order[k]]) : lb[order[k]];
+			++counts[bin];
+		}
+		/* Thin boxes split across their short side are penalised */
+		real_t kr = longest / interval_size(pspans[a]);
+		for (int s = 1; s < LIGHT_BVH_BINS; ++s)
+		{
+			t_light_bounds left;
+			t_light_bounds right;
+			int nl = 0;
+			int nr = 0;
+			for (int bin = 0; bin < LIGHT_BVH_BINS; ++bin)
+			{
+				if (!counts[bin])
+					continue;
+				if (bin < s)
+					left = nl++ ? light_bounds_union(&left, &bins[bin]) : bins[bin];
+				else
+					right = nr++ ? light_bounds_union(&right, &bins[bin]) : bins[bin];
+			}
+			if (!nl || !nr)
+				continue;
+			real_t cost = kr * (light_bounds_cost(&left) + light_bounds_cost(&right));
+			if (cost < best)
+			{
+				best = cost;
+				best_axis = a;
+				best_bin = s;
+			}
+		}
+	}
+	if (best_axis < 0)
+		return half;
+	int mid = start;
+	for (int k = start; k < end; ++k)
+	{
+		real_t extent = interval_size(spans[best_axis]);
+		int bin = (int)((light_bounds_centroid(&lb[order[k]], best_axis) - spans[best_axis]->min) / extent
+						* LIGHT_BVH_BINS);
+		if (bin < best_bin)
+		{
+			int tmp = order[mid];
+			order[mid++] = order[k];
+			order[k] = tmp;
+		}
+	}
+	return (mid > start && mid < end) ? mid : half;
+}
+
+static inline void light_bvh_build_node(t_light_list *lights, const t_light_bounds *lb, int *order, int start,
+										int end, int index, int depth)
+{
+	t_light_node *node = &lights->nodes[index];
+	node->bounds = lb[order[start]];
+	for (int k = start + 1; k < end; ++k)
+		node->bounds = light_bounds_union(&node->bounds, &lb[order[k]]);
+	node->child = -1;
+	node->light = order[start];
+	if (end - start == 1)
+		return;
+	int mid = light_bvh_split(lb, order, start, end, &node->bounds, depth);
+	node->child = (int)lights->node_count;
+	node->light = -1;
+	lights->node_count += 2;
+	light_bvh_build_node(lights, lb, order, start, mid, node->child, depth + 1);
+	light_bvh_build_node(lights, lb, order, mid, end, node->child + 1, depth + 1);
+}
+
+/* Build the light BVH over the registered lights (call after the last add).
+   Returns false when out of memory; lights are then picked uniformly. */
+static inline bool light_list_build(t_light_list *lights)
+{
+	free(lights->nodes);
+	lights->nodes = NULL;
+	lights->node_count = 0;
+	if (lights->count < 2)
+		return true;
+	int n = (int)lights->count;
+	t_light_bounds *lb = (t_light_bounds *)malloc((size_t)n * sizeof(t_light_bounds));
+	int *order = (int *)malloc((size_t)n * sizeof(int));
+	lights->nodes = (t_light_node *)malloc((size_t)(2 * n - 1) * sizeof(t_light_node));
+	if (!lb || !order || !lights->nodes)
+	{
+		free(lb);
+		free(order);
+		free(lights->nodes);
+		lights->nodes = NULL;
+		return false;
+	}
+	for (int k = 0; k < n; ++k)
+	{
+		lb[k] = light_bounds_of(&lights->items[k]);
+		order[k] = k;
+	}
+	lights->node_count = 1;
+	light_bvh_build_node(lights, lb, order, 0, n, 0, 0);
+	free(lb);
+	free(order);
+	return true;
+}
+
+/* Light to sample from a surface at p with normal n, chosen with u in
+   [0,1): uniformly without a light BVH, otherwise down the tree by
+   importance (u rescaled at every level). *prob gets the chance of that
+   pick; NULL when no light can reach the surface. */
+static inline const t_light *light_list_pick(const t_light_list *lights, const t_point3 *p, const t_vec3 *n,
+											 real_t u, real_t *prob)
+{
+	if (!lights->nodes)
+	{
+		int k = (int)(u * (real_t)lights->count);
+		*prob = (real_t)1.0 / (real_t)lights->count;
+		return &lights->items[(k < (int)lights->count) ? k : (int)lights->count - 1];
+	}
+	real_t pick = (real_t)1.0;
+	const t_light_node *node = &lights->nodes[0];
+	while (node->child >= 0)
+	{
+		real_t first = light_bvh_first_prob(lights, node, p, n);
+		if (first < (real_t)0.0)
+			return NULL;
+		if (u < first)
+		{
+			u /= first;
+			pick *= first;
+			node = &lights->nodes[node->child];
+		}
+		else
+		{
+			u = (u - first) / ((real_t)1.0 - first);
+			pick *= (real_t)1.0 - first;
+			node = &lights->nodes[node->child + 1];
+		}
+	}
+	*prob = pick;
+	return (pick > (real_t)0.0) ? &lights->items[node->light] : NULL;
+}
+
+/* Share of direct-lighting samples spent on the environment map: all of
+   them without registered lights, none without a map */
+static inline real_t light_environment_share(const t_light_list *lights, const t_envmap *env)
+{
+	if (!env || !env->row_prob)
+		return (real_t)0.0;
+	return light_list_empty(lights) ? (real_t)1.0 : (real_t)LIGHT_ENVIRONMENT_SHARE;
+}
+
+/* Density with which light sampling produces direction r->dir ending on an
+   emitter of material mat at distance t (0 if no registered light is there),
+   for a ray leaving a surface at p with normal n. With a light BVH only the
+   nodes the ray crosses before t are visited. env is the environment map
+   sharing the light samples, or NULL. */
+static inline real_t light_list_pdf(const t_light_list *lights, const t_envmap *env, const t_ray *r, real_t t,
+									const t_material *mat, const t_point3 *p, const t_vec3 *n)
+{
+	if (light_list_empty(lights))
+		return (real_t)0.0;
+	real_t share = (real_t)1.0 - light_environment_share(lights, env);
+	real_t pdf = (real_t)0.0;
+	if (!lights->nodes)
+	{
+		for (size_t k = 0; k < lights->count; ++k)
+		{
+			const t_light *light = &lights->items[k];
+			t_hit_record lrec;
+			if (light->mat != mat || !light_hit(light, r, &lrec))
+				continue;
+			if (fabs((double)(lrec.t - t)) <= 1e-4 * (1.0 + (double)t))
+				pdf += light_pdf(light, r);
+		}
+		return share * pdf / (real_t)lights->count;
+	}
+	int stack[LIGHT_BVH_STACK];
+	real_t stack_pick[LIGHT_BVH_STACK];
+	int top = 0;
+	stack[top] = 0;
+	stack_pick[top++] = (real_t)1.0;
+	real_t reach = t * (real_t)(1.0 + 1e-3) + (real_t)1e-4;
+	while (top > 0)
+	{
+		--top;
+		const t_light_node *node = &lights->nodes[stack[top]];
+		real_t pick = stack_pick[top];
+		t_interval span = interval((real_t)0.0, reach);
+		if (!aabb_hit(&node->bounds.box, r, &span))
+			continue;
+		if (node->child < 0)
+		{
+			const t_light *light = &lights->items[node->light];
+			t_hit_record lrec;
+			if (light->mat == mat && light_hit(light, r, &lrec)
+				&& fabs((double)(lrec.t - t)) <= 1e-4 * (1.0 + (double)t))
+				pdf += pick * light_pdf(light, r);
+			continue;
+		}
+		real_t first = light_bvh_first_prob(lights, node, p, n);
+		if (first < (real_t)0.0)
+			continue;
+		if (first > (real_t)0.0)
+		{
+			stack[top] = node->child;
+			stack_pick[top++] = pick * first;
+		}
+		if (first < (real_t)1.0)
+		{
+			stack[top] = node->child + 1;
+			stack_pick[top++] = pick * ((real_t)1.0 - first);
+		}
+	}
+	return share * pdf;
+}
+
+/* Direct lighting from the environment map: a direction drawn from its
+   alias tables, one shadow ray to infinity. share is the chance this
+   strategy was chosen. */
+static inline t_color light_environment_direct(const t_envmap *env, real_t share, const t_hittable_list *world,
+											   const t_ray *r_in, const t_hit_record *rec,
+											   const t_color *attenuation, const t_guide_mix *mix)
+{
+	t_vec3 dir;
+	real_t pdf;
+	if (!envmap_sample(env, &dir, &pdf) || dot(&dir, &rec->normal) <= (real_t)0.0)
+		return vec3_zero();
+	pdf *= share;
+	t_ray shadow = ray_create(ray_offset_origin(&rec->p, &rec->normal, &dir), dir, r_in->tm);
+	real_t bsdf_pdf = rec->mat->scattering_pdf(rec->mat, r_in, rec, &shadow);
+	if (bsdf_pdf <= (real_t)0.0)
+		return vec3_zero();
+	RT_STAT_INC(shadow_rays);
+	if (hittable_list_occluded(world, &shadow, interval(RAY_T_MIN, INFINITY)))
+		return vec3_zero();
+
+	real_t path_pdf = guide_mix_pdf(mix, rec->mat->sampling_pdf(rec->mat, r_in, rec, &shadow), &dir);
+	real_t weight = mis_power_heuristic(pdf, path_pdf);
+	t_color le = envmap_radiance(env, &dir);
+	t_color f = vec3_mul_scalar(attenuation, weight * bsdf_pdf / pdf);
+	return vec3_mul_elem(&f, &le);
+}
+
+/* Direct lighting at a non-delta hit: one light picked (light_list_pick),
+   one point sampled on it, one shadow ray, MIS-weighted against the
+   material's own sampling. attenuation is the surface albedo returned by
+   scatter; the BSDF times cosine is albedo * scattering_pdf. mix, when the
+   bounce is guided, gives the density the path's own sampling would have
+   had. With an environment map (env not NULL) the same random number
+   first chooses between the map and the lights. */
+static inline t_color light_list_direct(const t_light_list *lights, const t_envmap *env,
+										const t_hittable_list *world, const t_ray *r_in, const t_hit_record *rec,
+										const t_color *attenuation, const t_guide_mix *mix)
+{
+	real_t share = light_environment_share(lights, env);
+	if ((light_list_empty(lights) && share <= (real_t)0.0) || !rec->mat->scattering_pdf
+		|| !rec->mat->sampling_pdf)
+		return vec3_zero();
+	real_t u = random_real();
+	if (u < share)
+		return light_environment_direct(env, share, world, r_in, rec, attenuation, mix);
+	u = (u - share) / ((real_t)1.0 - share);
+	real_t pick;
+	const t_light *light = light_list_pick(lights, &rec->p, &rec->normal, u, &pick);
+	if (!light)
+		return vec3_zero();
+	pick *= (real_t)1.0 - share;
+
+	t_vec3 to_light = light_random(light, &rec->p, r_in->tm);
+	if (dot(&to_light, &rec->normal) <= (real_t)0.0)
+		return vec3_zero();
+	t_vec3 dir = unit_vector(&to_light);
+	t_ray shadow = ray_create(ray_offset_origin(&rec->p, &rec->normal, &dir), dir, r_in->tm);
+	real_t pdf = light_pdf(light, &shadow) * pick;
+	t_hit_record lrec;
+	if (pdf <= (real_t)0.0 || !light_hit(light, &shadow, &lrec))
+		return vec3_zero();
+
+	real_t bsdf_pdf = rec->mat->scattering_pdf(rec->mat, r_in, rec, &shadow);
+	if (bsdf_pdf <= (real_t)0.0)
+		return vec3_zero();
+	RT_STAT_INC(shadow_rays);
+	if (hittable_list_occluded(world, &shadow, interval(RAY_T_MIN, lrec.t * (real_t)(1.0 - 1e-4))))
+		return vec3_zero();
+
+	real_t path_pdf = guide_mix_pdf(mix, rec->mat->sampling_pdf(rec->mat, r_in, rec, &shadow), &dir);
+	real_t weight = mis_power_heuristic(pdf, path_pdf);
+	t_color le = light->mat->emitted(light->mat, lrec.u, lrec.v, &lrec.p);
+	t_color f = vec3_mul_scalar(attenuation, weight * bsdf_pdf / pdf);
+	return vec3_mul_elem(&f, &le);
+}
+
+#endif
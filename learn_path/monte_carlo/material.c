@@ -0,0 +1,7 @@
+/* ============================================================================ */
+/*                               MATERIAL IDS                                   */
+/* ============================================================================ */
+
+#include "common.h"
+
+uint32_t g_material_count = 0;
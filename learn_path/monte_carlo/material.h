@@ -41,10 +41,30 @@ typedef struct s_material
 	real_t (*scattering_pdf)(const struct s_material *mat, const t_ray *r_in,
 							 const t_hit_record *rec, const t_ray *scattered);
 
+	/* Density of the directions scatter() samples (solid angle), used to weight
+	   BSDF against light sampling. NULL for delta materials (sharp mirrors,
+	   glass), which are never light-sampled. */
+	real_t (*sampling_pdf)(const struct s_material *mat, const t_ray *r_in,
+						   const t_hit_record *rec, const t_ray *scattered);
+
 	/* Optional destructor for cleanup */
 	void (*destroy)(struct s_material *mat);
+
+	/* Wide lobe (diffuse): bounces off it may be path guided (guide.h) */
+	bool diffuse;
+
+	/* Creation order, starting at 1 (material-id AOV) */
+	uint32_t id;
 } t_material;
 
+/* Materials created so far, shared by every translation unit (material.c) */
+extern uint32_t g_material_count;
+
+static inline uint32_t material_next_id(void)
+{
+	return ++g_material_count;
+}
+
 /* ============================================================================ */
 /*                          HELPER FUNCTIONS (MOVED EARLY)                      */
 /* ============================================================================ */
@@ -149,6 +169,30 @@ static inline real_t lambertian_scattering_pdf(const t_material *mat, const t_ra
 	return cos_theta / (real_t)PI;
 }
 
+/* Density of direction dir under fuzzy reflection: unit(mirror + fuzz * u)
+   with u uniform on the unit sphere. The point mirror + fuzz * u is uniform
+   on a sphere of radius fuzz around the unit mirror vector; a direction meets
+   that sphere at t+ and t- and the density sums both crossings. */
+static inline real_t fuzz_lobe_pdf(const t_vec3 *mirror, real_t fuzz, const t_vec3 *dir)
+{
+	t_vec3 w = unit_vector(dir);
+	real_t b = dot(&w, mirror);
+	real_t disc = b * b - ((real_t)1.0 - fuzz * fuzz);
+	if (b <= (real_t)0.0 || disc <= (real_t)1e-12)
+		return (real_t)0.0;
+	real_t sq = (real_t)sqrt((double)disc);
+	real_t t_far = b + sq;
+	real_t t_near = b - sq;
+	return (t_far * t_far + t_near * t_near) / ((real_t)(4.0 * PI) * fuzz * sq);
+}
+
+/* Unit mirror direction of r_in about the hit normal */
+static inline t_vec3 material_mirror(const t_ray *r_in, const t_hit_record *rec)
+{
+	t_vec3 reflected = vec3_reflect(&r_in->dir, &rec->normal);
+	return unit_vector(&reflected);
+}
+
 /* Lambertian scatter: sample texture color and preserve ray time */
 static inline bool lambertian_scatter(const t_material *mat, const t_ray *r_in,
 									  const t_hit_record *rec, t_color *attenuation, t_ray *scattered)
@@ -174,6 +218,18 @@ static inline bool lambertian_scatter(const t_material *mat, const t_ray *r_in,
 	return true;
 }
 
+/* Fuzzy metal: scatter samples fuzz_lobe_pdf and returns the albedo, so the
+   lobe density is both the scattering and the sampling pdf */
+static inline real_t metal_scattering_pdf(const t_material *mat, const t_ray *r_in,
+										  const t_hit_record *rec, const t_ray *scattered)
+{
+	const t_metal *metal = (const t_metal *)mat->data;
+	if (dot(&scattered->dir, &rec->normal) <= (real_t)0.0)
+		return (real_t)0.0;
+	t_vec3 mirror = material_mirror(r_in, rec);
+	return fuzz_lobe_pdf(&mirror, metal->fuzz, &scattered->dir);
+}
+
 /* Metal scatter: preserve ray time */
 static inline bool metal_scatter(const t_material *mat, const t_ray *r_in,
 								 const t_hit_record *rec, t_color *attenuation, t_ray *scattered)
@@ -285,6 +341,21 @@ static inline bool tinted_glass_scatter(const t_material *mat, const t_ray *r_in
 	return true;
 }
 
+/* Glossy: mixture of the fuzzy specular lobe (probability 1 - roughness,
+   fuzz roughness / 2) and the cosine lobe (probability roughness) */
+static inline real_t glossy_scattering_pdf(const t_material *mat, const t_ray *r_in,
+										   const t_hit_record *rec, const t_ray *scattered)
+{
+	const t_glossy *glossy = (const t_glossy *)mat->data;
+	real_t len = vec3_length(&scattered->dir);
+	real_t cos_theta = dot(&rec->normal, &scattered->dir) / len;
+	if (cos_theta <= (real_t)0.0 || len <= (real_t)0.0)
+		return (real_t)0.0;
+	t_vec3 mirror = material_mirror(r_in, rec);
+	real_t spec = fuzz_lobe_pdf(&mirror, glossy->roughness * (real_t)0.5, &scattered->dir);
+	return ((real_t)1.0 - glossy->roughness) * spec + glossy->roughness * cos_theta / (real_t)PI;
+}
+
 /* Glossy scatter: blend between specular and diffuse */
 static inline bool glossy_scatter(const t_material *mat, const t_ray *r_in,
 								  const t_hit_record *rec, t_color *attenuation, t_ray *scattered)
@@ -305,8 +376,9 @@ static inline bool glossy_scatter(const t_material *mat, const t_ray *r_in,
 		t_vec3 fuzz_offset = vec3_mul_scalar(&fuzz_vec, glossy->roughness * 0.5);
 		t_vec3 direction = vec3_add(&unit_reflected, &fuzz_offset);
 
+		/* Below the surface: absorbed, as glossy_scattering_pdf assumes */
 		if (dot(&direction, &rec->normal) <= 0)
-			direction = rec->normal;
+			return false;
 
 		*scattered = ray_create(rec->p, direction, r_in->tm);
 	}
@@ -473,6 +545,7 @@ static inline t_material *lambertian_create_texture(t_texture *tex)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_lambertian *lamb = (t_lambertian *)malloc(sizeof(t_lambertian));
 	if (!lamb)
@@ -487,7 +560,9 @@ static inline t_material *lambertian_create_texture(t_texture *tex)
 	mat->emitted = default_emitted;
 	mat->scatter = lambertian_scatter;
 	mat->scattering_pdf = lambertian_scattering_pdf;
+	mat->sampling_pdf = lambertian_scattering_pdf;
 	mat->destroy = lambertian_destroy;
+	mat->diffuse = true;
 
 	return mat;
 }
@@ -498,6 +573,7 @@ static inline t_material *lambertian_create(t_color albedo)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_lambertian *lamb = (t_lambertian *)malloc(sizeof(t_lambertian));
 	if (!lamb)
@@ -518,7 +594,9 @@ static inline t_material *lambertian_create(t_color albedo)
 	mat->emitted = default_emitted;
 	mat->scatter = lambertian_scatter;
 	mat->scattering_pdf = lambertian_scattering_pdf;
+	mat->sampling_pdf = lambertian_scattering_pdf;
 	mat->destroy = lambertian_destroy; /* solid color texture is owned */
+	mat->diffuse = true;
 
 	return mat;
 }
@@ -529,6 +607,7 @@ static inline t_material *metal_create_fuzz(t_color albedo, real_t fuzz)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_metal *metal = (t_metal *)malloc(sizeof(t_metal));
 	if (!metal)
@@ -548,8 +627,10 @@ static inline t_material *metal_create_fuzz(t_color albedo, real_t fuzz)
 	mat->data = metal;
 	mat->emitted = default_emitted;
 	mat->scatter = metal_scatter;
-	mat->scattering_pdf = default_scattering_pdf;
+	mat->scattering_pdf = (fuzz > (real_t)0.0) ? metal_scattering_pdf : default_scattering_pdf;
+	mat->sampling_pdf = (fuzz > (real_t)0.0) ? metal_scattering_pdf : NULL;
 	mat->destroy = metal_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -566,6 +647,7 @@ static inline t_material *dielectric_create(real_t refraction_index)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_dielectric *dielec = (t_dielectric *)malloc(sizeof(t_dielectric));
 	if (!dielec)
@@ -580,7 +662,9 @@ static inline t_material *dielectric_create(real_t refraction_index)
 	mat->emitted = default_emitted;
 	mat->scatter = dielectric_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = dielectric_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -591,6 +675,7 @@ static inline t_material *tinted_glass_create(real_t refraction_index, t_color t
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_tinted_glass *glass = (t_tinted_glass *)malloc(sizeof(t_tinted_glass));
 	if (!glass)
@@ -606,7 +691,9 @@ static inline t_material *tinted_glass_create(real_t refraction_index, t_color t
 	mat->emitted = default_emitted;
 	mat->scatter = tinted_glass_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = tinted_glass_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -617,6 +704,7 @@ static inline t_material *glossy_create(t_color albedo, real_t roughness, real_t
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_glossy *glossy = (t_glossy *)malloc(sizeof(t_glossy));
 	if (!glossy)
@@ -632,8 +720,10 @@ static inline t_material *glossy_create(t_color albedo, real_t roughness, real_t
 	mat->data = glossy;
 	mat->emitted = default_emitted;
 	mat->scatter = glossy_scatter;
-	mat->scattering_pdf = default_scattering_pdf;
+	mat->scattering_pdf = (glossy->roughness > (real_t)0.0) ? glossy_scattering_pdf : default_scattering_pdf;
+	mat->sampling_pdf = (glossy->roughness > (real_t)0.0) ? glossy_scattering_pdf : NULL;
 	mat->destroy = glossy_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -644,6 +734,7 @@ static inline t_material *diffuse_light_create(t_color emit)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_diffuse_light *light = (t_diffuse_light *)malloc(sizeof(t_diffuse_light));
 	if (!light)
@@ -666,7 +757,9 @@ static inline t_material *diffuse_light_create(t_color emit)
 	mat->emitted = diffuse_light_emitted;
 	mat->scatter = diffuse_light_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = diffuse_light_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -690,6 +783,7 @@ static inline t_material *diffuse_light_create_texture(t_texture *tex)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_diffuse_light *light = (t_diffuse_light *)malloc(sizeof(t_diffuse_light));
 	if (!light)
@@ -705,7 +799,9 @@ static inline t_material *diffuse_light_create_texture(t_texture *tex)
 	mat->emitted = diffuse_light_emitted;
 	mat->scatter = diffuse_light_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = diffuse_light_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -726,6 +822,7 @@ static inline t_material *isotropic_create(t_color albedo)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_isotropic *iso = (t_isotropic *)malloc(sizeof(t_isotropic));
 	if (!iso)
@@ -746,7 +843,9 @@ static inline t_material *isotropic_create(t_color albedo)
 	mat->emitted = default_emitted;
 	mat->scatter = isotropic_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = isotropic_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -760,6 +859,7 @@ static inline t_material *isotropic_create_texture(t_texture *tex)
 	t_material *mat = (t_material *)malloc(sizeof(t_material));
 	if (!mat)
 		return NULL;
+	mat->id = material_next_id();
 
 	t_isotropic *iso = (t_isotropic *)malloc(sizeof(t_isotropic));
 	if (!iso)
@@ -774,7 +874,9 @@ static inline t_material *isotropic_create_texture(t_texture *tex)
 	mat->emitted = default_emitted;
 	mat->scatter = isotropic_scatter;
 	mat->scattering_pdf = default_scattering_pdf;
+	mat->sampling_pdf = NULL;
 	mat->destroy = isotropic_destroy;
+	mat->diffuse = false;
 
 	return mat;
 }
@@ -229,4 +229,19 @@ static inline t_pdf *mixture_pdf_create(t_pdf *p0, t_pdf *p1)
 	return pdf;
 }
 
+/* ============================================================================ */
+/*                          MULTIPLE IMPORTANCE SAMPLING                        */
+/* ============================================================================ */
+
+/* Power heuristic (beta = 2): weight of a sample drawn with density pf when
+   the same direction could also have come from a strategy with density pg */
+static inline real_t mis_power_heuristic(real_t pf, real_t pg)
+{
+	real_t f2 = pf * pf;
+	real_t g2 = pg * pg;
+	if (f2 + g2 <= (real_t)0.0)
+		return (real_t)0.0;
+	return f2 / (f2 + g2);
+}
+
 #endif
@@ -121,6 +121,7 @@ static inline bool quad_hit(const t_quad *quad, const t_ray *r, t_interval rayt,
 	/* basic validation */
 	if (!quad || !r || !rec)
 		return false;
+	RT_STAT_PRIM(STAT_PRIM_QUAD);
 
 	/* Ray-plane intersection: denom = dot(n, dir) */
 	real_t denom = (real_t)dot(&quad->normal, &r->dir);
@@ -156,6 +157,9 @@ static inline bool quad_hit(const t_quad *quad, const t_ray *r, t_interval rayt,
 	/* Check if point is interior and set UV; reject if exterior */
 	if (!quad_is_interior(alpha, beta, rec))
 		return false;
+#ifdef RT_REFINE_HITS
+	ray_refine_plane_hit(r, &quad->normal, &quad->q, &t, &p);
+#endif
 
 	/* Ray hits the 2D shape; set the rest of the hit record and return true */
 	rec->t = t;
@@ -166,6 +170,31 @@ static inline bool quad_hit(const t_quad *quad, const t_ray *r, t_interval rayt,
 	return true;
 }
 
+/* Light sampling: solid-angle density of direction r->dir seen from r->orig
+   when directions are drawn by quad_light_random (0 if the ray misses) */
+static inline real_t quad_light_pdf(const t_quad *quad, const t_ray *r)
+{
+	t_hit_record rec;
+	if (!quad_hit(quad, r, interval((real_t)0.0, INFINITY), &rec))
+		return (real_t)0.0;
+	real_t area = vec3_length(&quad->w);
+	real_t len_sq = vec3_length_squared(&r->dir);
+	real_t cosine = (real_t)fabs((double)dot(&r->dir, &quad->normal)) / (real_t)sqrt((double)len_sq);
+	if (area <= (real_t)0.0 || cosine < (real_t)1e-8)
+		return (real_t)0.0;
+	return rec.t * rec.t * len_sq / (cosine * area);
+}
+
+/* Light sampling: vector from origin to a uniform point on the quad */
+static inline t_vec3 quad_light_random(const t_quad *quad, const t_point3 *origin)
+{
+	t_vec3 du = vec3_mul_scalar(&quad->u, random_real());
+	t_vec3 dv = vec3_mul_scalar(&quad->v, random_real());
+	t_point3 p = vec3_add(&quad->q, &du);
+	p = vec3_add(&p, &dv);
+	return vec3_sub(&p, origin);
+}
+
 /* Bind current quad for hit_noobj indirection (mirrors sphere pattern) */
 static __thread const t_quad *g_current_quad = NULL;
 static inline void set_current_quad(const void *obj)
@@ -16,47 +16,49 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <limits.h>
-#include <time.h>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 #include "settings.h"
 #include "types.h"
+#include "sampler.h"
 
-/* Fast xorshift64* RNG */
-static inline uint64_t random_seed(uint64_t seed)
+/* Counter-based RNG: every value is a hash of a key and a counter, so any
+   draw can be regenerated on its own. During a camera sample the key is a
+   hash of (seed, pixel, sample index) set by sampler_start, which makes a
+   render independent of the thread count and of how pixels are split
+   between passes or processes. Outside camera samples (scene construction)
+   each thread walks its own sequence derived from g_random_seed. */
+
+/* Set the seed of the scene-construction sequence and restart it on the
+   calling thread (camera samples use camera->seed) */
+static inline void random_set_seed(uint64_t seed)
 {
-	if (seed == 0)
-		seed = (uint64_t)time(NULL) ^ 0x9e3779b97f4a7c15ULL;
-	return seed;
+	g_random_seed = seed;
+	g_sample_stream.free_counter = 0;
 }
 
 static inline uint64_t random_u64(void)
 {
-	/* thread-local state for thread-safe RNG */
-	static __thread uint64_t state = 0;
-	if (state == 0)
-	{
-		uint64_t t = (uint64_t)time(NULL);
-		uint64_t addr = (uint64_t)(uintptr_t)&state;
+	t_sample_stream *s = &g_sample_stream;
+	if (s->active)
+		return random_mix64(s->key + ++s->counter * RANDOM_GAMMA);
 #ifdef _OPENMP
-		uint64_t tid = (uint64_t)omp_get_thread_num();
+	uint64_t tid = (uint64_t)omp_get_thread_num();
 #else
-		uint64_t tid = 0;
+	uint64_t tid = 0;
 #endif
-		state = random_seed(t ^ addr ^ (tid * 0x9e3779b97f4a7c15ULL));
-	}
-
-	/* xorshift64* */
-	state ^= state >> 12;
-	state ^= state << 25;
-	state ^= state >> 27;
-	return state * 0x2545F4914F6CDD1DULL;
+	uint64_t key = g_random_seed ^ random_mix64(tid + 1);
+	return random_mix64(key + ++s->free_counter * RANDOM_GAMMA);
 }
 
-/* return a random real in [0,1) using 53-bit mantissa scaling */
+/* return a random real in [0,1) using 53-bit mantissa scaling; while the
+   sampler has a block open, its next dimension instead */
 static inline real_t random_real(void)
 {
+	real_t v;
+	if (g_sample_stream.dim < g_sample_stream.dim_end && sampler_next(&v))
+		return v;
 	const uint64_t rnd = random_u64();
 	const uint64_t mantissa = rnd >> 11;					/* keep top 53 bits */
 	return (real_t)(mantissa * (1.0 / 9007199254740992.0)); /* 1 / 2^53 */
@@ -13,6 +13,10 @@
 #ifndef RAY_H
 #define RAY_H
 
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "types.h"
 #include "vector.h"
 
@@ -82,4 +86,96 @@ static inline t_vec3 ray_at(t_ray *ray, real_t t)
 	return (vec3_add(&ray->orig, &scaled));
 }
 
+/* ============================================================================ */
+/*                          ROBUST SECONDARY RAYS                               */
+/* ============================================================================ */
+
+/* Rays leaving a surface start from the hit point pushed off it along the
+   normal (Wachter and Binder, "A Fast and Robust Method for Avoiding
+   Self-Intersection"): by a fixed number of ulps of each coordinate, so the
+   offset follows the hit point's own rounding error at any scale, or by a
+   small absolute step near the world origin where ulps vanish. The new ray
+   then needs no tmin beyond RAY_T_MIN. */
+
+#define RAY_T_MIN ((real_t)0.0)
+#define RAY_OFFSET_ORIGIN 0.03125		  /* below this coordinate use the absolute step */
+#define RAY_OFFSET_FLOAT_SCALE (1.0 / 65536.0) /* absolute step per unit of normal */
+#ifdef FLOAT_TYPE
+#define RAY_OFFSET_INT_SCALE 256.0 /* ulps per unit of normal */
+#else
+#define RAY_OFFSET_INT_SCALE 65536.0
+#endif
+
+static inline real_t ray_offset_coord(real_t p, real_t n)
+{
+	if (fabs((double)p) < RAY_OFFSET_ORIGIN)
+		return p + (real_t)(RAY_OFFSET_FLOAT_SCALE * (double)n);
+#ifdef FLOAT_TYPE
+	int32_t bits;
+	int32_t ulps = (int32_t)(RAY_OFFSET_INT_SCALE * (double)n);
+#else
+	int64_t bits;
+	int64_t ulps = (int64_t)(RAY_OFFSET_INT_SCALE * (double)n);
+#endif
+	memcpy(&bits, &p, sizeof(p));
+	bits += (p < (real_t)0.0) ? -ulps : ulps;
+	memcpy(&p, &bits, sizeof(p));
+	return p;
+}
+
+/* Origin of a ray leaving surface point p (unit normal n) towards dir */
+static inline t_point3 ray_offset_origin(const t_point3 *p, const t_vec3 *n, const t_vec3 *dir)
+{
+	real_t side = (dot(n, dir) < (real_t)0.0) ? (real_t)-1.0 : (real_t)1.0;
+	return vec3_create(ray_offset_coord(p->x, side * n->x), ray_offset_coord(p->y, side * n->y),
+					   ray_offset_coord(p->z, side * n->z));
+}
+
+/* Mixed precision (float builds with RT_REFINE_HITS): an accepted plane or
+   sphere hit is solved again in double, so t and the hit point stay exact
+   on large-coordinate scenes where float ulps reach the size of details. */
+#ifdef RT_REFINE_HITS
+static inline t_point3 ray_at_double(const t_ray *r, double t)
+{
+	return vec3_create((real_t)((double)r->orig.x + t * (double)r->dir.x),
+					   (real_t)((double)r->orig.y + t * (double)r->dir.y),
+					   (real_t)((double)r->orig.z + t * (double)r->dir.z));
+}
+
+static inline double ray_dot_double(const t_vec3 *a, const t_vec3 *b)
+{
+	return (double)a->x * (double)b->x + (double)a->y * (double)b->y + (double)a->z * (double)b->z;
+}
+
+/* Plane through q with normal n */
+static inline void ray_refine_plane_hit(const t_ray *r, const t_vec3 *n, const t_point3 *q,
+										real_t *t, t_point3 *p)
+{
+	double denom = ray_dot_double(n, &r->dir);
+	if (denom == 0.0)
+		return;
+	double td = (ray_dot_double(n, q) - ray_dot_double(n, &r->orig)) / denom;
+	*t = (real_t)td;
+	*p = ray_at_double(r, td);
+}
+
+/* Sphere of the given centre and radius, nearer or farther root */
+static inline void ray_refine_sphere_hit(const t_ray *r, const t_point3 *center, double radius,
+										 bool far_root, real_t *t, t_point3 *p)
+{
+	double ox = (double)r->orig.x - (double)center->x;
+	double oy = (double)r->orig.y - (double)center->y;
+	double oz = (double)r->orig.z - (double)center->z;
+	double a = ray_dot_double(&r->dir, &r->dir);
+	double half_b = (double)r->dir.x * ox + (double)r->dir.y * oy + (double)r->dir.z * oz;
+	double c = ox * ox + oy * oy + oz * oz - radius * radius;
+	double disc = half_b * half_b - a * c;
+	if (disc < 0.0 || a == 0.0)
+		return;
+	double td = (-half_b + (far_root ? sqrt(disc) : -sqrt(disc))) / a;
+	*t = (real_t)td;
+	*p = ray_at_double(r, td);
+}
+#endif
+
 #endif
\ No newline at end of file
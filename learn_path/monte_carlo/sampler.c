@@ -0,0 +1,10 @@
+/* ============================================================================ */
+/*                       SAMPLE STREAMS AND RNG STATE                           */
+/* ============================================================================ */
+
+#include "sampler.h"
+
+__thread t_sample_stream g_sample_stream;
+uint64_t g_random_seed = 0x853c49e6748fea9bULL;
+float g_blue_noise[SAMPLER_BLUE_NOISE_SIZE * SAMPLER_BLUE_NOISE_SIZE];
+bool g_blue_noise_ready = false;
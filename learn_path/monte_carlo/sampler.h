@@ -0,0 +1,363 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sampler.h                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/06 18:02:11 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/06 18:02:11 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "types.h"
+
+/* Per-sample random numbers. While a camera sample is being traced, the
+   thread's sample stream hands out the dimensions of sample `index` of the
+   current pixel, and random_real() draws from it. The camera and the path
+   loop open a fixed block of dimensions before each decision (pixel, lens,
+   time, then BSDF / light / roulette per bounce), so a given dimension always
+   feeds the same decision; draws outside an open block come from the
+   sample's counter-based sequence (see random.h).
+
+   SAMPLER_RANDOM	hash of (seed, pixel, sample, dimension)
+   SAMPLER_SOBOL	padded 2D Sobol, Owen-scrambled per pixel and dimension
+   SAMPLER_HALTON	Owen-scrambled Halton, one prime base per dimension
+   SAMPLER_BLUE_NOISE	Sobol shared by all pixels, each dimension shifted by a
+   			blue-noise mask so the error left is high-frequency */
+
+typedef enum e_sampler_kind
+{
+	SAMPLER_RANDOM, /* hashed random numbers, stratified pixel positions */
+	SAMPLER_SOBOL,
+	SAMPLER_HALTON,
+	SAMPLER_BLUE_NOISE
+} t_sampler_kind;
+
+/* Dimension layout of one camera sample */
+#define SAMPLER_DIM_PIXEL 0	  /* 2 dims: position in the pixel */
+#define SAMPLER_DIM_LENS 2	  /* 2 dims: point on the defocus disk */
+#define SAMPLER_DIM_TIME 4	  /* 1 dim: shutter time */
+#define SAMPLER_CAMERA_DIMS 5 /* first bounce dimension */
+#define SAMPLER_BOUNCE_DIMS 8 /* dimensions per bounce: */
+#define SAMPLER_BSDF 0		  /*   scatter, up to 4 */
+#define SAMPLER_LIGHT 4		  /*   light choice + point on it */
+#define SAMPLER_ROULETTE 7	  /*   Russian roulette */
+
+#define SAMPLER_HALTON_DIMS 64	  /* prime bases available */
+#define SAMPLER_BLUE_NOISE_SIZE 64 /* mask edge, power of two */
+
+#define RANDOM_GAMMA 0x9e3779b97f4a7c15ULL /* SplitMix64 increment */
+
+typedef struct s_sample_stream
+{
+	t_sampler_kind kind;
+	bool active;	/* inside a camera sample */
+	uint32_t index; /* sample number within the pixel */
+	uint32_t seed;	/* per-pixel scrambling hash (shared by all pixels for blue noise) */
+	uint64_t key;	/* hash of (seed, pixel, sample) */
+	uint64_t counter;	   /* draws outside open blocks in this sample */
+	uint64_t free_counter; /* draws outside camera samples on this thread */
+	int px;			/* blue-noise mask coordinates of the pixel */
+	int py;
+	int dim;	 /* next dimension */
+	int dim_end; /* end of the open block */
+} t_sample_stream;
+
+/* One stream per thread, shared by every translation unit (sampler.c) */
+extern __thread t_sample_stream g_sample_stream;
+extern uint64_t g_random_seed;
+extern float g_blue_noise[SAMPLER_BLUE_NOISE_SIZE * SAMPLER_BLUE_NOISE_SIZE];
+extern bool g_blue_noise_ready;
+
+static const uint16_t g_sampler_primes[SAMPLER_HALTON_DIMS] = {
+	2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+	59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+	137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+	227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+
+/* ============================================================================ */
+/*                              HASHING / SCRAMBLING                            */
+/* ============================================================================ */
+
+static inline uint32_t sampler_hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+/* SplitMix64 finalizer */
+static inline uint64_t random_mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static inline uint32_t sampler_hash2(uint32_t a, uint32_t b)
+{
+	return sampler_hash(a ^ sampler_hash(b + 0x9e3779b9U));
+}
+
+static inline uint32_t sampler_reverse_bits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+	x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+	x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+	x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/* Owen scrambling of a 32-bit fraction: hash-based permutation applied to the
+   bit-reversed value, each bit flipped depending on the bits above it */
+static inline uint32_t sampler_owen_scramble(uint32_t x, uint32_t seed)
+{
+	x = sampler_reverse_bits(x);
+	x ^= x * 0x3d20adeaU;
+	x += seed;
+	x *= (seed >> 16) | 1U;
+	x ^= x * 0x05526c56U;
+	x ^= x * 0x53a22864U;
+	return sampler_reverse_bits(x);
+}
+
+/* Element i of a pseudo-random permutation of [0, n) chosen by seed
+   (Kensler's hash, cycle-walking until the value lands in range) */
+static inline uint32_t sampler_permute(uint32_t i, uint32_t n, uint32_t seed)
+{
+	uint32_t w = n - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do
+	{
+		i ^= seed;
+		i *= 0xe170893dU;
+		i ^= seed >> 16;
+		i ^= (i & w) >> 4;
+		i ^= seed >> 8;
+		i *= 0x0929eb3fU;
+		i ^= seed >> 23;
+		i ^= (i & w) >> 1;
+		i *= 1U | seed >> 27;
+		i *= 0x6935fa69U;
+		i ^= (i & w) >> 11;
+		i *= 0x74dcb303U;
+		i ^= (i & w) >> 2;
+		i *= 0x9e501cc3U;
+		i ^= (i & w) >> 2;
+		i *= 0xc860a3dfU;
+		i &= w;
+		i ^= i >> 5;
+	} while (i >= n);
+	return (i + seed) % n;
+}
+
+/* 32-bit fraction to [0, 1), exact in float as well */
+static inline real_t sampler_to_unit(uint32_t x)
+{
+	return (real_t)((double)(x >> 8) * (1.0 / 16777216.0));
+}
+
+/* ============================================================================ */
+/*                                 SEQUENCES                                    */
+/* ============================================================================ */
+
+/* First two Sobol dimensions (a (0,2)-sequence) as 32-bit fractions */
+static inline uint32_t sampler_sobol(uint32_t index, int dim)
+{
+	uint32_t r = 0;
+	uint32_t v = 1U << 31;
+	for (; index; index >>= 1)
+	{
+		if (index & 1U)
+			r ^= v;
+		v = dim ? v ^ (v >> 1) : v >> 1;
+	}
+	return r;
+}
+
+/* Dimension `dim` of a padded Sobol sequence: dimensions are taken in pairs,
+   each pair an independently shuffled and scrambled 2D Sobol */
+static inline uint32_t sampler_sobol_padded(uint32_t index, int dim, uint32_t seed)
+{
+	uint32_t pair_seed = sampler_hash2(seed, (uint32_t)(dim >> 1));
+	uint32_t shuffled = sampler_owen_scramble(index, pair_seed);
+	uint32_t x = sampler_sobol(shuffled, dim & 1);
+	return sampler_owen_scramble(x, sampler_hash2(seed, (uint32_t)dim + 0x68bc21ebU));
+}
+
+/* Owen-scrambled radical inverse of index in base b: the digit permutation
+   at each level depends on the digits already emitted */
+static inline real_t sampler_halton(uint32_t index, uint32_t b, uint32_t seed)
+{
+	double inv_b = 1.0 / (double)b;
+	double f = inv_b;
+	double r = 0.0;
+	uint32_t prefix = 0;
+	while (f * (double)b > 1.0 / 4294967296.0)
+	{
+		uint32_t digit = index % b;
+		index /= b;
+		uint32_t perm = sampler_permute(digit, b, sampler_hash2(seed, prefix));
+		r += (double)perm * f;
+		prefix = prefix * b + digit + 1U;
+		f *= inv_b;
+	}
+	real_t v = (real_t)r;
+	return (v < (real_t)1.0) ? v : (real_t)(1.0 - 1.0 / 16777216.0);
+}
+
+/* ============================================================================ */
+/*                              BLUE-NOISE MASK                                 */
+/* ============================================================================ */
+
+/* Fill g_blue_noise with a tileable blue-noise rank mask (values in [0, 1)):
+   void-and-cluster ranking, each next pixel placed in the largest void of
+   the ones placed so far. Call once before rendering, outside parallel code. */
+static inline bool sampler_blue_noise_prepare(void)
+{
+	enum { N = SAMPLER_BLUE_NOISE_SIZE, N2 = N * N };
+	if (g_blue_noise_ready)
+		return true;
+	float *kernel = (float *)malloc(N2 * sizeof(float));
+	float *energy = (float *)malloc(N2 * sizeof(float));
+	if (!kernel || !energy)
+	{
+		free(kernel);
+		free(energy);
+		return false;
+	}
+	const double sigma = 1.9;
+	for (int y = 0; y < N; ++y)
+		for (int x = 0; x < N; ++x)
+		{
+			int dx = (x <= N / 2) ? x : N - x;
+			int dy = (y <= N / 2) ? y : N - y;
+			kernel[y * N + x] = (float)exp(-(double)(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+		}
+	/* A tiny jitter breaks the ties of the empty mask */
+	for (int k = 0; k < N2; ++k)
+	{
+		energy[k] = (float)(sampler_hash((uint32_t)k) >> 8) * (1e-6f / 16777216.0f);
+		g_blue_noise[k] = -1.0f;
+	}
+	for (int rank = 0; rank < N2; ++rank)
+	{
+		int best = -1;
+		for (int k = 0; k < N2; ++k)
+			if (g_blue_noise[k] < 0.0f && (best < 0 || energy[k] < energy[best]))
+				best = k;
+		g_blue_noise[best] = ((float)rank + 0.5f) / (float)N2;
+		int bx = best % N;
+		int by = best / N;
+		for (int y = 0; y < N; ++y)
+			for (int x = 0; x < N; ++x)
+				energy[y * N + x] += kernel[((y - by) & (N - 1)) * N + ((x - bx) & (N - 1))];
+	}
+	free(kernel);
+	free(energy);
+	g_blue_noise_ready = true;
+	return true;
+}
+
+/* ============================================================================ */
+/*                               SAMPLE STREAM                                  */
+/* ============================================================================ */
+
+/* Start sample `index` of pixel (i, j) on this thread; the pixel block is open */
+static inline void sampler_start(t_sampler_kind kind, uint64_t seed, int i, int j, int index)
+{
+	t_sample_stream *s = &g_sample_stream;
+	uint64_t pixel = ((uint64_t)(uint32_t)j << 32) | (uint32_t)i;
+	uint32_t seed32 = (uint32_t)random_mix64(seed);
+	s->kind = kind;
+	s->active = true;
+	s->index = (uint32_t)index;
+	s->seed = (kind == SAMPLER_BLUE_NOISE) ? seed32 : sampler_hash2((uint32_t)i ^ seed32, (uint32_t)j * 0x9e3779b9U);
+	s->key = random_mix64(seed ^ random_mix64(pixel ^ random_mix64((uint64_t)(uint32_t)index + RANDOM_GAMMA)));
+	s->counter = 0;
+	s->px = i & (SAMPLER_BLUE_NOISE_SIZE - 1);
+	s->py = j & (SAMPLER_BLUE_NOISE_SIZE - 1);
+	s->dim = SAMPLER_DIM_PIXEL;
+	s->dim_end = SAMPLER_DIM_PIXEL + 2;
+}
+
+/* Leave the camera sample: draws go back to the thread's own sequence */
+static inline void sampler_stop(void)
+{
+	g_sample_stream.active = false;
+	g_sample_stream.dim_end = 0;
+}
+
+/* Open `count` dimensions starting at absolute dimension `dim` */
+static inline void sampler_open(int dim, int count)
+{
+	if (!g_sample_stream.active)
+		return;
+	g_sample_stream.dim = dim;
+	g_sample_stream.dim_end = dim + count;
+}
+
+/* Open the block at `offset` within the dimensions of bounce `bounce` */
+static inline void sampler_open_bounce(int bounce, int offset, int count)
+{
+	sampler_open(SAMPLER_CAMERA_DIMS + bounce * SAMPLER_BOUNCE_DIMS + offset, count);
+}
+
+/* Close the open block: further draws use the sample's counter sequence */
+static inline void sampler_close(void)
+{
+	g_sample_stream.dim_end = g_sample_stream.dim;
+}
+
+/* Next dimension of the open block into *out; false when the sampler has
+   no value for it (caller falls back to the counter sequence) */
+static inline bool sampler_next(real_t *out)
+{
+	t_sample_stream *s = &g_sample_stream;
+	int d = s->dim++;
+	if (s->kind == SAMPLER_RANDOM)
+	{
+		uint64_t h = random_mix64(s->key ^ random_mix64((uint64_t)d + 0x632be59bd9b4e019ULL));
+		*out = (real_t)((double)(h >> 11) * (1.0 / 9007199254740992.0));
+	}
+	else if (s->kind == SAMPLER_SOBOL)
+		*out = sampler_to_unit(sampler_sobol_padded(s->index, d, s->seed));
+	else if (s->kind == SAMPLER_HALTON)
+	{
+		if (d >= SAMPLER_HALTON_DIMS)
+			return false;
+		*out = sampler_halton(s->index, g_sampler_primes[d], sampler_hash2(s->seed, (uint32_t)d));
+	}
+	else if (s->kind == SAMPLER_BLUE_NOISE && g_blue_noise_ready)
+	{
+		/* Every dimension reads the mask at its own toroidal offset */
+		uint32_t h = sampler_hash((uint32_t)d + 0x2545f491U);
+		int mx = (s->px + (int)(h & 0xFFFFU)) & (SAMPLER_BLUE_NOISE_SIZE - 1);
+		int my = (s->py + (int)(h >> 16)) & (SAMPLER_BLUE_NOISE_SIZE - 1);
+		uint32_t shift = (uint32_t)((double)g_blue_noise[my * SAMPLER_BLUE_NOISE_SIZE + mx] * 4294967296.0);
+		*out = sampler_to_unit(sampler_sobol_padded(s->index, d, 0U) + shift);
+	}
+	else
+		return false;
+	return true;
+}
+
+#endif
@@ -0,0 +1,720 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sdf.h                                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/05 14:02:11 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/05 14:02:11 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef SDF_H
+#define SDF_H
+
+#include "types.h"
+#include "vector.h"
+#include "ray.h"
+#include "point.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "interval.h"
+#include "aabb.h"
+#include "perlin.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Signed distance fields traced with sphere tracing.
+   - t_sdf_graph: analytic SDF built from primitives and CSG/displacement nodes,
+	 each node knowing its bounds and Lipschitz constant.
+   - t_sdf_bricks: the same field baked into sparse 8^3 bricks of int8 samples
+	 around the surface; every brick is its own BVH leaf. */
+
+#define SDF_MAX_STEPS 256
+#define SDF_NOISE_LIPSCHITZ 2.5 /* bound on |grad perlin_noise| */
+#define SDF_BRICK_CELLS 8
+#define SDF_BRICK_SAMPLES (SDF_BRICK_CELLS + 1)
+#define SDF_BRICK_SIZE (SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES)
+#define SDF_BRICK_LIPSCHITZ 1.25 /* slack for trilinear reconstruction */
+
+/* ============================================================================ */
+/*                              SPHERE TRACING                                  */
+/* ============================================================================ */
+
+typedef real_t (*t_sdf_eval_fn)(const void *field, const t_vec3 *p);
+
+/* Unit gradient by central differences (6 evaluations) */
+static inline t_vec3 sdf_gradient(t_sdf_eval_fn eval, const void *field, const t_vec3 *p, real_t h)
+{
+	t_vec3 px0 = vec3_create(p->x - h, p->y, p->z);
+	t_vec3 px1 = vec3_create(p->x + h, p->y, p->z);
+	t_vec3 py0 = vec3_create(p->x, p->y - h, p->z);
+	t_vec3 py1 = vec3_create(p->x, p->y + h, p->z);
+	t_vec3 pz0 = vec3_create(p->x, p->y, p->z - h);
+	t_vec3 pz1 = vec3_create(p->x, p->y, p->z + h);
+	t_vec3 g = vec3_create(eval(field, &px1) - eval(field, &px0),
+						   eval(field, &py1) - eval(field, &py0),
+						   eval(field, &pz1) - eval(field, &pz0));
+	real_t len = vec3_length(&g);
+	if (len < (real_t)1e-20)
+		return vec3_create(0, 1, 0);
+	return vec3_div_scalar(&g, len);
+}
+
+/* March r over [t0, t1] with steps of |d| / lipschitz. Rays that start on
+   the surface (scattered rays) first walk off it in the direction they head,
+   so they find the next crossing instead of their own origin. */
+static inline bool sdf_sphere_trace(t_sdf_eval_fn eval, const void *field, real_t lipschitz,
+									real_t eps, const t_ray *r, real_t t0, real_t t1, real_t *t_hit)
+{
+	real_t dir_len = vec3_length(&r->dir);
+	if (dir_len <= 0 || t0 > t1)
+		return false;
+	real_t inv_speed = (real_t)1.0 / (lipschitz * dir_len);
+	real_t min_step = eps / dir_len;
+
+	real_t t = t0;
+	t_vec3 p = ray_at((t_ray *)r, t);
+	real_t d = eval(field, &p);
+	real_t side = (d < 0) ? (real_t)-1.0 : (real_t)1.0;
+	bool escaping = false;
+	if (fabs(d) < eps)
+	{
+		t_vec3 n = sdf_gradient(eval, field, &p, eps);
+		side = (dot(&n, &r->dir) < 0) ? (real_t)-1.0 : (real_t)1.0;
+		escaping = true;
+	}
+
+	for (int step = 0; step < SDF_MAX_STEPS; ++step)
+	{
+		real_t ds = side * d;
+		if (escaping && ds >= eps)
+			escaping = false;
+		if (!escaping && ds < eps)
+		{
+			*t_hit = t;
+			return true;
+		}
+		real_t dt = fabs(ds) * inv_speed;
+		t += (dt > min_step) ? dt : min_step;
+		if (t > t1)
+			return false;
+		p = ray_at((t_ray *)r, t);
+		d = eval(field, &p);
+	}
+	return false;
+}
+
+/* Shade a converged march: normal from central differences, only here */
+static inline void sdf_fill_record(t_sdf_eval_fn eval, const void *field, real_t h,
+								   const t_ray *r, real_t t, t_material *mat, t_hit_record *rec)
+{
+	rec->t = t;
+	rec->p = ray_at((t_ray *)r, t);
+	t_vec3 n = sdf_gradient(eval, field, &rec->p, h);
+	set_face_normal(rec, r, &n);
+	rec->u = 0;
+	rec->v = 0;
+	rec->mat = mat;
+	rec->albedo = vec3_create((real_t)1.0, (real_t)1.0, (real_t)1.0);
+}
+
+/* ============================================================================ */
+/*                              ANALYTIC SDF GRAPH                              */
+/* ============================================================================ */
+
+typedef enum e_sdf_op
+{
+	SDF_SPHERE,
+	SDF_BOX,
+	SDF_TORUS,
+	SDF_CAPSULE,
+	SDF_UNION,
+	SDF_INTERSECT,
+	SDF_SUBTRACT,
+	SDF_SMOOTH_UNION,
+	SDF_TRANSLATE,
+	SDF_DISPLACE
+} t_sdf_op;
+
+/* One node; children are indices into the graph's node array */
+typedef struct s_sdf_node
+{
+	t_sdf_op op;
+	int a;
+	int b;
+	t_vec3 v0;		  /* center / segment start / offset */
+	t_vec3 v1;		  /* half extents / segment end */
+	real_t r0;		  /* radius / rounding / blend k / amplitude */
+	real_t r1;		  /* minor radius / frequency */
+	int octaves;
+	real_t lipschitz; /* |f(p) - f(q)| <= lipschitz * |p - q| */
+	t_aabb bbox;	  /* the surface lies inside this box */
+} t_sdf_node;
+
+typedef struct s_sdf_graph
+{
+	t_sdf_node *nodes;
+	int count;
+	int capacity;
+	int root;		  /* node traced by sdf_object; defaults to the last one added */
+	t_perlin *noise; /* allocated by the first displacement node */
+} t_sdf_graph;
+
+static inline void sdf_graph_init(t_sdf_graph *g)
+{
+	if (!g)
+		return;
+	g->nodes = NULL;
+	g->count = 0;
+	g->capacity = 0;
+	g->root = -1;
+	g->noise = NULL;
+}
+
+static inline void sdf_graph_clear(t_sdf_graph *g)
+{
+	if (!g)
+		return;
+	free(g->nodes);
+	free(g->noise);
+	sdf_graph_init(g);
+}
+
+/* Append a node, returns its index or -1 */
+static inline int sdf_graph_push(t_sdf_graph *g, const t_sdf_node *node)
+{
+	if (!g || !node)
+		return -1;
+	if (g->count >= g->capacity)
+	{
+		int newcap = (g->capacity == 0) ? 16 : g->capacity * 2;
+		t_sdf_node *arr = (t_sdf_node *)realloc(g->nodes, (size_t)newcap * sizeof(t_sdf_node));
+		if (!arr)
+			return -1;
+		g->nodes = arr;
+		g->capacity = newcap;
+	}
+	g->nodes[g->count] = *node;
+	g->root = g->count;
+	return g->count++;
+}
+
+static inline bool sdf_valid(const t_sdf_graph *g, int idx)
+{
+	return g && idx >= 0 && idx < g->count;
+}
+
+static inline t_aabb sdf_box_pad(const t_aabb *box, real_t pad)
+{
+	return ((t_aabb){
+		.x = interval(box->x.min - pad, box->x.max + pad),
+		.y = interval(box->y.min - pad, box->y.max + pad),
+		.z = interval(box->z.min - pad, box->z.max + pad)});
+}
+
+static inline t_aabb sdf_box_intersect(const t_aabb *a, const t_aabb *b)
+{
+	return ((t_aabb){
+		.x = interval(fmax(a->x.min, b->x.min), fmin(a->x.max, b->x.max)),
+		.y = interval(fmax(a->y.min, b->y.min), fmin(a->y.max, b->y.max)),
+		.z = interval(fmax(a->z.min, b->z.min), fmin(a->z.max, b->z.max))});
+}
+
+static inline t_aabb sdf_box_around(const t_vec3 *c, const t_vec3 *half)
+{
+	t_point3 lo = point3_create(c->x - half->x, c->y - half->y, c->z - half->z);
+	t_point3 hi = point3_create(c->x + half->x, c->y + half->y, c->z + half->z);
+	return aabb_from_points(&lo, &hi);
+}
+
+static inline int sdf_sphere(t_sdf_graph *g, t_point3 center, real_t radius)
+{
+	t_vec3 half = vec3_create(radius, radius, radius);
+	t_sdf_node n = {.op = SDF_SPHERE, .a = -1, .b = -1, .v0 = center, .r0 = radius,
+					.lipschitz = 1, .bbox = sdf_box_around(&center, &half)};
+	return sdf_graph_push(g, &n);
+}
+
+/* Box with half extents `half`, edges rounded by `rounding` (grows the box) */
+static inline int sdf_box(t_sdf_graph *g, t_point3 center, t_vec3 half, real_t rounding)
+{
+	t_vec3 outer = vec3_create(half.x + rounding, half.y + rounding, half.z + rounding);
+	t_sdf_node n = {.op = SDF_BOX, .a = -1, .b = -1, .v0 = center, .v1 = half, .r0 = rounding,
+					.lipschitz = 1, .bbox = sdf_box_around(&center, &outer)};
+	return sdf_graph_push(g, &n);
+}
+
+/* Torus in the xz plane */
+static inline int sdf_torus(t_sdf_graph *g, t_point3 center, real_t major, real_t minor)
+{
+	t_vec3 half = vec3_create(major + minor, minor, major + minor);
+	t_sdf_node n = {.op = SDF_TORUS, .a = -1, .b = -1, .v0 = center, .r0 = major, .r1 = minor,
+					.lipschitz = 1, .bbox = sdf_box_around(&center, &half)};
+	return sdf_graph_push(g, &n);
+}
+
+static inline int sdf_capsule(t_sdf_graph *g, t_point3 a, t_point3 b, real_t radius)
+{
+	t_point3 lo = point3_create(fmin(a.x, b.x), fmin(a.y, b.y), fmin(a.z, b.z));
+	t_point3 hi = point3_create(fmax(a.x, b.x), fmax(a.y, b.y), fmax(a.z, b.z));
+	t_aabb box = aabb_from_points(&lo, &hi);
+	t_sdf_node n = {.op = SDF_CAPSULE, .a = -1, .b = -1, .v0 = a, .v1 = b, .r0 = radius,
+					.lipschitz = 1, .bbox = sdf_box_pad(&box, radius)};
+	return sdf_graph_push(g, &n);
+}
+
+/* Binary CSG node; `k` is the blend radius for SDF_SMOOTH_UNION */
+static inline int sdf_combine(t_sdf_graph *g, t_sdf_op op, int a, int b, real_t k)
+{
+	if (!sdf_valid(g, a) || !sdf_valid(g, b))
+		return -1;
+	const t_sdf_node *na = &g->nodes[a];
+	const t_sdf_node *nb = &g->nodes[b];
+	t_sdf_node n = {.op = op, .a = a, .b = b, .r0 = k,
+					.lipschitz = fmax(na->lipschitz, nb->lipschitz)};
+	if (op == SDF_INTERSECT)
+		n.bbox = sdf_box_intersect(&na->bbox, &nb->bbox);
+	else if (op == SDF_SUBTRACT)
+		n.bbox = na->bbox;
+	else
+		n.bbox = aabb_merge(&na->bbox, &nb->bbox);
+	if (op == SDF_SMOOTH_UNION)
+		n.bbox = sdf_box_pad(&n.bbox, (real_t)0.25 * k);
+	return sdf_graph_push(g, &n);
+}
+
+static inline int sdf_translate(t_sdf_graph *g, int a, t_vec3 offset)
+{
+	if (!sdf_valid(g, a))
+		return -1;
+	const t_sdf_node *na = &g->nodes[a];
+	t_sdf_node n = {.op = SDF_TRANSLATE, .a = a, .b = -1, .v0 = offset,
+					.lipschitz = na->lipschitz, .bbox = aabb_add_vec3(&na->bbox, &offset)};
+	return sdf_graph_push(g, &n);
+}
+
+/* Add fractal Perlin noise (amplitude, base frequency, octaves) to a shape */
+static inline int sdf_displace(t_sdf_graph *g, int a, real_t amplitude, real_t frequency, int octaves)
+{
+	if (!sdf_valid(g, a) || octaves < 1)
+		return -1;
+	if (!g->noise)
+	{
+		g->noise = (t_perlin *)malloc(sizeof(t_perlin));
+		if (!g->noise)
+			return -1;
+		perlin_init(g->noise);
+	}
+	const t_sdf_node *na = &g->nodes[a];
+	/* octave o: amplitude * 2^-o * noise(p * frequency * 2^o) */
+	real_t reach = (real_t)2.0 * fabs(amplitude) * ((real_t)1.0 - ldexp(1.0, -octaves));
+	real_t slope = fabs(amplitude) * frequency * (real_t)octaves * (real_t)SDF_NOISE_LIPSCHITZ;
+	t_sdf_node n = {.op = SDF_DISPLACE, .a = a, .b = -1, .r0 = amplitude, .r1 = frequency,
+					.octaves = octaves, .lipschitz = na->lipschitz + slope,
+					.bbox = sdf_box_pad(&na->bbox, reach)};
+	return sdf_graph_push(g, &n);
+}
+
+static inline real_t sdf_fbm(const t_perlin *noise, const t_vec3 *p, real_t frequency, int octaves)
+{
+	real_t sum = 0;
+	real_t amp = 1;
+	for (int o = 0; o < octaves; ++o)
+	{
+		t_vec3 q = vec3_mul_scalar(p, frequency);
+		sum += amp * perlin_noise(noise, &q);
+		amp *= (real_t)0.5;
+		frequency *= (real_t)2.0;
+	}
+	return sum;
+}
+
+static inline real_t sdf_eval_node(const t_sdf_graph *g, int idx, const t_vec3 *p)
+{
+	const t_sdf_node *n = &g->nodes[idx];
+	switch (n->op)
+	{
+	case SDF_SPHERE:
+	{
+		t_vec3 q = vec3_sub(p, &n->v0);
+		return vec3_length(&q) - n->r0;
+	}
+	case SDF_BOX:
+	{
+		real_t qx = fabs(p->x - n->v0.x) - n->v1.x;
+		real_t qy = fabs(p->y - n->v0.y) - n->v1.y;
+		real_t qz = fabs(p->z - n->v0.z) - n->v1.z;
+		t_vec3 out = vec3_create(fmax(qx, 0), fmax(qy, 0), fmax(qz, 0));
+		real_t inside = fmin(fmax(qx, fmax(qy, qz)), 0);
+		return vec3_length(&out) + inside - n->r0;
+	}
+	case SDF_TORUS:
+	{
+		real_t dx = p->x - n->v0.x;
+		real_t dz = p->z - n->v0.z;
+		real_t qx = sqrt(dx * dx + dz * dz) - n->r0;
+		real_t qy = p->y - n->v0.y;
+		return sqrt(qx * qx + qy * qy) - n->r1;
+	}
+	case SDF_CAPSULE:
+	{
+		t_vec3 pa = vec3_sub(p, &n->v0);
+		t_vec3 ba = vec3_sub(&n->v1, &n->v0);
+		real_t bb = dot(&ba, &ba);
+		real_t h = (bb > 0) ? dot(&pa, &ba) / bb : 0;
+		h = fmin(fmax(h, 0), 1);
+		t_vec3 off = vec3_mul_scalar(&ba, h);
+		t_vec3 q = vec3_sub(&pa, &off);
+		return vec3_length(&q) - n->r0;
+	}
+	case SDF_UNION:
+		return fmin(sdf_eval_node(g, n->a, p), sdf_eval_node(g, n->b, p));
+	case SDF_INTERSECT:
+		return fmax(sdf_eval_node(g, n->a, p), sdf_eval_node(g, n->b, p));
+	case SDF_SUBTRACT:
+		return fmax(sdf_eval_node(g, n->a, p), -sdf_eval_node(g, n->b, p));
+	case SDF_SMOOTH_UNION:
+	{
+		real_t da = sdf_eval_node(g, n->a, p);
+		real_t db = sdf_eval_node(g, n->b, p);
+		real_t k = n->r0;
+		if (k <= 0)
+			return fmin(da, db);
+		real_t h = fmax(k - fabs(da - db), 0) / k;
+		return fmin(da, db) - h * h * k * (real_t)0.25;
+	}
+	case SDF_TRANSLATE:
+	{
+		t_vec3 q = vec3_sub(p, &n->v0);
+		return sdf_eval_node(g, n->a, &q);
+	}
+	case SDF_DISPLACE:
+		return sdf_eval_node(g, n->a, p) + n->r0 * sdf_fbm(g->noise, p, n->r1, n->octaves);
+	}
+	return INFINITY;
+}
+
+/* A traceable SDF: a graph root plus its material. The graph is shared and
+   must outlive the object (like a t_mesh and its triangles). */
+typedef struct s_sdf_object
+{
+	const t_sdf_graph *graph;
+	int root;
+	real_t lipschitz;
+	real_t eps;
+	t_material *mat;
+	t_aabb bbox;
+} t_sdf_object;
+
+static inline real_t sdf_object_eval(const void *field, const t_vec3 *p)
+{
+	const t_sdf_object *obj = (const t_sdf_object *)field;
+	return sdf_eval_node(obj->graph, obj->root, p);
+}
+
+static inline t_sdf_object sdf_object_create(const t_sdf_graph *g, t_material *mat)
+{
+	t_sdf_object obj;
+	obj.graph = g;
+	obj.root = (g) ? g->root : -1;
+	obj.mat = mat;
+	if (!sdf_valid(g, obj.root))
+	{
+		obj.lipschitz = 1;
+		obj.eps = (real_t)1e-4;
+		obj.bbox = aabb_empty();
+		return obj;
+	}
+	const t_sdf_node *root = &g->nodes[obj.root];
+	obj.lipschitz = (root->lipschitz > 1) ? root->lipschitz : 1;
+	obj.bbox = sdf_box_pad(&root->bbox, (real_t)1e-3);
+	/* Surface tolerance relative to the object size */
+	real_t diag = sqrt(interval_size(&obj.bbox.x) * interval_size(&obj.bbox.x)
+					   + interval_size(&obj.bbox.y) * interval_size(&obj.bbox.y)
+					   + interval_size(&obj.bbox.z) * interval_size(&obj.bbox.z));
+	obj.eps = fmax(diag * (real_t)1e-5, (real_t)1e-6);
+	return obj;
+}
+
+static inline bool sdf_object_hit(const t_sdf_object *obj, const t_ray *r,
+								  t_interval rayt, t_hit_record *rec)
+{
+	if (!obj || !r || !rec || !sdf_valid(obj->graph, obj->root))
+		return false;
+	RT_STAT_PRIM(STAT_PRIM_SDF);
+
+	/* March only inside the bounds */
+	t_interval span = rayt;
+	if (!aabb_hit(&obj->bbox, r, &span))
+		return false;
+	real_t t;
+	if (!sdf_sphere_trace(sdf_object_eval, obj, obj->lipschitz, obj->eps, r, span.min, span.max, &t))
+		return false;
+	if (!contains(rayt.min, rayt.max, t))
+		return false;
+	sdf_fill_record(sdf_object_eval, obj, obj->eps, r, t, obj->mat, rec);
+	return true;
+}
+
+static __thread const t_sdf_object *g_current_sdf = NULL;
+
+static inline void set_current_sdf(const void *obj)
+{
+	g_current_sdf = (const t_sdf_object *)obj;
+}
+
+static inline bool sdf_object_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
+{
+	if (!g_current_sdf)
+		return false;
+	return sdf_object_hit(g_current_sdf, r, rayt, rec);
+}
+
+/* Add an SDF object to the list (copies the object, not the graph) */
+static inline bool hittable_list_add_sdf(t_hittable_list *list, const t_sdf_object *obj)
+{
+	if (!list || !obj)
+		return false;
+	t_sdf_object *copy = (t_sdf_object *)malloc(sizeof(t_sdf_object));
+	if (!copy)
+		return false;
+	*copy = *obj;
+	t_hittable_wrapper wrap = {
+		.object = copy,
+		.owned = true,
+		.set_current = set_current_sdf,
+		.hit_noobj = sdf_object_hit_noobj,
+		.bbox = obj->bbox};
+	return hittable_list_add_wrapper(list, &wrap);
+}
+
+/* ============================================================================ */
+/*                          SPARSE BAKED SDF BRICKS                             */
+/* ============================================================================ */
+
+/* 8x8x8 cells (9^3 corner samples) of distance quantized to int8 over
+   [-band, band]; bricks are only kept where the surface passes through */
+typedef struct s_sdf_brick
+{
+	const int8_t *samples;
+	t_point3 origin;
+	real_t voxel;
+	real_t inv_voxel;
+	real_t dequant;	  /* band / 127 */
+	real_t lipschitz;
+	t_material *mat;
+	t_aabb bbox;
+} t_sdf_brick;
+
+typedef struct s_sdf_bricks
+{
+	int8_t *pool;
+	t_sdf_brick *bricks;
+	size_t count;
+	size_t capacity;
+	real_t voxel;
+	real_t band;
+	t_aabb bbox;
+} t_sdf_bricks;
+
+static inline void sdf_bricks_init(t_sdf_bricks *b)
+{
+	if (!b)
+		return;
+	b->pool = NULL;
+	b->bricks = NULL;
+	b->count = 0;
+	b->capacity = 0;
+	b->voxel = 0;
+	b->band = 0;
+	b->bbox = aabb_empty();
+}
+
+static inline void sdf_bricks_clear(t_sdf_bricks *b)
+{
+	if (!b)
+		return;
+	free(b->pool);
+	free(b->bricks);
+	sdf_bricks_init(b);
+}
+
+/* Bytes used by the baked field */
+static inline size_t sdf_bricks_memory(const t_sdf_bricks *b)
+{
+	return b->count * (SDF_BRICK_SIZE + sizeof(t_sdf_brick));
+}
+
+static inline real_t sdf_brick_eval(const void *field, const t_vec3 *p)
+{
+	const t_sdf_brick *b = (const t_sdf_brick *)field;
+	real_t lx = (p->x - b->origin.x) * b->inv_voxel;
+	real_t ly = (p->y - b->origin.y) * b->inv_voxel;
+	real_t lz = (p->z - b->origin.z) * b->inv_voxel;
+	lx = fmin(fmax(lx, 0), SDF_BRICK_CELLS);
+	ly = fmin(fmax(ly, 0), SDF_BRICK_CELLS);
+	lz = fmin(fmax(lz, 0), SDF_BRICK_CELLS);
+	int i = (int)lx;
+	int j = (int)ly;
+	int k = (int)lz;
+	if (i > SDF_BRICK_CELLS - 1)
+		i = SDF_BRICK_CELLS - 1;
+	if (j > SDF_BRICK_CELLS - 1)
+		j = SDF_BRICK_CELLS - 1;
+	if (k > SDF_BRICK_CELLS - 1)
+		k = SDF_BRICK_CELLS - 1;
+	real_t fx = lx - i;
+	real_t fy = ly - j;
+	real_t fz = lz - k;
+
+	const int8_t *s = b->samples + (k * SDF_BRICK_SAMPLES + j) * SDF_BRICK_SAMPLES + i;
+	const int sy = SDF_BRICK_SAMPLES;
+	const int sz = SDF_BRICK_SAMPLES * SDF_BRICK_SAMPLES;
+	real_t c00 = s[0] + fx * (s[1] - s[0]);
+	real_t c10 = s[sy] + fx * (s[sy + 1] - s[sy]);
+	real_t c01 = s[sz] + fx * (s[sz + 1] - s[sz]);
+	real_t c11 = s[sz + sy] + fx * (s[sz + sy + 1] - s[sz + sy]);
+	real_t c0 = c00 + fy * (c10 - c00);
+	real_t c1 = c01 + fy * (c11 - c01);
+	return (c0 + fz * (c1 - c0)) * b->dequant;
+}
+
+/* Bake graph root into bricks of SDF_BRICK_CELLS voxels of size `voxel`.
+   Bricks whose centre is farther than the brick radius plus the band from
+   the surface are skipped without sampling. */
+static inline bool sdf_bricks_bake(t_sdf_bricks *out, const t_sdf_graph *g, real_t voxel, t_material *mat)
+{
+	if (!out || !sdf_valid(g, g->root) || voxel <= 0)
+		return false;
+	sdf_bricks_clear(out);
+	const t_sdf_node *root = &g->nodes[g->root];
+	real_t lipschitz = (root->lipschitz > 1) ? root->lipschitz : 1;
+	real_t band = (real_t)2.0 * voxel * lipschitz;
+	real_t brick_len = voxel * SDF_BRICK_CELLS;
+	real_t brick_radius = (real_t)0.5 * brick_len * (real_t)sqrt(3.0);
+	t_aabb area = sdf_box_pad(&root->bbox, voxel);
+	int nx = (int)ceil(interval_size(&area.x) / brick_len);
+	int ny = (int)ceil(interval_size(&area.y) / brick_len);
+	int nz = (int)ceil(interval_size(&area.z) / brick_len);
+	out->voxel = voxel;
+	out->band = band;
+
+	int8_t samples[SDF_BRICK_SIZE];
+	for (int bz = 0; bz < nz; ++bz)
+		for (int by = 0; by < ny; ++by)
+			for (int bx = 0; bx < nx; ++bx)
+			{
+				t_point3 origin = point3_create(area.x.min + bx * brick_len,
+												area.y.min + by * brick_len,
+												area.z.min + bz * brick_len);
+				t_vec3 centre = vec3_create(origin.x + (real_t)0.5 * brick_len,
+											origin.y + (real_t)0.5 * brick_len,
+											origin.z + (real_t)0.5 * brick_len);
+				if (fabs(sdf_eval_node(g, g->root, &centre)) > lipschitz * brick_radius + band)
+					continue;
+
+				bool has_pos = false;
+				bool has_neg = false;
+				for (int k = 0; k < SDF_BRICK_SAMPLES; ++k)
+					for (int j = 0; j < SDF_BRICK_SAMPLES; ++j)
+						for (int i = 0; i < SDF_BRICK_SAMPLES; ++i)
+						{
+							t_vec3 p = vec3_create(origin.x + i * voxel, origin.y + j * voxel,
+												   origin.z + k * voxel);
+							real_t d = sdf_eval_node(g, g->root, &p) / band;
+							d = fmin(fmax(d, -1), 1);
+							int8_t q = (int8_t)lrint(d * 127.0);
+							samples[(k * SDF_BRICK_SAMPLES + j) * SDF_BRICK_SAMPLES + i] = q;
+							has_pos = has_pos || q > 0;
+							has_neg = has_neg || q <= 0;
+						}
+				/* No zero crossing: the interpolated field never reaches the surface */
+				if (!has_pos || !has_neg)
+					continue;
+
+				if (out->count >= out->capacity)
+				{
+					size_t newcap = (out->capacity == 0) ? 64 : out->capacity * 2;
+					int8_t *pool = (int8_t *)realloc(out->pool, newcap * SDF_BRICK_SIZE);
+					if (!pool)
+						return false;
+					out->pool = pool;
+					t_sdf_brick *arr = (t_sdf_brick *)realloc(out->bricks, newcap * sizeof(t_sdf_brick));
+					if (!arr)
+						return false;
+					out->bricks = arr;
+					out->capacity = newcap;
+				}
+				memcpy(out->pool + out->count * SDF_BRICK_SIZE, samples, SDF_BRICK_SIZE);
+				t_sdf_brick *b = &out->bricks[out->count++];
+				t_point3 far = point3_create(origin.x + brick_len, origin.y + brick_len,
+											 origin.z + brick_len);
+				b->samples = NULL;
+				b->origin = origin;
+				b->voxel = voxel;
+				b->inv_voxel = (real_t)1.0 / voxel;
+				b->dequant = band / (real_t)127.0;
+				b->lipschitz = lipschitz * (real_t)SDF_BRICK_LIPSCHITZ;
+				b->mat = mat;
+				b->bbox = aabb_from_points(&origin, &far);
+				out->bbox = aabb_merge(&out->bbox, &b->bbox);
+			}
+
+	/* The pool may have moved while growing: resolve sample pointers last */
+	for (size_t n = 0; n < out->count; ++n)
+		out->bricks[n].samples = out->pool + n * SDF_BRICK_SIZE;
+	return true;
+}
+
+static inline bool sdf_brick_hit(const t_sdf_brick *b, const t_ray *r,
+								 t_interval rayt, t_hit_record *rec)
+{
+	if (!b || !r || !rec)
+		return false;
+	RT_STAT_PRIM(STAT_PRIM_SDF);
+
+	t_interval span = rayt;
+	if (!aabb_hit(&b->bbox, r, &span))
+		return false;
+	real_t eps = b->voxel * (real_t)0.02;
+	real_t t;
+	if (!sdf_sphere_trace(sdf_brick_eval, b, b->lipschitz, eps, r, span.min, span.max, &t))
+		return false;
+	if (!contains(rayt.min, rayt.max, t))
+		return false;
+	sdf_fill_record(sdf_brick_eval, b, b->voxel * (real_t)0.5, r, t, b->mat, rec);
+	return true;
+}
+
+static __thread const t_sdf_brick *g_current_sdf_brick = NULL;
+
+static inline void set_current_sdf_brick(const void *obj)
+{
+	g_current_sdf_brick = (const t_sdf_brick *)obj;
+}
+
+static inline bool sdf_brick_hit_noobj(const t_ray *r, t_interval rayt, t_hit_record *rec)
+{
+	if (!g_current_sdf_brick)
+		return false;
+	return sdf_brick_hit(g_current_sdf_brick, r, rayt, rec);
+}
+
+/* Add every brick as its own (non-owned) leaf; `bricks` must outlive the list */
+static inline bool hittable_list_add_sdf_bricks(t_hittable_list *list, const t_sdf_bricks *bricks)
+{
+	if (!list || !bricks)
+		return false;
+	for (size_t n = 0; n < bricks->count; ++n)
+		if (!hittable_list_add_nonowned(list, (void *)&bricks->bricks[n], set_current_sdf_brick,
+										sdf_brick_hit_noobj, &bricks->bricks[n].bbox))
+			return false;
+	return true;
+}
+
+#endif
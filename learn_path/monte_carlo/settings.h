@@ -18,7 +18,7 @@
  */
 #define IMAGE_WIDTH 256
 #define IMAGE_HEIGHT 256
-#undef FLOAT_TYPE
+/* real_t is double unless FLOAT_TYPE is defined (make FLOAT=1) */
 
 /* Constant */
 #define X 0
@@ -0,0 +1,278 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   simd.h                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/08 09:31:17 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/08 09:31:17 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <math.h>
+#include "types.h"
+#include "vector.h"
+
+/* Four-lane vector math for hot kernels. A t_simd holds (x, y, z, w) in one
+   register: __m256d for doubles with AVX2, __m128 for floats with SSE4.1,
+   four plain reals otherwise (define RT_NO_SIMD to force the fallback).
+   Three-component operations ignore lane w. t_vec4 is the matching aligned
+   storage for data that is loaded often (e.g. triangle edges); loads do not
+   assume the alignment, since malloc only guarantees 16 bytes. */
+
+#if !defined(RT_NO_SIMD) && !defined(FLOAT_TYPE) && defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX_DOUBLE 1
+#define SIMD_ALIGN 32
+typedef __m256d t_simd;
+#elif !defined(RT_NO_SIMD) && defined(FLOAT_TYPE) && defined(__SSE4_1__)
+#include <immintrin.h>
+#define SIMD_SSE_FLOAT 1
+#define SIMD_ALIGN 16
+typedef __m128 t_simd;
+#else
+#define SIMD_SCALAR 1
+#define SIMD_ALIGN (4 * (int)sizeof(real_t))
+typedef struct s_simd
+{
+	real_t v[4];
+} t_simd;
+#endif
+
+/* GNU attribute rather than C11 _Alignas: the tree builds as C99 */
+typedef struct s_vec4
+{
+	real_t x;
+	real_t y;
+	real_t z;
+	real_t w;
+} __attribute__((aligned(SIMD_ALIGN))) t_vec4;
+
+/* ============================================================================ */
+/*                              LOAD AND STORE                                  */
+/* ============================================================================ */
+
+static inline t_simd simd_set(real_t x, real_t y, real_t z, real_t w)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_set_pd(w, z, y, x);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_set_ps(w, z, y, x);
+#else
+	return (t_simd){{x, y, z, w}};
+#endif
+}
+
+static inline t_simd simd_splat(real_t s)
+{
+	return simd_set(s, s, s, s);
+}
+
+/* (v.x, v.y, v.z, 0) */
+static inline t_simd simd_load3(const t_vec3 *v)
+{
+	return simd_set(v->x, v->y, v->z, (real_t)0.0);
+}
+
+static inline t_simd simd_load4(const t_vec4 *v)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_loadu_pd(&v->x);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_loadu_ps(&v->x);
+#else
+	return simd_set(v->x, v->y, v->z, v->w);
+#endif
+}
+
+static inline void simd_store4(t_vec4 *out, t_simd a)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	_mm256_store_pd(&out->x, a);
+#elif defined(SIMD_SSE_FLOAT)
+	_mm_store_ps(&out->x, a);
+#else
+	*out = (t_vec4){a.v[0], a.v[1], a.v[2], a.v[3]};
+#endif
+}
+
+static inline t_vec3 simd_store3(t_simd a)
+{
+	t_vec4 tmp;
+	simd_store4(&tmp, a);
+	return vec3_create(tmp.x, tmp.y, tmp.z);
+}
+
+static inline t_vec4 vec4_from_vec3(const t_vec3 *v)
+{
+	return (t_vec4){v->x, v->y, v->z, (real_t)0.0};
+}
+
+/* Lane x */
+static inline real_t simd_x(t_simd a)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_cvtsd_f64(a);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_cvtss_f32(a);
+#else
+	return a.v[0];
+#endif
+}
+
+/* ============================================================================ */
+/*                               ARITHMETIC                                     */
+/* ============================================================================ */
+
+#if defined(SIMD_SCALAR)
+#define SIMD_LANEWISE(a, b, op) \
+	simd_set((a).v[0] op(b).v[0], (a).v[1] op(b).v[1], (a).v[2] op(b).v[2], (a).v[3] op(b).v[3])
+#endif
+
+static inline t_simd simd_add(t_simd a, t_simd b)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_add_pd(a, b);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_add_ps(a, b);
+#else
+	return SIMD_LANEWISE(a, b, +);
+#endif
+}
+
+static inline t_simd simd_sub(t_simd a, t_simd b)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_sub_pd(a, b);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_sub_ps(a, b);
+#else
+	return SIMD_LANEWISE(a, b, -);
+#endif
+}
+
+static inline t_simd simd_mul(t_simd a, t_simd b)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_mul_pd(a, b);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_mul_ps(a, b);
+#else
+	return SIMD_LANEWISE(a, b, *);
+#endif
+}
+
+/* 1 / a per lane */
+static inline t_simd simd_rcp(t_simd a)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_div_pd(_mm256_set1_pd(1.0), a);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_div_ps(_mm_set1_ps(1.0f), a);
+#else
+	return simd_set((real_t)1.0 / a.v[0], (real_t)1.0 / a.v[1], (real_t)1.0 / a.v[2], (real_t)1.0 / a.v[3]);
+#endif
+}
+
+static inline t_simd simd_scale(t_simd a, real_t s)
+{
+	return simd_mul(a, simd_splat(s));
+}
+
+/* a * b + c */
+static inline t_simd simd_madd(t_simd a, t_simd b, t_simd c)
+{
+#if defined(SIMD_AVX_DOUBLE) && defined(__FMA__)
+	return _mm256_fmadd_pd(a, b, c);
+#elif defined(SIMD_SSE_FLOAT) && defined(__FMA__)
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return simd_add(simd_mul(a, b), c);
+#endif
+}
+
+static inline t_simd simd_min(t_simd a, t_simd b)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_min_pd(a, b);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_min_ps(a, b);
+#else
+	return simd_set(fmin(a.v[0], b.v[0]), fmin(a.v[1], b.v[1]), fmin(a.v[2], b.v[2]), fmin(a.v[3], b.v[3]));
+#endif
+}
+
+static inline t_simd simd_max(t_simd a, t_simd b)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_max_pd(a, b);
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_max_ps(a, b);
+#else
+	return simd_set(fmax(a.v[0], b.v[0]), fmax(a.v[1], b.v[1]), fmax(a.v[2], b.v[2]), fmax(a.v[3], b.v[3]));
+#endif
+}
+
+/* (a.y, a.z, a.x, a.w) */
+static inline t_simd simd_yzx(t_simd a)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	return _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1));
+#elif defined(SIMD_SSE_FLOAT)
+	return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+#else
+	return simd_set(a.v[1], a.v[2], a.v[0], a.v[3]);
+#endif
+}
+
+/* x + y + z of a */
+static inline real_t simd_hsum3(t_simd a)
+{
+#if defined(SIMD_AVX_DOUBLE)
+	__m128d xy = _mm256_castpd256_pd128(a);
+	__m128d zw = _mm256_extractf128_pd(a, 1);
+	__m128d s = _mm_add_sd(xy, zw);
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(xy, xy)));
+#elif defined(SIMD_SSE_FLOAT)
+	__m128 y = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_movehl_ps(a, a);
+	return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(a, y), z));
+#else
+	return a.v[0] + a.v[1] + a.v[2];
+#endif
+}
+
+/* max and min over x, y, z */
+static inline real_t simd_hmax3(t_simd a)
+{
+	t_vec4 t;
+	simd_store4(&t, a);
+	real_t m = (t.x > t.y) ? t.x : t.y;
+	return (m > t.z) ? m : t.z;
+}
+
+static inline real_t simd_hmin3(t_simd a)
+{
+	t_vec4 t;
+	simd_store4(&t, a);
+	real_t m = (t.x < t.y) ? t.x : t.y;
+	return (m < t.z) ? m : t.z;
+}
+
+static inline real_t simd_dot3(t_simd a, t_simd b)
+{
+	return simd_hsum3(simd_mul(a, b));
+}
+
+/* a x b, lane w = 0 when both w are 0 */
+static inline t_simd simd_cross3(t_simd a, t_simd b)
+{
+	t_simd c = simd_sub(simd_mul(a, simd_yzx(b)), simd_mul(simd_yzx(a), b));
+	return simd_yzx(c);
+}
+
+#endif
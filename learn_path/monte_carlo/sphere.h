@@ -50,6 +50,15 @@ static inline t_vec3 sphere_center_at(const t_sphere *s, real_t time)
 	return vec3_add(&s->center.center1, &scaled);
 }
 
+/* Bounding box of the sphere at a given time */
+static inline t_aabb sphere_box_at(const t_sphere *s, real_t time)
+{
+	t_vec3 c = sphere_center_at(s, time);
+	t_point3 lo = point3_create(c.x - s->radius, c.y - s->radius, c.z - s->radius);
+	t_point3 hi = point3_create(c.x + s->radius, c.y + s->radius, c.z + s->radius);
+	return aabb_from_points(&lo, &hi);
+}
+
 /* Get UV coordinates for a point on a unit sphere centered at origin.
    p: a point on the sphere (assumed normalized or at least on the sphere surface).
    u: returned value [0,1] of angle around Y axis from X=-1.
@@ -162,6 +171,7 @@ static inline bool sphere_hit_noobj(const t_ray *r, t_interval rayt, t_hit_recor
 	const t_sphere *s = g_current_sphere;
 	if (!s)
 		return false;
+	RT_STAT_PRIM(STAT_PRIM_SPHERE);
 
 	/* Get sphere center at ray time */
 	t_vec3 current_center = sphere_center_at(s, r->tm);
@@ -176,14 +186,21 @@ static inline bool sphere_hit_noobj(const t_ray *r, t_interval rayt, t_hit_recor
 	real_t sqrtd = sqrt(discriminant);
 	/* try the nearer root first; if it is outside the interval try the farther */
 	real_t root = (-half_b - sqrtd) / (real_t)a;
+	bool far_root = false;
 	if (!contains(rayt.min, rayt.max, root))
 	{
 		root = (-half_b + sqrtd) / (real_t)a;
+		far_root = true;
 		if (!contains(rayt.min, rayt.max, root))
 			return false;
 	}
 	rec->t = (real_t)root;
 	rec->p = ray_at((t_ray *)r, rec->t);
+#ifdef RT_REFINE_HITS
+	ray_refine_sphere_hit(r, &current_center, (double)s->radius, far_root, &rec->t, &rec->p);
+#else
+	(void)far_root;
+#endif
 	t_vec3 tmp = vec3_sub(&rec->p, &current_center);
 	t_vec3 outward_normal = unit_vector(&tmp);
 	set_face_normal(rec, r, &outward_normal);
@@ -197,4 +214,42 @@ static inline bool sphere_hit_noobj(const t_ray *r, t_interval rayt, t_hit_recor
 	return true;
 }
 
+/* Light sampling: solid-angle density of direction r->dir seen from r->orig
+   when directions are drawn by sphere_light_random, i.e. uniform over the
+   cone the sphere subtends (0 if the ray misses or starts inside) */
+static inline real_t sphere_light_pdf(const t_sphere *s, const t_ray *r)
+{
+	t_vec3 center = sphere_center_at(s, r->tm);
+	t_vec3 oc = vec3_sub(&center, &r->orig);
+	real_t dist_sq = vec3_length_squared(&oc);
+	real_t radius_sq = s->radius * s->radius;
+	if (dist_sq <= radius_sq)
+		return (real_t)0.0;
+	real_t len = vec3_length(&r->dir);
+	real_t along = dot(&oc, &r->dir) / len;
+	if (along <= (real_t)0.0 || dist_sq - along * along > radius_sq)
+		return (real_t)0.0;
+	real_t cos_theta_max = (real_t)sqrt((double)((real_t)1.0 - radius_sq / dist_sq));
+	return (real_t)1.0 / ((real_t)(2.0 * PI) * ((real_t)1.0 - cos_theta_max));
+}
+
+/* Light sampling: unit direction from origin into the cone the sphere
+   subtends at ray time `time` */
+static inline t_vec3 sphere_light_random(const t_sphere *s, const t_point3 *origin, real_t time)
+{
+	t_vec3 center = sphere_center_at(s, time);
+	t_vec3 oc = vec3_sub(&center, origin);
+	real_t dist_sq = vec3_length_squared(&oc);
+	real_t ratio = s->radius * s->radius / dist_sq;
+	if (ratio > (real_t)1.0)
+		ratio = (real_t)1.0;
+	real_t r1 = random_real();
+	real_t r2 = random_real();
+	real_t z = (real_t)1.0 + r2 * ((real_t)sqrt((double)((real_t)1.0 - ratio)) - (real_t)1.0);
+	real_t phi = (real_t)(2.0 * PI) * r1;
+	real_t sin_theta = (real_t)sqrt((double)((real_t)1.0 - z * z));
+	return vec3_local_to_world(&oc, (real_t)cos((double)phi) * sin_theta,
+							   (real_t)sin((double)phi) * sin_theta, z);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+/* ============================================================================ */
+/*                           TRAVERSAL STATISTICS                               */
+/* ============================================================================ */
+
+#include "stats.h"
+
+#ifdef RT_STATS
+__thread t_ray_stats g_rt_stats;
+t_object_cost *g_rt_objects = NULL;
+uint32_t g_rt_object_count = 0;
+__thread uint64_t g_rt_charged;
+#else
+/* Keep the translation unit non-empty when statistics are compiled out */
+typedef int t_stats_unused;
+#endif
@@ -0,0 +1,401 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   stats.h                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/05 10:12:03 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/05 10:12:03 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef STATS_H
+#define STATS_H
+
+/* Traversal statistics, compiled out unless RT_STATS is defined
+   (make STATS=1). Counters are thread-local; camera_render snapshots them
+   around every pixel to build a cost heatmap and folds them per thread.
+   Work (BVH nodes + primitive tests) is also charged to the scene object
+   it was done in, by object id: each object gets what its own hit call
+   cost minus what objects nested inside it were charged, so a mesh's BVH
+   traversal and its triangles are told apart. */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Primitive kinds counted separately */
+typedef enum e_stat_prim
+{
+	STAT_PRIM_SPHERE,
+	STAT_PRIM_QUAD,
+	STAT_PRIM_TRIANGLE,
+	STAT_PRIM_CYLINDER,
+	STAT_PRIM_CONE,
+	STAT_PRIM_MEDIUM,
+	STAT_PRIM_SDF,
+	STAT_PRIM_COUNT
+} t_stat_prim;
+
+static const char *const g_stat_prim_names[STAT_PRIM_COUNT] = {
+	"sphere", "quad", "triangle", "cylinder", "cone", "medium", "sdf"};
+
+typedef struct s_ray_stats
+{
+	uint64_t camera_rays;			  /* primary rays */
+	uint64_t segments;				  /* every traced ray (path length sum) */
+	uint64_t hits;					  /* segments that hit something */
+	uint64_t shadow_rays;			  /* occlusion queries toward lights */
+	uint64_t nodes;					  /* BVH nodes visited */
+	uint64_t prims[STAT_PRIM_COUNT]; /* primitive intersection tests */
+} t_ray_stats;
+
+/* Cost charged to one scene object */
+typedef struct s_object_cost
+{
+	uint64_t tests; /* hit calls on it */
+	uint64_t work;	/* nodes + primitive tests done in those calls, nested objects excluded */
+} t_object_cost;
+
+#define STATS_TOP_OBJECTS 10 /* costliest objects listed in the summary */
+
+#ifdef RT_STATS
+
+/* One set of counters per thread, shared by every translation unit (stats.c) */
+extern __thread t_ray_stats g_rt_stats;
+
+#define RT_STAT_INC(field) (++g_rt_stats.field)
+#define RT_STAT_ADD(field, n) (g_rt_stats.field += (uint64_t)(n))
+#define RT_STAT_PRIM(kind) (++g_rt_stats.prims[(kind)])
+#define RT_STAT_PRIM_N(kind, n) (g_rt_stats.prims[(kind)] += (uint64_t)(n))
+
+/* Per-object table of the render in progress, indexed by object id (NULL =
+   off), and the work this thread has charged to objects so far */
+extern t_object_cost *g_rt_objects;
+extern uint32_t g_rt_object_count;
+extern __thread uint64_t g_rt_charged;
+
+/* Work counter and charged total when a hit call starts */
+typedef struct s_stat_mark
+{
+	uint64_t work;
+	uint64_t charged;
+} t_stat_mark;
+
+static inline uint64_t stats_work(void)
+{
+	uint64_t n = g_rt_stats.nodes;
+	for (int k = 0; k < STAT_PRIM_COUNT; ++k)
+		n += g_rt_stats.prims[k];
+	return n;
+}
+
+/* Charge the work since mark to object id, minus what nested objects took.
+   Id 0 (BVH nodes, unregistered wrappers) claims nothing: its work goes to
+   the enclosing object. */
+static inline void stats_object_end(const t_stat_mark *mark, uint32_t id)
+{
+	if (!g_rt_objects || id == 0 || id >= g_rt_object_count)
+		return;
+	uint64_t done = stats_work() - mark->work;
+	uint64_t nested = g_rt_charged - mark->charged;
+	g_rt_charged = mark->charged + done;
+#pragma omp atomic
+	g_rt_objects[id].tests += 1;
+#pragma omp atomic
+	g_rt_objects[id].work += done - nested;
+}
+
+#define RT_STAT_OBJECT_BEGIN(mark) t_stat_mark mark = {stats_work(), g_rt_charged}
+#define RT_STAT_OBJECT_END(mark, id) stats_object_end(&(mark), (id))
+
+#else
+
+#define RT_STAT_INC(field) ((void)0)
+#define RT_STAT_ADD(field, n) ((void)0)
+#define RT_STAT_PRIM(kind) ((void)0)
+#define RT_STAT_PRIM_N(kind, n) ((void)0)
+#define RT_STAT_OBJECT_BEGIN(mark) ((void)0)
+#define RT_STAT_OBJECT_END(mark, id) ((void)0)
+
+#endif
+
+/* Wall-clock seconds (clock() would sum CPU time over all threads) */
+static inline double stats_wall_time(void)
+{
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double)clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+static inline uint64_t stats_prim_total(const t_ray_stats *s)
+{
+	uint64_t n = 0;
+	for (int k = 0; k < STAT_PRIM_COUNT; ++k)
+		n += s->prims[k];
+	return n;
+}
+
+static inline void stats_accumulate(t_ray_stats *dst, const t_ray_stats *src)
+{
+	dst->camera_rays += src->camera_rays;
+	dst->segments += src->segments;
+	dst->hits += src->hits;
+	dst->shadow_rays += src->shadow_rays;
+	dst->nodes += src->nodes;
+	for (int k = 0; k < STAT_PRIM_COUNT; ++k)
+		dst->prims[k] += src->prims[k];
+}
+
+/* Difference between two snapshots of the same thread's counters */
+static inline t_ray_stats stats_delta(const t_ray_stats *after, const t_ray_stats *before)
+{
+	t_ray_stats d;
+	d.camera_rays = after->camera_rays - before->camera_rays;
+	d.segments = after->segments - before->segments;
+	d.hits = after->hits - before->hits;
+	d.shadow_rays = after->shadow_rays - before->shadow_rays;
+	d.nodes = after->nodes - before->nodes;
+	for (int k = 0; k < STAT_PRIM_COUNT; ++k)
+		d.prims[k] = after->prims[k] - before->prims[k];
+	return d;
+}
+
+/* Render-wide collection: one cost value per pixel, one total per thread */
+typedef struct s_render_stats
+{
+	int width;
+	int height;
+	float *pixel_cost; /* nodes + primitive tests per pixel */
+	int thread_count;
+	t_ray_stats *per_thread;
+	uint32_t object_count; /* object ids 1 .. object_count - 1 */
+	t_object_cost *objects;
+	double seconds;
+} t_render_stats;
+
+#ifdef RT_STATS
+
+/* objects: ids handed out so far (g_object_count) */
+static inline bool render_stats_init(t_render_stats *rs, int width, int height, uint32_t objects)
+{
+	memset(rs, 0, sizeof(*rs));
+	rs->width = width;
+	rs->height = height;
+#ifdef _OPENMP
+	rs->thread_count = omp_get_max_threads();
+#else
+	rs->thread_count = 1;
+#endif
+	rs->pixel_cost = (float *)calloc((size_t)width * (size_t)height, sizeof(float));
+	rs->per_thread = (t_ray_stats *)calloc((size_t)rs->thread_count, sizeof(t_ray_stats));
+	rs->object_count = objects + 1;
+	rs->objects = (t_object_cost *)calloc((size_t)rs->object_count, sizeof(t_object_cost));
+	if (!rs->pixel_cost || !rs->per_thread || !rs->objects)
+	{
+		free(rs->pixel_cost);
+		free(rs->per_thread);
+		free(rs->objects);
+		memset(rs, 0, sizeof(*rs));
+		return false;
+	}
+	g_rt_objects = rs->objects;
+	g_rt_object_count = rs->object_count;
+	return true;
+}
+
+static inline void render_stats_destroy(t_render_stats *rs)
+{
+	if (g_rt_objects == rs->objects)
+	{
+		g_rt_objects = NULL;
+		g_rt_object_count = 0;
+	}
+	free(rs->pixel_cost);
+	free(rs->per_thread);
+	free(rs->objects);
+	rs->pixel_cost = NULL;
+	rs->per_thread = NULL;
+	rs->objects = NULL;
+}
+
+/* Snapshot taken before shading a pixel */
+static inline t_ray_stats render_stats_pixel_begin(void)
+{
+	return g_rt_stats;
+}
+
+/* Charge everything done since `before` to pixel (i, j) and the calling thread */
+static inline void render_stats_pixel_end(t_render_stats *rs, int i, int j, const t_ray_stats *before)
+{
+	if (!rs->pixel_cost)
+		return;
+	t_ray_stats d = stats_delta(&g_rt_stats, before);
+	rs->pixel_cost[(size_t)j * (size_t)rs->width + (size_t)i] += (float)(d.nodes + stats_prim_total(&d));
+#ifdef _OPENMP
+	int tid = omp_get_thread_num();
+#else
+	int tid = 0;
+#endif
+	if (tid < rs->thread_count)
+		stats_accumulate(&rs->per_thread[tid], &d);
+}
+
+#else
+
+static inline bool render_stats_init(t_render_stats *rs, int width, int height, uint32_t objects)
+{
+	(void)width;
+	(void)height;
+	(void)objects;
+	memset(rs, 0, sizeof(*rs));
+	return false;
+}
+static inline void render_stats_destroy(t_render_stats *rs) { (void)rs; }
+static inline t_ray_stats render_stats_pixel_begin(void) { return (t_ray_stats){0}; }
+static inline void render_stats_pixel_end(t_render_stats *rs, int i, int j, const t_ray_stats *before)
+{
+	(void)rs;
+	(void)i;
+	(void)j;
+	(void)before;
+}
+
+#endif
+
+/* Black -> blue -> magenta -> orange -> white ramp for x in [0, 1] */
+static inline void stats_heat_color(float x, unsigned char *rgb)
+{
+	static const float ramp[5][3] = {
+		{0.0f, 0.0f, 0.0f},
+		{0.1f, 0.1f, 0.8f},
+		{0.8f, 0.1f, 0.6f},
+		{1.0f, 0.6f, 0.0f},
+		{1.0f, 1.0f, 1.0f}};
+	if (!(x > 0.0f))
+		x = 0.0f;
+	if (x > 1.0f)
+		x = 1.0f;
+	float f = x * 4.0f;
+	int k = (int)f;
+	if (k > 3)
+		k = 3;
+	f -= (float)k;
+	for (int c = 0; c < 3; ++c)
+		rgb[c] = (unsigned char)(255.0f * (ramp[k][c] + f * (ramp[k + 1][c] - ramp[k][c])));
+}
+
+/* Write the per-pixel cost as a binary PPM, log-scaled against the maximum */
+static inline bool render_stats_write_heatmap(const t_render_stats *rs, const char *filename)
+{
+	if (!rs->pixel_cost)
+		return false;
+	size_t n = (size_t)rs->width * (size_t)rs->height;
+	float max_cost = 0.0f;
+	for (size_t k = 0; k < n; ++k)
+		if (rs->pixel_cost[k] > max_cost)
+			max_cost = rs->pixel_cost[k];
+	float inv_log_max = (max_cost > 0.0f) ? 1.0f / logf(1.0f + max_cost) : 0.0f;
+
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+		return false;
+	fprintf(f, "P6\n%d %d\n255\n", rs->width, rs->height);
+	unsigned char *row = (unsigned char *)malloc((size_t)rs->width * 3);
+	if (!row)
+	{
+		fclose(f);
+		return false;
+	}
+	for (int j = 0; j < rs->height; ++j)
+	{
+		for (int i = 0; i < rs->width; ++i)
+		{
+			float c = rs->pixel_cost[(size_t)j * (size_t)rs->width + (size_t)i];
+			stats_heat_color(logf(1.0f + c) * inv_log_max, &row[i * 3]);
+		}
+		fwrite(row, 1, (size_t)rs->width * 3, f);
+	}
+	free(row);
+	fclose(f);
+	return true;
+}
+
+/* The STATS_TOP_OBJECTS objects charged the most work, with their share */
+static inline void render_stats_print_objects(const t_render_stats *rs, const t_ray_stats *total)
+{
+	uint32_t top[STATS_TOP_OBJECTS];
+	int n = 0;
+	for (uint32_t id = 1; id < rs->object_count; ++id)
+	{
+		uint64_t work = rs->objects[id].work;
+		if (!work || (n == STATS_TOP_OBJECTS && rs->objects[top[n - 1]].work >= work))
+			continue;
+		/* insertion into the sorted list, dropping its last entry when full */
+		int k = (n < STATS_TOP_OBJECTS) ? n++ : n - 1;
+		while (k > 0 && rs->objects[top[k - 1]].work < work)
+		{
+			top[k] = top[k - 1];
+			--k;
+		}
+		top[k] = id;
+	}
+	if (n == 0)
+		return;
+	double all = (double)(total->nodes + stats_prim_total(total));
+	fprintf(stderr, "  costliest objects (id: hit calls, work, share of work):\n");
+	for (int k = 0; k < n; ++k)
+	{
+		const t_object_cost *c = &rs->objects[top[k]];
+		fprintf(stderr, "    object %-7u %12llu %14llu %6.1f%%\n", top[k], (unsigned long long)c->tests,
+				(unsigned long long)c->work, all > 0.0 ? 100.0 * (double)c->work / all : 0.0);
+	}
+}
+
+/* Print the summary table to stderr */
+static inline void render_stats_print(const t_render_stats *rs)
+{
+	if (!rs->per_thread)
+		return;
+	t_ray_stats total;
+	memset(&total, 0, sizeof(total));
+	for (int t = 0; t < rs->thread_count; ++t)
+		stats_accumulate(&total, &rs->per_thread[t]);
+
+	double seg = (total.segments > 0) ? (double)total.segments : 1.0;
+	double cam = (total.camera_rays > 0) ? (double)total.camera_rays : 1.0;
+	double secs = (rs->seconds > 0.0) ? rs->seconds : 1e-9;
+
+	fprintf(stderr, "\n---------------- render statistics ----------------\n");
+	fprintf(stderr, "  time                 %10.3f s\n", rs->seconds);
+	fprintf(stderr, "  camera rays          %10llu\n", (unsigned long long)total.camera_rays);
+	fprintf(stderr, "  rays traced          %10llu  (%.3f Mrays/s)\n",
+			(unsigned long long)total.segments, (double)total.segments / secs * 1e-6);
+	fprintf(stderr, "  shadow rays          %10llu\n", (unsigned long long)total.shadow_rays);
+	fprintf(stderr, "  avg path length      %10.3f\n", (double)total.segments / cam);
+	fprintf(stderr, "  hit ratio            %10.3f\n", (double)total.hits / seg);
+	fprintf(stderr, "  avg nodes / ray      %10.3f\n", (double)total.nodes / seg);
+	fprintf(stderr, "  avg tests / ray      %10.3f\n", (double)stats_prim_total(&total) / seg);
+	for (int k = 0; k < STAT_PRIM_COUNT; ++k)
+		if (total.prims[k])
+			fprintf(stderr, "    %-18s %10.3f\n", g_stat_prim_names[k], (double)total.prims[k] / seg);
+	render_stats_print_objects(rs, &total);
+	fprintf(stderr, "  per thread (rays traced / nodes):\n");
+	for (int t = 0; t < rs->thread_count; ++t)
+		fprintf(stderr, "    thread %-3d %12llu %14llu\n", t,
+				(unsigned long long)rs->per_thread[t].segments,
+				(unsigned long long)rs->per_thread[t].nodes);
+	fprintf(stderr, "---------------------------------------------------\n");
+}
+
+#endif
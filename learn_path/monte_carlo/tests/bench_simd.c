@@ -0,0 +1,305 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_simd.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/08 10:02:44 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/08 10:02:44 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/* Scalar vs simd.h timings of the hot kernels: slab test, triangle, sphere,
+   camera ray generation and mirror reflection. Each pair computes the same
+   thing on the same random data (the hit counts must agree). The slab test
+   ships in its SIMD form (aabb_hit); the others stay scalar, which the
+   compiler already vectorizes better than a horizontal 4-lane version. */
+
+#include "../common.h"
+#include "../aabb.h"
+#include "../simd.h"
+#include <time.h>
+
+#define BENCH_N 2048
+
+typedef struct s_bench_tri
+{
+	t_vec3 v0;
+	t_vec3 e1;
+	t_vec3 e2;
+	t_vec4 v0_4;
+	t_vec4 e1_4;
+	t_vec4 e2_4;
+} t_bench_tri;
+
+typedef struct s_bench_sphere
+{
+	t_vec3 center;
+	real_t radius;
+} t_bench_sphere;
+
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_report(const char *kernel, double scalar, double simd, long calls, bool shipped_simd)
+{
+	printf("%-14s %8.2f ns %8.2f ns %7.2fx   %s\n", kernel, scalar / (double)calls * 1e9,
+		   simd / (double)calls * 1e9, scalar / simd, shipped_simd ? "simd" : "scalar");
+}
+
+/* Slab test as it was before simd.h: one axis at a time, early exits */
+static bool aabb_hit_scalar(const t_aabb *box, const t_ray *r, t_interval *ray_t)
+{
+	const t_interval *slab[3] = {&box->x, &box->y, &box->z};
+	const real_t orig[3] = {r->orig.x, r->orig.y, r->orig.z};
+	const real_t dir[3] = {r->dir.x, r->dir.y, r->dir.z};
+	for (int a = 0; a < 3; ++a)
+	{
+		real_t inv = (real_t)1.0 / dir[a];
+		real_t t0 = (slab[a]->min - orig[a]) * inv;
+		real_t t1 = (slab[a]->max - orig[a]) * inv;
+		if (t0 > t1)
+		{
+			real_t tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+		if (t0 > ray_t->min)
+			ray_t->min = t0;
+		if (t1 < ray_t->max)
+			ray_t->max = t1;
+		if (ray_t->max <= ray_t->min)
+			return false;
+	}
+	return true;
+}
+
+static bool tri_hit_scalar(const t_bench_tri *t, const t_ray *r, real_t *t_hit)
+{
+	t_vec3 h = cross(&r->dir, &t->e2);
+	real_t a = dot(&t->e1, &h);
+	if (fabs((double)a) < 1e-8)
+		return false;
+	real_t f = (real_t)1.0 / a;
+	t_vec3 s = vec3_sub(&r->orig, &t->v0);
+	real_t u = f * dot(&s, &h);
+	if (u < (real_t)0.0 || u > (real_t)1.0)
+		return false;
+	t_vec3 q = cross(&s, &t->e1);
+	real_t v = f * dot(&r->dir, &q);
+	if (v < (real_t)0.0 || u + v > (real_t)1.0)
+		return false;
+	*t_hit = f * dot(&t->e2, &q);
+	return *t_hit > (real_t)0.0;
+}
+
+static bool tri_hit_simd(const t_bench_tri *t, t_simd orig, t_simd dir, real_t *t_hit)
+{
+	t_simd e1 = simd_load4(&t->e1_4);
+	t_simd e2 = simd_load4(&t->e2_4);
+	t_simd h = simd_cross3(dir, e2);
+	real_t a = simd_dot3(e1, h);
+	if (fabs((double)a) < 1e-8)
+		return false;
+	real_t f = (real_t)1.0 / a;
+	t_simd s = simd_sub(orig, simd_load4(&t->v0_4));
+	real_t u = f * simd_dot3(s, h);
+	if (u < (real_t)0.0 || u > (real_t)1.0)
+		return false;
+	t_simd q = simd_cross3(s, e1);
+	real_t v = f * simd_dot3(dir, q);
+	if (v < (real_t)0.0 || u + v > (real_t)1.0)
+		return false;
+	*t_hit = f * simd_dot3(e2, q);
+	return *t_hit > (real_t)0.0;
+}
+
+static bool sphere_hit_scalar(const t_bench_sphere *s, const t_ray *r, real_t *t_hit)
+{
+	t_vec3 oc = vec3_sub(&r->orig, &s->center);
+	real_t a = vec3_length_squared(&r->dir);
+	real_t half_b = dot(&r->dir, &oc);
+	real_t c = vec3_length_squared(&oc) - s->radius * s->radius;
+	real_t disc = half_b * half_b - a * c;
+	if (disc < (real_t)0.0)
+		return false;
+	*t_hit = (-half_b - (real_t)sqrt((double)disc)) / a;
+	return *t_hit > (real_t)0.0;
+}
+
+static bool sphere_hit_simd(const t_bench_sphere *s, t_simd orig, t_simd dir, real_t a, real_t *t_hit)
+{
+	t_simd oc = simd_sub(orig, simd_load3(&s->center));
+	real_t half_b = simd_dot3(dir, oc);
+	real_t c = simd_dot3(oc, oc) - s->radius * s->radius;
+	real_t disc = half_b * half_b - a * c;
+	if (disc < (real_t)0.0)
+		return false;
+	*t_hit = (-half_b - (real_t)sqrt((double)disc)) / a;
+	return *t_hit > (real_t)0.0;
+}
+
+static t_vec3 bench_random_vec(real_t lo, real_t hi)
+{
+	return vec3_create(random_real_interval(lo, hi), random_real_interval(lo, hi), random_real_interval(lo, hi));
+}
+
+int main(void)
+{
+	static t_bench_tri tris[BENCH_N];
+	static t_bench_sphere spheres[BENCH_N];
+	static t_aabb boxes[BENCH_N];
+	static t_ray rays[BENCH_N];
+	long calls = (long)BENCH_N * BENCH_N;
+
+	for (int i = 0; i < BENCH_N; ++i)
+	{
+		t_vec3 a = bench_random_vec(-1.0, 1.0);
+		t_vec3 b = bench_random_vec(-1.0, 1.0);
+		t_vec3 c = bench_random_vec(-1.0, 1.0);
+		a.z += 3.0;
+		b.z += 3.0;
+		c.z += 3.0;
+		tris[i].v0 = a;
+		tris[i].e1 = vec3_sub(&b, &a);
+		tris[i].e2 = vec3_sub(&c, &a);
+		tris[i].v0_4 = vec4_from_vec3(&tris[i].v0);
+		tris[i].e1_4 = vec4_from_vec3(&tris[i].e1);
+		tris[i].e2_4 = vec4_from_vec3(&tris[i].e2);
+		spheres[i].center = vec3_add(&a, &(t_vec3){0.0, 0.0, 1.0});
+		spheres[i].radius = random_real_interval(0.1, 0.4);
+		t_vec3 size = bench_random_vec(0.1, 0.5);
+		t_vec3 hi = vec3_add(&a, &size);
+		boxes[i] = aabb_from_points(&a, &hi);
+		t_vec3 dir = bench_random_vec(-0.5, 0.5);
+		dir.z = 1.0;
+		rays[i] = ray_create(bench_random_vec(-0.5, 0.5), dir, 0.0);
+	}
+
+	printf("%-14s %11s %11s %8s   %s\n", "kernel", "scalar", "simd", "speedup", "in use");
+
+	/* Slab test */
+	long hits[2] = {0, 0};
+	double t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_interval span = interval(0.0, INFINITY);
+			hits[0] += aabb_hit_scalar(&boxes[i], &rays[k], &span);
+		}
+	double scalar = bench_now() - t;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_interval span = interval(0.0, INFINITY);
+			hits[1] += aabb_hit(&boxes[i], &rays[k], &span);
+		}
+	bench_report("aabb_hit", scalar, bench_now() - t, calls, true);
+	if (hits[0] != hits[1])
+		printf("  mismatch: %ld vs %ld hits\n", hits[0], hits[1]);
+
+	/* Triangle */
+	real_t t_hit;
+	hits[0] = 0;
+	hits[1] = 0;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+		for (int i = 0; i < BENCH_N; ++i)
+			hits[0] += tri_hit_scalar(&tris[i], &rays[k], &t_hit);
+	scalar = bench_now() - t;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+	{
+		t_simd orig = simd_load3(&rays[k].orig);
+		t_simd dir = simd_load3(&rays[k].dir);
+		for (int i = 0; i < BENCH_N; ++i)
+			hits[1] += tri_hit_simd(&tris[i], orig, dir, &t_hit);
+	}
+	bench_report("triangle_hit", scalar, bench_now() - t, calls, false);
+	if (hits[0] != hits[1])
+		printf("  mismatch: %ld vs %ld hits\n", hits[0], hits[1]);
+
+	/* Sphere */
+	hits[0] = 0;
+	hits[1] = 0;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+		for (int i = 0; i < BENCH_N; ++i)
+			hits[0] += sphere_hit_scalar(&spheres[i], &rays[k], &t_hit);
+	scalar = bench_now() - t;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+	{
+		t_simd orig = simd_load3(&rays[k].orig);
+		t_simd dir = simd_load3(&rays[k].dir);
+		real_t a = simd_dot3(dir, dir);
+		for (int i = 0; i < BENCH_N; ++i)
+			hits[1] += sphere_hit_simd(&spheres[i], orig, dir, a, &t_hit);
+	}
+	bench_report("sphere_hit", scalar, bench_now() - t, calls, false);
+	if (hits[0] != hits[1])
+		printf("  mismatch: %ld vs %ld hits\n", hits[0], hits[1]);
+
+	/* Camera ray generation: pixel00 + x * du + y * dv - center */
+	t_vec3 p00 = vec3_create(-1.0, 1.0, -1.0);
+	t_vec3 du = vec3_create(0.001, 0.0, 0.0002);
+	t_vec3 dv = vec3_create(0.0, -0.001, 0.0001);
+	t_vec3 center = vec3_zero();
+	double sums[2] = {0.0, 0.0};
+	t = bench_now();
+	for (int j = 0; j < BENCH_N; ++j)
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_vec3 tu = vec3_mul_scalar(&du, (real_t)i + (real_t)0.5);
+			t_vec3 tv = vec3_mul_scalar(&dv, (real_t)j + (real_t)0.5);
+			t_vec3 p = vec3_add(&p00, &tu);
+			p = vec3_add(&p, &tv);
+			t_vec3 d = vec3_sub(&p, &center);
+			sums[0] += (double)(d.x + d.y + d.z);
+		}
+	scalar = bench_now() - t;
+	t_simd p00_s = simd_load3(&p00);
+	t_simd du_s = simd_load3(&du);
+	t_simd dv_s = simd_load3(&dv);
+	t_simd center_s = simd_load3(&center);
+	t = bench_now();
+	for (int j = 0; j < BENCH_N; ++j)
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_simd p = simd_madd(du_s, simd_splat((real_t)i + (real_t)0.5), p00_s);
+			p = simd_madd(dv_s, simd_splat((real_t)j + (real_t)0.5), p);
+			t_vec3 d = simd_store3(simd_sub(p, center_s));
+			sums[1] += (double)(d.x + d.y + d.z);
+		}
+	bench_report("get_ray", scalar, bench_now() - t, calls, false);
+
+	/* Mirror reflection (metal scatter) */
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_vec3 r = vec3_reflect(&rays[k].dir, &tris[i].e1);
+			sums[0] += (double)r.x;
+		}
+	scalar = bench_now() - t;
+	t = bench_now();
+	for (int k = 0; k < BENCH_N; ++k)
+	{
+		t_simd v = simd_load3(&rays[k].dir);
+		for (int i = 0; i < BENCH_N; ++i)
+		{
+			t_simd n = simd_load4(&tris[i].e1_4);
+			t_vec3 r = simd_store3(simd_sub(v, simd_scale(n, (real_t)2.0 * simd_dot3(v, n))));
+			sums[1] += (double)r.x;
+		}
+	}
+	bench_report("vec3_reflect", scalar, bench_now() - t, calls, false);
+	printf("(checksums %.6g %.6g)\n", sums[0], sums[1]);
+	return 0;
+}
@@ -87,6 +87,11 @@ void cornell_box(void)
 		hittable_list_add_nonowned(&world, light_q_copy, set_current_quad, quad_hit_noobj, &light_q.bbox);
 	}
 
+	/* The ceiling light is also sampled directly at every diffuse bounce */
+	t_light_list lights;
+	light_list_init(&lights);
+	light_list_add_quad(&lights, &light_q);
+
 	/* Box 1: tall box (165x330x165) rotated 15° and translated to (265,0,295) */
 	t_point3 box1_a = point3_create(0.0, 0.0, 0.0);
 	t_point3 box1_b = point3_create(165.0, 330.0, 165.0);
@@ -184,6 +189,7 @@ void cornell_box(void)
 	cam.focus_dist = vec3_length(&focus_vec);
 
 	camera_init(&cam, cam.aspect_ratio, cam.image_width);
+	cam.lights = &lights;
 	/* Render against accelerated BVH (fallback to flat list if BVH build failed) */
 	const t_hittable_list *render_world = world_bvh ? &accel : &world;
 	camera_render(&cam, stdout, render_world);
@@ -191,6 +197,7 @@ void cornell_box(void)
 	/* Cleanup */
 	hittable_list_clear(&accel); /* frees BVH if built */
 	hittable_list_clear(&world);
+	light_list_clear(&lights);
 	red->destroy(red);
 	free(red);
 	white->destroy(white);
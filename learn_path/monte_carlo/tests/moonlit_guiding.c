@@ -0,0 +1,160 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   moonlit_guiding.c                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/11 10:24:51 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/11 10:24:51 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/* Path guiding on the living room with its lamps off, lit by the
+   moonlight coming through the window glass (light next-event estimation
+   cannot reach) and seen facing the window. A long BSDF-only render with
+   its own seed is the reference. The scene is then rendered without and
+   with guiding at the same sample count, and for the same wall-clock
+   budget (training passes included); the per-pixel relative MSE of each
+   is printed. Guiding costs time per sample, so at equal time the two
+   are close here; exits 1 when guiding loses at equal samples. Images go
+   to ../output/moonlit_*.pfm. */
+
+#include "../house.h"
+#include "../envmap.h"
+
+#define MOONLIT_WIDTH 160
+#define MOONLIT_REFERENCE_SPP 4096
+#define MOONLIT_SPP 256
+#define MOONLIT_SECONDS 5.0
+#define MOONLIT_EPSILON 0.01 /* keeps black pixels out of the relative error */
+
+static void build_moonlit_house(t_hittable_list *world, t_light_list *lights)
+{
+	const real_t LIGHT_SCALE = 2.0;
+	t_material *floor_mat = lambertian_create(vec3_create(0.55, 0.45, 0.35));
+	t_material *wall_mat = lambertian_create(vec3_create(0.72, 0.68, 0.62));
+	t_material *accent_mat = lambertian_create(vec3_create(0.78, 0.50, 0.42));
+	t_material *sofa_main = lambertian_create(vec3_create(0.08, 0.42, 0.45));
+	t_material *sofa_accent = lambertian_create(vec3_create(0.06, 0.35, 0.38));
+	t_material *sofa_cushion = lambertian_create(vec3_create(0.10, 0.48, 0.50));
+	t_material *thick_glass = dielectric_create(1.55);
+	t_material *chrome = metal_create_fuzz(vec3_create(0.9, 0.9, 0.92), 0.02);
+	t_material *frame_mat = lambertian_create(vec3_create(0.15, 0.12, 0.10));
+	t_material *window_glass = dielectric_create(1.52);
+	t_material *rug_mat = lambertian_create(vec3_create(0.45, 0.25, 0.20));
+	t_material *pot_mat = lambertian_create(vec3_create(0.6, 0.35, 0.25));
+	t_material *star_mat = diffuse_light_create(vec3_create(40.0, 40.0, 50.0));
+	t_vec3 moon_color = vec3_create(10.0 * LIGHT_SCALE, 10.0 * LIGHT_SCALE, 9.0 * LIGHT_SCALE);
+	t_material *moon_mat = diffuse_light_create(moon_color);
+	t_vec3 moonlight_color = vec3_create(8.0 * LIGHT_SCALE, 9.0 * LIGHT_SCALE, 10.0 * LIGHT_SCALE);
+	t_material *moonlight = diffuse_light_create(moonlight_color);
+
+	build_floor(world, floor_mat);
+	build_walls(world, wall_mat, accent_mat);
+	t_point3 sofa_pos = point3_create(-20.0, 0.0, 180.0);
+	build_sofa(world, &sofa_pos, sofa_main, sofa_accent, sofa_cushion);
+	t_point3 table_pos = point3_create(-20.0, 0.0, 60.0);
+	build_glass_coffee_table(world, &table_pos, thick_glass, chrome);
+	t_point3 rug_center = point3_create(-20.0, 0.0, 70.0);
+	build_rug(world, &rug_center, 140.0, 100.0, rug_mat);
+	t_point3 plant_pos = point3_create(180.0, 0.0, 180.0);
+	build_plant_pot(world, &plant_pos, pot_mat);
+
+	t_point3 window_center = point3_create(248.0, 160.0, 80.0);
+	build_large_window(world, &window_center, 130.0, 170.0, frame_mat, window_glass);
+	build_moon_outside(world, &window_center, moon_mat);
+	build_stars(world, &window_center, 130.0, 170.0, star_mat, lights);
+	build_moonlight(world, &window_center, 130.0, 170.0, moonlight);
+}
+
+/* Timed when seconds > 0, else spp samples per pixel */
+static void render_moonlit(const t_hittable_list *world, const t_light_list *lights, const char *path,
+						   bool guiding, int spp, real_t seconds, uint64_t seed)
+{
+	t_camera cam;
+	cam.aspect_ratio = 16.0 / 9.0;
+	cam.image_width = MOONLIT_WIDTH;
+	cam.samples_per_pixel = spp;
+	cam.background = vec3_create(0.0, 0.0, 0.0);
+	cam.vfov = 70.0;
+	cam.lookfrom = point3_create(-200.0, 120.0, -150.0);
+	cam.lookat = point3_create(150.0, 70.0, 120.0);
+	cam.vup = vec3_create(0.0, 1.0, 0.0);
+	cam.defocus_angle = 0.0;
+	cam.focus_dist = 10.0;
+	camera_init(&cam, cam.aspect_ratio, cam.image_width);
+	cam.lights = lights;
+	cam.guiding = guiding;
+	cam.time_budget = seconds;
+	cam.seed = seed;
+	cam.checkpoint_path = NULL;
+	cam.output_path = path;
+	camera_render(&cam, stdout, world);
+}
+
+/* Mean over pixels of the squared error over the squared reference */
+static double relative_mse(const char *path, const t_envmap *ref)
+{
+	t_envmap img;
+	if (!envmap_load_pfm(&img, path))
+		return -1.0;
+	double sum = 0.0;
+	int n = (img.width == ref->width && img.height == ref->height) ? ref->width * ref->height : 0;
+	for (int k = 0; k < n; ++k)
+	{
+		double err = 0.0;
+		double mean = 0.0;
+		for (int c = 0; c < 3; ++c)
+		{
+			double d = (double)img.rgb[3 * k + c] - (double)ref->rgb[3 * k + c];
+			err += d * d;
+			mean += (double)ref->rgb[3 * k + c] / 3.0;
+		}
+		sum += err / ((mean + MOONLIT_EPSILON) * (mean + MOONLIT_EPSILON));
+	}
+	envmap_destroy(&img);
+	return (n > 0) ? sum / n : -1.0;
+}
+
+int main(void)
+{
+	t_hittable_list world;
+	hittable_list_init(&world);
+	t_light_list lights;
+	light_list_init(&lights);
+	build_moonlit_house(&world, &lights);
+	t_hittable_list accel;
+	const t_hittable_list *render_world = build_house_accel(&world, &accel);
+	light_list_build(&lights);
+
+	render_moonlit(render_world, &lights, "../output/moonlit_reference.pfm", false, MOONLIT_REFERENCE_SPP, 0.0, 3);
+	render_moonlit(render_world, &lights, "../output/moonlit_bsdf.pfm", false, MOONLIT_SPP, 0.0, 1);
+	render_moonlit(render_world, &lights, "../output/moonlit_guided.pfm", true, MOONLIT_SPP, 0.0, 2);
+	render_moonlit(render_world, &lights, "../output/moonlit_bsdf_timed.pfm", false, 1 << 20, MOONLIT_SECONDS, 1);
+	render_moonlit(render_world, &lights, "../output/moonlit_guided_timed.pfm", true, 1 << 20, MOONLIT_SECONDS, 2);
+
+	t_envmap ref;
+	bool ok = envmap_load_pfm(&ref, "../output/moonlit_reference.pfm");
+	double bsdf = ok ? relative_mse("../output/moonlit_bsdf.pfm", &ref) : -1.0;
+	double guided = ok ? relative_mse("../output/moonlit_guided.pfm", &ref) : -1.0;
+	double bsdf_timed = ok ? relative_mse("../output/moonlit_bsdf_timed.pfm", &ref) : -1.0;
+	double guided_timed = ok ? relative_mse("../output/moonlit_guided_timed.pfm", &ref) : -1.0;
+	if (ok)
+		envmap_destroy(&ref);
+	ok = bsdf > 0.0 && guided >= 0.0 && bsdf_timed > 0.0 && guided_timed >= 0.0;
+	if (ok)
+	{
+		printf("%d spp each: relMSE BSDF only %.4f, guided %.4f (%.2fx)\n", MOONLIT_SPP, bsdf, guided,
+			   bsdf / guided);
+		printf("%.0f s each: relMSE BSDF only %.4f, guided %.4f (%.2fx)\n", MOONLIT_SECONDS, bsdf_timed,
+			   guided_timed, bsdf_timed / guided_timed);
+	}
+	else
+		printf("cannot read the renders back from ../output\n");
+
+	hittable_list_clear(&accel);
+	hittable_list_clear(&world);
+	light_list_clear(&lights);
+	return (ok && guided < bsdf) ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/* ============================================================================ */
+/*                                                                              */
+/*  Outdoor Scene - Image-based lighting                                        */
+/*  Spheres on the ground under a sky map with a small, very bright sun         */
+/*                                                                              */
+/* ============================================================================ */
+
+#include "../common.h"
+#include "../bvh.h"
+#include "../envmap.h"
+
+#define SKY_WIDTH 512
+#define SKY_HEIGHT 256
+#define SKY_PATH "../output/sky.pfm"
+
+/* Equirectangular sky (envmap.h layout, top row first): a blue gradient
+   over a grey ground and a sun disc of about 2 degrees, thousands of
+   times brighter, that only light sampling finds reliably */
+static float *make_sky(void)
+{
+	float *rgb = (float *)malloc((size_t)SKY_WIDTH * SKY_HEIGHT * 3 * sizeof(float));
+	if (!rgb)
+		return NULL;
+	t_vec3 sun = vec3_create(0.4, 0.6, -0.69);
+	sun = unit_vector(&sun);
+	for (int j = 0; j < SKY_HEIGHT; ++j)
+		for (int i = 0; i < SKY_WIDTH; ++i)
+		{
+			double theta = PI * (j + 0.5) / SKY_HEIGHT;
+			double phi = 2.0 * PI * (i + 0.5) / SKY_WIDTH - PI;
+			t_vec3 dir = vec3_create(cos(phi) * sin(theta), cos(theta), -sin(phi) * sin(theta));
+			float *c = rgb + ((size_t)j * SKY_WIDTH + (size_t)i) * 3;
+			double up = (dir.y > 0.0) ? dir.y : 0.0;
+			c[0] = (float)(0.3 + 0.2 * up);
+			c[1] = (float)(0.4 + 0.3 * up);
+			c[2] = (float)(0.6 + 0.5 * up);
+			if (dir.y < 0.0)
+				c[0] = c[1] = c[2] = 0.1f;
+			if (dot(&dir, &sun) > 0.9995)
+			{
+				c[0] = 2000.0f;
+				c[1] = 1800.0f;
+				c[2] = 1500.0f;
+			}
+		}
+	return rgb;
+}
+
+/* Write the sky as a PFM and read it back through envmap_load */
+static bool load_sky(t_envmap *env)
+{
+	float *rgb = make_sky();
+	if (!rgb)
+		return false;
+	FILE *f = fopen(SKY_PATH, "wb");
+	bool ok = f != NULL;
+	if (ok)
+	{
+		fprintf(f, "PF\n%d %d\n-1.0\n", SKY_WIDTH, SKY_HEIGHT);
+		for (int j = SKY_HEIGHT - 1; j >= 0 && ok; --j)
+			ok = fwrite(rgb + (size_t)j * SKY_WIDTH * 3, sizeof(float), (size_t)SKY_WIDTH * 3, f)
+				 == (size_t)SKY_WIDTH * 3;
+		ok = (fclose(f) == 0) && ok;
+	}
+	ok = ok && envmap_load(env, SKY_PATH);
+	if (!ok)
+		ok = envmap_init(env, SKY_WIDTH, SKY_HEIGHT, rgb);
+	free(rgb);
+	return ok;
+}
+
+/* map: PFM or PNG to light the scene with, NULL for the built-in sky */
+void outdoor_envmap(const char *map)
+{
+	t_envmap env;
+	bool loaded = map ? envmap_load(&env, map) : load_sky(&env);
+	if (!loaded)
+	{
+		fprintf(stderr, "Cannot load the environment map %s\n", map ? map : SKY_PATH);
+		return;
+	}
+
+	t_hittable_list world;
+	hittable_list_init(&world);
+
+	t_material *ground = lambertian_create(vec3_create(0.5, 0.5, 0.5));
+	t_material *red = lambertian_create(vec3_create(0.7, 0.2, 0.2));
+	t_material *steel = metal_create_fuzz(vec3_create(0.8, 0.8, 0.8), 0.2);
+	t_material *glass = dielectric_create(1.5);
+
+	t_sphere ground_s = create_sphere(&(t_point3){0.0, -1000.0, 0.0}, 1000.0, vec3_create(1, 1, 1), ground);
+	hittable_list_add_sphere(&world, &ground_s);
+	t_sphere red_s = create_sphere(&(t_point3){0.0, 1.0, 0.0}, 1.0, vec3_create(1, 1, 1), red);
+	hittable_list_add_sphere(&world, &red_s);
+	t_sphere steel_s = create_sphere(&(t_point3){2.2, 0.7, 0.5}, 0.7, vec3_create(1, 1, 1), steel);
+	hittable_list_add_sphere(&world, &steel_s);
+	t_sphere glass_s = create_sphere(&(t_point3){-2.0, 0.6, 1.0}, 0.6, vec3_create(1, 1, 1), glass);
+	hittable_list_add_sphere(&world, &glass_s);
+
+	t_bvh_node *world_bvh = bvh_node_create(&world);
+	t_hittable_list accel;
+	hittable_list_init(&accel);
+	if (world_bvh)
+	{
+		t_hittable_wrapper bvh_wrap = {
+			.object = world_bvh,
+			.owned = true,
+			.set_current = set_current_bvh,
+			.hit_noobj = bvh_node_hit,
+			.bbox = world_bvh->bbox};
+		hittable_list_add_wrapper(&accel, &bvh_wrap);
+	}
+
+	t_camera cam;
+	cam.aspect_ratio = 3.0 / 2.0;
+	cam.image_width = 600;
+	cam.samples_per_pixel = 64;
+	cam.background = vec3_create(0.0, 0.0, 0.0);
+	cam.vfov = 40.0;
+	cam.lookfrom = point3_create(0.0, 2.0, 8.0);
+	cam.lookat = point3_create(0.0, 0.8, 0.0);
+	cam.vup = vec3_create(0.0, 1.0, 0.0);
+	cam.defocus_angle = 0.0;
+	cam.focus_dist = 8.0;
+
+	camera_init(&cam, cam.aspect_ratio, cam.image_width);
+	cam.max_depth = 8;
+	cam.environment = &env;
+	cam.output_path = "../output/outdoor_envmap.ppm";
+
+	const t_hittable_list *render_world = world_bvh ? &accel : &world;
+	camera_render(&cam, stdout, render_world);
+
+	hittable_list_clear(&accel);
+	hittable_list_clear(&world);
+	envmap_destroy(&env);
+}
+
+int main(int argc, char **argv)
+{
+	outdoor_envmap(argc > 1 ? argv[1] : NULL);
+	return 0;
+}
@@ -0,0 +1,87 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   rough_metal_nee.c                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/10 11:12:37 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/10 11:12:37 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/* Light sampling on rough reflectors: a floor under a registered quad light,
+   seen at a grazing angle, estimated with next-event estimation + MIS and
+   with BSDF sampling alone. Both must agree; rough metal and glossy absorb
+   the BSDF samples that fall below the surface, and the light sample taken
+   at the same bounce must not be lost with them. Exits 1 on a mismatch. */
+
+#include "../common.h"
+#include "../quad.h"
+
+#define NEE_TEST_PATHS 1000000
+#define NEE_TEST_TOLERANCE 0.03
+
+static void add_quad(t_hittable_list *world, t_point3 p, t_vec3 u, t_vec3 v, t_material *mat,
+					 t_light_list *lights)
+{
+	t_quad q = quad_create(&p, &u, &v, mat);
+	t_quad *copy = (t_quad *)malloc(sizeof(t_quad));
+	if (!copy)
+		return;
+	*copy = q;
+	hittable_list_add_nonowned(world, copy, set_current_quad, quad_hit_noobj, &q.bbox);
+	if (lights)
+		light_list_add_quad(lights, &q);
+}
+
+/* Mean radiance over rays from the eye to jittered points of the floor */
+static double floor_radiance(const t_hittable_list *world, const t_light_list *lights)
+{
+	const t_color black = vec3_zero();
+	const t_point3 eye = point3_create(0.0, 1.0, 4.0);
+	double sum = 0.0;
+	for (int s = 0; s < NEE_TEST_PATHS; ++s)
+	{
+		sampler_start(SAMPLER_RANDOM, 7, s % 64, s / 64, 0);
+		t_point3 target = point3_create(random_real_interval(-0.5, 0.5), 0.0, random_real_interval(-0.5, 0.5));
+		t_vec3 dir = vec3_sub(&target, &eye);
+		t_ray r = ray_create(eye, dir, 0.0);
+		t_color c = ray_color_path(&r, world, lights, NULL, 4, &black, -1, NULL, NULL);
+		sum += (double)(c.x + c.y + c.z) / 3.0;
+	}
+	return sum / NEE_TEST_PATHS;
+}
+
+static bool check_floor(const char *name, t_material *floor)
+{
+	t_hittable_list world;
+	hittable_list_init(&world);
+	t_light_list lights;
+	light_list_init(&lights);
+	t_material *lamp = diffuse_light_create(vec3_create(8.0, 8.0, 8.0));
+	add_quad(&world, point3_create(-5.0, 0.0, -5.0), vec3_create(10.0, 0.0, 0.0), vec3_create(0.0, 0.0, 10.0),
+			 floor, NULL);
+	add_quad(&world, point3_create(-0.5, 1.5, -1.5), vec3_create(1.0, 0.0, 0.0), vec3_create(0.0, 0.0, 1.0),
+			 lamp, &lights);
+
+	double bsdf = floor_radiance(&world, NULL);
+	double nee = floor_radiance(&world, &lights);
+	double ratio = (bsdf > 0.0) ? nee / bsdf : 0.0;
+	bool ok = fabs(ratio - 1.0) <= NEE_TEST_TOLERANCE;
+	printf("%-16s BSDF only %.5f  NEE+MIS %.5f  ratio %.3f  %s\n", name, bsdf, nee, ratio, ok ? "ok" : "MISMATCH");
+	light_list_clear(&lights);
+	hittable_list_clear(&world);
+	return ok;
+}
+
+int main(void)
+{
+	const t_color grey = vec3_create(0.8, 0.8, 0.8);
+	bool ok = true;
+	ok &= check_floor("lambertian", lambertian_create(grey));
+	ok &= check_floor("metal fuzz 0.5", metal_create_fuzz(grey, 0.5));
+	ok &= check_floor("metal fuzz 1.0", metal_create_fuzz(grey, 1.0));
+	ok &= check_floor("glossy 0.6", glossy_create(grey, 0.6, 0.0));
+	return ok ? 0 : 1;
+}
@@ -15,6 +15,8 @@ void scene_cylinder_triangle(void)
 {
 	t_hittable_list world;
 	hittable_list_init(&world);
+	t_light_list lights; /* small emitters, sampled through the light BVH */
+	light_list_init(&lights);
 
 	/* ===== LIGHT INTENSITY CONTROL ===== */
 	const real_t LIGHT_SCALE = 2.0;
@@ -105,7 +107,7 @@ void scene_cylinder_triangle(void)
 	build_large_window(&world, &window_center, 130.0, 170.0, frame_mat, window_glass);
 
 	build_moon_outside(&world, &window_center, moon_mat);
-	build_stars(&world, &window_center, 130.0, 170.0, star_mat);
+	build_stars(&world, &window_center, 130.0, 170.0, star_mat, &lights);
 	build_moonlight(&world, &window_center, 130.0, 170.0, moonlight);
 
 	/* Mirror with LED frame - positioned to align with wall cutout */
@@ -123,10 +125,10 @@ void scene_cylinder_triangle(void)
 	}
 
 	/* Add colored LEDs around the mirror - must match mirror dimensions */
-	build_mirror_leds(&world, &mirror_p, 180.0, 180.0, 8);
+	build_mirror_leds(&world, &mirror_p, 180.0, 180.0, 8, &lights);
 
 	t_point3 menhir_pos = point3_create(-200.0, 0.0, 200.0);
-	build_menhir_lamp(&world, &menhir_pos, 12.0, 100.0, 5);
+	build_menhir_lamp(&world, &menhir_pos, 12.0, 100.0, 5, &lights);
 
 	t_point3 plant_pos = point3_create(180.0, 0.0, 180.0);
 	build_plant_pot(&world, &plant_pos, pot_mat);
@@ -139,20 +141,9 @@ void scene_cylinder_triangle(void)
 							   metal_create_fuzz(vec3_create(0.85, 0.65, 0.15), 0.10),
 							   lambertian_create(vec3_create(0.12, 0.40, 0.55)));
 
-	/* Build BVH */
-	t_bvh_node *world_bvh = bvh_node_create(&world);
+	/* Group nearby cylinders into 4-wide leaves, then build BVH */
 	t_hittable_list accel;
-	hittable_list_init(&accel);
-	if (world_bvh)
-	{
-		t_hittable_wrapper bvh_wrap = {
-			.object = world_bvh,
-			.owned = true,
-			.set_current = set_current_bvh,
-			.hit_noobj = bvh_node_hit,
-			.bbox = world_bvh->bbox};
-		hittable_list_add_wrapper(&accel, &bvh_wrap);
-	}
+	const t_hittable_list *render_world = build_house_accel(&world, &accel);
 
 	/* ===== CAMERA ===== */
 	t_camera cam;
@@ -170,12 +161,14 @@ void scene_cylinder_triangle(void)
 	cam.focus_dist = vec3_length(&focus_vec);
 
 	camera_init(&cam, cam.aspect_ratio, cam.image_width);
+	light_list_build(&lights);
+	cam.lights = &lights;
 
-	const t_hittable_list *render_world = world_bvh ? &accel : &world;
 	camera_render(&cam, stdout, render_world);
 
 	hittable_list_clear(&accel);
 	hittable_list_clear(&world);
+	light_list_clear(&lights);
 }
 
 int main(void)
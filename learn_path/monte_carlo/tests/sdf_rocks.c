@@ -0,0 +1,130 @@
+/* ============================================================================ */
+/*                                                                              */
+/*  SDF Scene - Displaced rocks and a blobby sculpture                          */
+/*  Analytic SDF graphs next to the same sculpture baked into sparse bricks     */
+/*                                                                              */
+/* ============================================================================ */
+
+#include "../common.h"
+#include "../bvh.h"
+#include "../sdf.h"
+
+/* Noisy rounded box: a rock */
+static int add_rock(t_sdf_graph *g, t_point3 center, real_t size, real_t roughness)
+{
+	int body = sdf_box(g, center, vec3_create(size * 0.7, size * 0.45, size * 0.6), size * 0.3);
+	return sdf_displace(g, body, size * roughness, 1.5 / size, 4);
+}
+
+/* Torus melted into two spheres and a capsule, with a hole carved out */
+static int add_sculpture(t_sdf_graph *g, t_point3 base)
+{
+	int ring = sdf_torus(g, point3_create(base.x, base.y + 1.6, base.z), 1.0, 0.3);
+	int top = sdf_sphere(g, point3_create(base.x, base.y + 2.7, base.z), 0.6);
+	int bottom = sdf_sphere(g, point3_create(base.x, base.y + 0.5, base.z), 0.5);
+	int stem = sdf_capsule(g, point3_create(base.x, base.y + 0.5, base.z),
+						   point3_create(base.x, base.y + 2.7, base.z), 0.2);
+	int blob = sdf_combine(g, SDF_SMOOTH_UNION, ring, top, 0.6);
+	blob = sdf_combine(g, SDF_SMOOTH_UNION, blob, bottom, 0.6);
+	blob = sdf_combine(g, SDF_SMOOTH_UNION, blob, stem, 0.4);
+	int hole = sdf_sphere(g, point3_create(base.x, base.y + 2.9, base.z + 0.5), 0.35);
+	return sdf_combine(g, SDF_SUBTRACT, blob, hole, 0);
+}
+
+void sdf_rocks(void)
+{
+	t_hittable_list world;
+	hittable_list_init(&world);
+
+	t_material *ground = lambertian_create(vec3_create(0.45, 0.42, 0.38));
+	t_material *stone = lambertian_create(vec3_create(0.55, 0.50, 0.45));
+	t_material *gold = metal_create_fuzz(vec3_create(0.85, 0.65, 0.15), 0.15);
+	t_material *jade = lambertian_create(vec3_create(0.20, 0.55, 0.40));
+
+	t_sphere floor_s = create_sphere(&(t_point3){0.0, -1000.0, 0.0}, 1000.0,
+									 vec3_create(1, 1, 1), ground);
+	hittable_list_add_sphere(&world, &floor_s);
+
+	/* Analytic rocks: one graph per rock, evaluated on the fly */
+	t_sdf_graph rocks[5];
+	for (int k = 0; k < 5; ++k)
+	{
+		sdf_graph_init(&rocks[k]);
+		real_t size = 0.5 + 0.15 * k;
+		add_rock(&rocks[k], point3_create(-4.0 + 2.0 * k, size * 0.5, 2.5 - 0.4 * k), size, 0.25);
+		t_sdf_object rock = sdf_object_create(&rocks[k], stone);
+		hittable_list_add_sdf(&world, &rock);
+	}
+
+	/* Analytic sculpture on the left, baked copy on the right */
+	t_sdf_graph sculpture;
+	sdf_graph_init(&sculpture);
+	add_sculpture(&sculpture, point3_create(-2.0, 0.0, -1.0));
+	t_sdf_object analytic = sdf_object_create(&sculpture, gold);
+	hittable_list_add_sdf(&world, &analytic);
+
+	t_sdf_graph baked_src;
+	sdf_graph_init(&baked_src);
+	add_sculpture(&baked_src, point3_create(2.0, 0.0, -1.0));
+	t_sdf_bricks bricks;
+	sdf_bricks_init(&bricks);
+	if (sdf_bricks_bake(&bricks, &baked_src, 0.02, jade))
+		hittable_list_add_sdf_bricks(&world, &bricks);
+	fprintf(stderr, "Baked sculpture: %zu bricks, %.1f KiB\n",
+			bricks.count, (double)sdf_bricks_memory(&bricks) / 1024.0);
+
+	t_material *sun = diffuse_light_create(vec3_create(6.0, 6.0, 5.5));
+	t_sphere sun_s = create_sphere(&(t_point3){-6.0, 10.0, 6.0}, 2.5, vec3_create(1, 1, 1), sun);
+	hittable_list_add_sphere(&world, &sun_s);
+	t_light_list lights;
+	light_list_init(&lights);
+	light_list_add_sphere(&lights, &sun_s);
+
+	t_bvh_node *world_bvh = bvh_node_create(&world);
+	t_hittable_list accel;
+	hittable_list_init(&accel);
+	if (world_bvh)
+	{
+		t_hittable_wrapper bvh_wrap = {
+			.object = world_bvh,
+			.owned = true,
+			.set_current = set_current_bvh,
+			.hit_noobj = bvh_node_hit,
+			.bbox = world_bvh->bbox};
+		hittable_list_add_wrapper(&accel, &bvh_wrap);
+	}
+
+	t_camera cam;
+	cam.aspect_ratio = 16.0 / 9.0;
+	cam.image_width = 800;
+	cam.samples_per_pixel = 64;
+	cam.max_depth = 20;
+	cam.background = vec3_create(0.55, 0.70, 0.95);
+	cam.vfov = 35.0;
+	cam.lookfrom = point3_create(0.0, 3.0, 12.0);
+	cam.lookat = point3_create(0.0, 1.0, 0.0);
+	cam.vup = vec3_create(0.0, 1.0, 0.0);
+	cam.defocus_angle = 0.0;
+	cam.focus_dist = 12.0;
+
+	camera_init(&cam, cam.aspect_ratio, cam.image_width);
+	cam.lights = &lights;
+
+	const t_hittable_list *render_world = world_bvh ? &accel : &world;
+	camera_render(&cam, stdout, render_world);
+
+	hittable_list_clear(&accel);
+	hittable_list_clear(&world);
+	light_list_clear(&lights);
+	sdf_bricks_clear(&bricks);
+	sdf_graph_clear(&baked_src);
+	sdf_graph_clear(&sculpture);
+	for (int k = 0; k < 5; ++k)
+		sdf_graph_clear(&rocks[k]);
+}
+
+int main(void)
+{
+	sdf_rocks();
+	return 0;
+}
@@ -0,0 +1,375 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   tile.h                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dlesieur <dlesieur@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/05 17:40:26 by dlesieur          #+#    #+#             */
+/*   Updated: 2026/01/05 17:40:26 by dlesieur         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef TILE_H
+#define TILE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Image tiles handed out to render threads. Tiles are generated in a chosen
+   order, dealt round-robin into one deque per thread; a thread pops from the
+   front of its own deque and steals from the back of the others. When fewer
+   tiles than threads are left, a popped tile is split in four so idle
+   threads have something to steal until the last pixel. */
+
+#define TILE_DEFAULT_SIZE 32
+#define TILE_MIN_SPLIT 4 /* never split below this many pixels per side */
+
+typedef enum e_tile_order
+{
+	TILE_ORDER_SCANLINE, /* row by row from the top left */
+	TILE_ORDER_SPIRAL,	 /* from the image centre outwards */
+	TILE_ORDER_MORTON	 /* Z-order curve, keeps neighbours close in time */
+} t_tile_order;
+
+/* Half-open pixel rectangle [x0, x1) x [y0, y1) */
+typedef struct s_tile
+{
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+} t_tile;
+
+static inline int tile_area(const t_tile *t)
+{
+	return (t->x1 - t->x0) * (t->y1 - t->y0);
+}
+
+/* ============================================================================ */
+/*                              TILE ORDERING                                   */
+/* ============================================================================ */
+
+/* Interleave the low 16 bits of x and y */
+static inline uint32_t tile_morton2(uint32_t x, uint32_t y)
+{
+	x &= 0xFFFF;
+	y &= 0xFFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
+
+typedef struct s_tile_key
+{
+	uint64_t key;
+	t_tile tile;
+} t_tile_key;
+
+static inline int tile_key_compare(const void *a, const void *b)
+{
+	uint64_t ka = ((const t_tile_key *)a)->key;
+	uint64_t kb = ((const t_tile_key *)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+/* Sort key of tile (tx, ty) in a tiles_x * tiles_y grid */
+static inline uint64_t tile_order_key(t_tile_order order, int tx, int ty, int tiles_x, int tiles_y)
+{
+	if (order == TILE_ORDER_MORTON)
+		return ((uint64_t)tile_morton2((uint32_t)tx, (uint32_t)ty) << 32) | (uint64_t)(ty * tiles_x + tx);
+	if (order == TILE_ORDER_SPIRAL)
+	{
+		/* Ring index (Chebyshev distance from the centre), then angle in the ring */
+		double cx = 0.5 * (tiles_x - 1);
+		double cy = 0.5 * (tiles_y - 1);
+		double dx = tx - cx;
+		double dy = ty - cy;
+		double ring = (dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy) ? (dx < 0 ? -dx : dx) : (dy < 0 ? -dy : dy);
+		double angle = atan2(dy, dx) + 3.14159265358979323846; /* [0, 2pi] */
+		return ((uint64_t)(ring * 2.0) << 32) | (uint64_t)(angle * 1.0e8);
+	}
+	return (uint64_t)(ty * tiles_x + tx);
+}
+
+/* All tiles of a width x height image in the requested order (malloc'd) */
+static inline t_tile *tile_list_create(int width, int height, int tile_size, t_tile_order order, int *count)
+{
+	if (tile_size < 1)
+		tile_size = TILE_DEFAULT_SIZE;
+	int tiles_x = (width + tile_size - 1) / tile_size;
+	int tiles_y = (height + tile_size - 1) / tile_size;
+	int n = tiles_x * tiles_y;
+	*count = 0;
+	if (n <= 0)
+		return NULL;
+
+	t_tile_key *keys = (t_tile_key *)malloc((size_t)n * sizeof(t_tile_key));
+	t_tile *tiles = (t_tile *)malloc((size_t)n * sizeof(t_tile));
+	if (!keys || !tiles)
+	{
+		free(keys);
+		free(tiles);
+		return NULL;
+	}
+	for (int ty = 0; ty < tiles_y; ++ty)
+		for (int tx = 0; tx < tiles_x; ++tx)
+		{
+			t_tile_key *k = &keys[ty * tiles_x + tx];
+			k->tile.x0 = tx * tile_size;
+			k->tile.y0 = ty * tile_size;
+			k->tile.x1 = (k->tile.x0 + tile_size < width) ? k->tile.x0 + tile_size : width;
+			k->tile.y1 = (k->tile.y0 + tile_size < height) ? k->tile.y0 + tile_size : height;
+			k->key = tile_order_key(order, tx, ty, tiles_x, tiles_y);
+		}
+	qsort(keys, (size_t)n, sizeof(t_tile_key), tile_key_compare);
+	for (int i = 0; i < n; ++i)
+		tiles[i] = keys[i].tile;
+	free(keys);
+	*count = n;
+	return tiles;
+}
+
+/* Clip tiles to window in place, dropping those outside it. Returns the
+   number of tiles left. */
+static inline int tile_list_clip(t_tile *tiles, int count, const t_tile *window)
+{
+	int kept = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		t_tile t = tiles[i];
+		t.x0 = (t.x0 > window->x0) ? t.x0 : window->x0;
+		t.y0 = (t.y0 > window->y0) ? t.y0 : window->y0;
+		t.x1 = (t.x1 < window->x1) ? t.x1 : window->x1;
+		t.y1 = (t.y1 < window->y1) ? t.y1 : window->y1;
+		if (t.x0 < t.x1 && t.y0 < t.y1)
+			tiles[kept++] = t;
+	}
+	return kept;
+}
+
+/* ============================================================================ */
+/*                          WORK-STEALING SCHEDULER                             */
+/* ============================================================================ */
+
+/* Growable deque; the owner pops at head, thieves take from tail */
+typedef struct s_tile_deque
+{
+	t_tile *items;
+	int head;
+	int tail;
+	int capacity;
+#ifdef _OPENMP
+	omp_lock_t lock;
+#endif
+} t_tile_deque;
+
+typedef struct s_tile_scheduler
+{
+	t_tile_deque *deques;
+	int thread_count;
+	int pending; /* tiles queued or being rendered */
+	int tiles_total;
+	int steals;
+	int splits;
+} t_tile_scheduler;
+
+static inline void tile_deque_lock(t_tile_deque *d)
+{
+#ifdef _OPENMP
+	omp_set_lock(&d->lock);
+#else
+	(void)d;
+#endif
+}
+
+static inline void tile_deque_unlock(t_tile_deque *d)
+{
+#ifdef _OPENMP
+	omp_unset_lock(&d->lock);
+#else
+	(void)d;
+#endif
+}
+
+/* Append at the tail; caller holds the lock */
+static inline bool tile_deque_push_locked(t_tile_deque *d, const t_tile *t)
+{
+	if (d->tail >= d->capacity)
+	{
+		/* Compact first, grow only if still full */
+		int live = d->tail - d->head;
+		if (d->head > 0)
+		{
+			for (int i = 0; i < live; ++i)
+				d->items[i] = d->items[d->head + i];
+			d->head = 0;
+			d->tail = live;
+		}
+		if (d->tail >= d->capacity)
+		{
+			int newcap = (d->capacity == 0) ? 16 : d->capacity * 2;
+			t_tile *arr = (t_tile *)realloc(d->items, (size_t)newcap * sizeof(t_tile));
+			if (!arr)
+				return false;
+			d->items = arr;
+			d->capacity = newcap;
+		}
+	}
+	d->items[d->tail++] = *t;
+	return true;
+}
+
+static inline void tile_scheduler_destroy(t_tile_scheduler *s)
+{
+	if (!s || !s->deques)
+		return;
+	for (int t = 0; t < s->thread_count; ++t)
+	{
+		free(s->deques[t].items);
+#ifdef _OPENMP
+		omp_destroy_lock(&s->deques[t].lock);
+#endif
+	}
+	free(s->deques);
+	s->deques = NULL;
+}
+
+/* Deal tiles round-robin so every thread starts with work from the
+   beginning of the order (e.g. the centre for a spiral) */
+static inline bool tile_scheduler_init(t_tile_scheduler *s, const t_tile *tiles, int count, int thread_count)
+{
+	if (!s || thread_count < 1)
+		return false;
+	s->thread_count = thread_count;
+	s->pending = count;
+	s->tiles_total = count;
+	s->steals = 0;
+	s->splits = 0;
+	s->deques = (t_tile_deque *)calloc((size_t)thread_count, sizeof(t_tile_deque));
+	if (!s->deques)
+		return false;
+	for (int t = 0; t < thread_count; ++t)
+	{
+#ifdef _OPENMP
+		omp_init_lock(&s->deques[t].lock);
+#endif
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		if (!tile_deque_push_locked(&s->deques[i % thread_count], &tiles[i]))
+		{
+			tile_scheduler_destroy(s);
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool tile_deque_pop_front(t_tile_deque *d, t_tile *out)
+{
+	bool ok = false;
+	tile_deque_lock(d);
+	if (d->head < d->tail)
+	{
+		*out = d->items[d->head++];
+		ok = true;
+	}
+	tile_deque_unlock(d);
+	return ok;
+}
+
+static inline bool tile_deque_pop_back(t_tile_deque *d, t_tile *out)
+{
+	bool ok = false;
+	tile_deque_lock(d);
+	if (d->head < d->tail)
+	{
+		*out = d->items[--d->tail];
+		ok = true;
+	}
+	tile_deque_unlock(d);
+	return ok;
+}
+
+/* Split *t in four when the queue is running dry: keep one quarter in *t,
+   push the rest onto our own deque for others to steal */
+static inline void tile_scheduler_maybe_split(t_tile_scheduler *s, int tid, t_tile *t)
+{
+	int pending;
+#pragma omp atomic read
+	pending = s->pending;
+	if (pending > s->thread_count)
+		return;
+	int w = t->x1 - t->x0;
+	int h = t->y1 - t->y0;
+	if (w < 2 * TILE_MIN_SPLIT || h < 2 * TILE_MIN_SPLIT)
+		return;
+
+	int xm = t->x0 + w / 2;
+	int ym = t->y0 + h / 2;
+	t_tile parts[3] = {
+		{xm, t->y0, t->x1, ym},
+		{t->x0, ym, xm, t->y1},
+		{xm, ym, t->x1, t->y1}};
+	t_tile_deque *d = &s->deques[tid];
+	int pushed = 0;
+	tile_deque_lock(d);
+	while (pushed < 3 && tile_deque_push_locked(d, &parts[pushed]))
+		++pushed;
+	if (pushed < 3)
+		d->tail -= pushed; /* allocation failed: render the tile whole */
+	tile_deque_unlock(d);
+	if (pushed < 3)
+		return;
+#pragma omp atomic
+	s->pending += 3;
+#pragma omp atomic
+	s->splits += 1;
+	t->x1 = xm;
+	t->y1 = ym;
+}
+
+/* Next tile for thread tid. Returns false once a sweep over every deque
+   comes up empty: new work only appears when a thread splits the tile it
+   just popped, and that thread renders any quarters nobody steals. */
+static inline bool tile_scheduler_next(t_tile_scheduler *s, int tid, t_tile *out)
+{
+	if (tile_deque_pop_front(&s->deques[tid], out))
+	{
+		tile_scheduler_maybe_split(s, tid, out);
+		return true;
+	}
+	for (int k = 1; k < s->thread_count; ++k)
+	{
+		int victim = (tid + k) % s->thread_count;
+		if (tile_deque_pop_back(&s->deques[victim], out))
+		{
+#pragma omp atomic
+			s->steals += 1;
+			tile_scheduler_maybe_split(s, tid, out);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Mark a tile returned by tile_scheduler_next as done */
+static inline void tile_scheduler_done(t_tile_scheduler *s)
+{
+#pragma omp atomic
+	s->pending -= 1;
+}
+
+#endif
@@ -95,6 +95,7 @@ static inline bool triangle_hit(const t_triangle *tri, const t_ray *r,
 {
 	if (!tri || !r || !rec)
 		return false;
+	RT_STAT_PRIM(STAT_PRIM_TRIANGLE);
 
 	const real_t EPSILON = (real_t)1e-8;
 
@@ -140,6 +141,9 @@ static inline bool triangle_hit(const t_triangle *tri, const t_ray *r,
 	/* Hit! Fill record */
 	rec->t = t;
 	rec->p = ray_at((t_ray *)r, t);
+#ifdef RT_REFINE_HITS
+	ray_refine_plane_hit(r, &tri->normal, &tri->v0, &rec->t, &rec->p);
+#endif
 	rec->u = u;
 	rec->v = v;
 	rec->mat = tri->mat;
@@ -149,6 +153,34 @@ static inline bool triangle_hit(const t_triangle *tri, const t_ray *r,
 	return true;
 }
 
+/* Light sampling: solid-angle density of direction r->dir seen from r->orig
+   when directions are drawn by triangle_light_random (0 if the ray misses) */
+static inline real_t triangle_light_pdf(const t_triangle *tri, const t_ray *r)
+{
+	t_hit_record rec;
+	if (!triangle_hit(tri, r, interval((real_t)0.0, INFINITY), &rec))
+		return (real_t)0.0;
+	t_vec3 n = cross(&tri->e1, &tri->e2);
+	real_t area = (real_t)0.5 * vec3_length(&n);
+	real_t len_sq = vec3_length_squared(&r->dir);
+	real_t cosine = (real_t)fabs((double)dot(&r->dir, &tri->normal)) / (real_t)sqrt((double)len_sq);
+	if (area <= (real_t)0.0 || cosine < (real_t)1e-8)
+		return (real_t)0.0;
+	return rec.t * rec.t * len_sq / (cosine * area);
+}
+
+/* Light sampling: vector from origin to a uniform point on the triangle */
+static inline t_vec3 triangle_light_random(const t_triangle *tri, const t_point3 *origin)
+{
+	real_t su = (real_t)sqrt((double)random_real());
+	real_t r2 = random_real();
+	t_vec3 d1 = vec3_mul_scalar(&tri->e1, su * ((real_t)1.0 - r2));
+	t_vec3 d2 = vec3_mul_scalar(&tri->e2, su * r2);
+	t_point3 p = vec3_add(&tri->v0, &d1);
+	p = vec3_add(&p, &d2);
+	return vec3_sub(&p, origin);
+}
+
 /* Thread-local current triangle for hit_noobj */
 static __thread const t_triangle *g_current_triangle = NULL;
 
@@ -22,6 +22,11 @@ typedef double real_t;
 typedef float real_t;
 #endif
 
+/* Double re-intersection of final hits only matters in float builds */
+#if defined(RT_REFINE_HITS) && !defined(FLOAT_TYPE)
+#undef RT_REFINE_HITS
+#endif
+
 /* Forward declare t_vec3 for aliases below */
 typedef struct s_vec3 t_vec3;
 
@@ -173,22 +173,22 @@ static inline t_vec3 vec3_random_interval(real_t min, real_t max)
 		random_real_interval(min, max));
 }
 
-/* Random point in unit sphere (rejection sampling) */
-static inline t_vec3 random_in_unit_sphere(void)
+/* Random unit vector (on unit sphere surface): uniform z and azimuth, so it
+   uses exactly two random numbers */
+static inline t_vec3 random_unit_vector(void)
 {
-	while (1)
-	{
-		t_vec3 p = vec3_random_interval((real_t)-1.0, (real_t)1.0);
-		if (vec3_length_squared(&p) < (real_t)1.0)
-			return p;
-	}
+	real_t z = (real_t)1.0 - (real_t)2.0 * random_real();
+	real_t phi = (real_t)(2.0 * PI) * random_real();
+	real_t r = (real_t)sqrt(fmax(0.0, (double)((real_t)1.0 - z * z)));
+	return vec3_create(r * (real_t)cos((double)phi), r * (real_t)sin((double)phi), z);
 }
 
-/* Random unit vector (on unit sphere surface) */
-static inline t_vec3 random_unit_vector(void)
+/* Random point in unit sphere: a direction scaled by the cube root of a
+   uniform number (three random numbers, no rejection loop) */
+static inline t_vec3 random_in_unit_sphere(void)
 {
-	t_vec3 p = random_in_unit_sphere();
-	return unit_vector(&p);
+	t_vec3 dir = random_unit_vector();
+	return vec3_mul_scalar(&dir, (real_t)cbrt((double)random_real()));
 }
 
 /* Random vector in hemisphere oriented by normal */
@@ -200,18 +200,53 @@ static inline t_vec3 random_on_hemisphere(const t_vec3 *normal)
 	return vec3_neg(&on_unit_sphere);
 }
 
-/* Random point in unit disk (for defocus blur) */
+/* Random point in unit disk (for defocus blur): concentric mapping of the
+   unit square, which keeps the stratification of the two numbers */
 static inline t_vec3 random_in_unit_disk(void)
 {
-	while (1)
+	real_t a = (real_t)2.0 * random_real() - (real_t)1.0;
+	real_t b = (real_t)2.0 * random_real() - (real_t)1.0;
+	if (a == (real_t)0.0 && b == (real_t)0.0)
+		return vec3_zero();
+	real_t r;
+	real_t theta;
+	if (fabs((double)a) > fabs((double)b))
 	{
-		t_vec3 p = vec3_create(
-			random_real_interval((real_t)-1.0, (real_t)1.0),
-			random_real_interval((real_t)-1.0, (real_t)1.0),
-			(real_t)0.0);
-		if (vec3_length_squared(&p) < (real_t)1.0)
-			return p;
+		r = a;
+		theta = (real_t)(PI / 4.0) * (b / a);
 	}
+	else
+	{
+		r = b;
+		theta = (real_t)(PI / 2.0) - (real_t)(PI / 4.0) * (a / b);
+	}
+	return vec3_create(r * (real_t)cos((double)theta), r * (real_t)sin((double)theta), (real_t)0.0);
+}
+
+/* Express local direction (x, y, z) in an orthonormal basis whose z axis is
+   `axis` (need not be unit length) */
+static inline t_vec3 vec3_local_to_world(const t_vec3 *axis, real_t x, real_t y, real_t z)
+{
+	t_vec3 w = unit_vector(axis);
+
+	/* Choose a vector not parallel to w for cross product */
+	t_vec3 a;
+	if (fabsl((long double)w.x) > (long double)0.9)
+		a = vec3_create((real_t)0.0, (real_t)1.0, (real_t)0.0);
+	else
+		a = vec3_create((real_t)1.0, (real_t)0.0, (real_t)0.0);
+
+	/* Create orthonormal basis: u, v, w */
+	t_vec3 v_cross = cross(&w, &a);
+	t_vec3 v = unit_vector(&v_cross);
+	t_vec3 u = cross(&w, &v);
+
+	/* Transform local direction to world space */
+	t_vec3 u_scaled = vec3_mul_scalar(&u, x);
+	t_vec3 v_scaled = vec3_mul_scalar(&v, y);
+	t_vec3 w_scaled = vec3_mul_scalar(&w, z);
+	t_vec3 uv = vec3_add(&u_scaled, &v_scaled);
+	return vec3_add(&uv, &w_scaled);
 }
 
 /* Cosine-weighted hemisphere sampling: generates direction with PDF = cos(theta)/pi
@@ -235,27 +270,7 @@ static inline t_vec3 random_cosine_direction(const t_vec3 *normal)
 	real_t y = (real_t)sin((double)phi) * sin_theta;
 	real_t z = cos_theta;
 
-	/* Build orthonormal basis around normal */
-	t_vec3 w = unit_vector(normal);
-
-	/* Choose a vector not parallel to w for cross product */
-	t_vec3 a;
-	if (fabsl((long double)w.x) > (long double)0.9)
-		a = vec3_create((real_t)0.0, (real_t)1.0, (real_t)0.0);
-	else
-		a = vec3_create((real_t)1.0, (real_t)0.0, (real_t)0.0);
-
-	/* Create orthonormal basis: u, v, w */
-	t_vec3 v_cross = cross(&w, &a);
-	t_vec3 v = unit_vector(&v_cross);
-	t_vec3 u = cross(&w, &v);
-
-	/* Transform local direction to world space */
-	t_vec3 u_scaled = vec3_mul_scalar(&u, x);
-	t_vec3 v_scaled = vec3_mul_scalar(&v, y);
-	t_vec3 w_scaled = vec3_mul_scalar(&w, z);
-	t_vec3 uv = vec3_add(&u_scaled, &v_scaled);
-	return vec3_add(&uv, &w_scaled);
+	return vec3_local_to_world(normal, x, y, z);
 }
 
 #endif
\ No newline at end of file
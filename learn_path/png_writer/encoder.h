@@ -259,13 +259,34 @@ static inline void writeLZ77data(size_t *bp, ucvector *out, const uivector *lz77
 	}
 }
 
+/* Index of the last entry of the ascending table array[0..size) that is <= value */
+static inline unsigned searchCodeIndex(const unsigned *array, unsigned size, unsigned value)
+{
+	unsigned left = 1;
+	unsigned right = size - 1;
+	while (left <= right)
+	{
+		unsigned mid = (left + right) >> 1;
+		if (array[mid] >= value)
+			right = mid - 1;
+		else
+			left = mid + 1;
+	}
+	if (left >= size || array[left] > value)
+		--left;
+	return left;
+}
+
+/* Append one match as the four values writeLZ77data reads: length symbol,
+   length extra bits, distance symbol, distance extra bits */
 static inline void addLengthDistance(uivector *out, unsigned length, unsigned distance)
 {
-	unsigned length_code = length - 3;
-	unsigned distance_code = distance - 1;
-	uivector_push_back(out, length_code > 279 ? (length_code - 280 + 280) : length_code + 257);
-	uivector_push_back(out, length > 258 ? 258 : length);
+	unsigned length_code = searchCodeIndex(LENGTHBASE, 29, length);
+	unsigned distance_code = searchCodeIndex(DISTANCEBASE, 30, distance);
+	uivector_push_back(out, length_code + FIRST_LENGTH_CODE_INDEX);
+	uivector_push_back(out, length - LENGTHBASE[length_code]);
 	uivector_push_back(out, distance_code);
+	uivector_push_back(out, distance - DISTANCEBASE[distance_code]);
 }
 
 static inline unsigned lodepng_encode(unsigned char **out, size_t *outsize,
@@ -395,13 +416,17 @@ static inline unsigned lodepng_encode(unsigned char **out, size_t *outsize,
 			state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
 		}
 		if (!state->error)
-			preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
+			state->error = preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
 		lodepng_free(converted);
 		if (state->error)
 			goto cleanup;
 	}
 	else
-		preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+	{
+		state->error = preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+		if (state->error)
+			goto cleanup;
+	}
 
 	{
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
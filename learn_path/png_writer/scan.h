@@ -18,8 +18,10 @@
 #include "bit.h"
 #include "colors.h"
 
-/* forward decl from filter.h */
+/* forward decls from filter.h */
 static unsigned unfilter(unsigned char *out, const unsigned char *in, unsigned w, unsigned h, unsigned bpp);
+static unsigned filter(unsigned char *out, const unsigned char *in, unsigned w, unsigned h,
+					   const LodePNGColorMode *info, const LodePNGEncoderSettings *settings);
 
 /*out must be buffer big enough to contain full image, and in must contain the full decompressed data from
 the IDAT chunks (with filter index bytes and possible padding bits)
@@ -68,15 +70,41 @@ static inline size_t lodepng_get_raw_size_idat(unsigned w, unsigned h, const Lod
 	return h * (linebytes + 1);
 }
 
-static void preProcessScanlines(unsigned char **out, size_t *outsize,
-								const unsigned char *in, unsigned w, unsigned h,
-								const LodePNGInfo *info, const LodePNGEncoderSettings *settings)
+/*out: the IDAT payload before compression, each scanline prefixed with its
+filter type byte (and padded to whole bytes). Only non-interlaced images are
+supported. return value is error*/
+static unsigned preProcessScanlines(unsigned char **out, size_t *outsize,
+									const unsigned char *in, unsigned w, unsigned h,
+									const LodePNGInfo *info, const LodePNGEncoderSettings *settings)
 {
-	(void)settings;
-	*outsize = lodepng_get_raw_size(w, h, &info->color);
+	unsigned bpp = lodepng_get_bpp(&info->color);
+	size_t linebytes = ((size_t)w * bpp + 7u) / 8u;
+	unsigned error = 0;
+
+	*out = 0;
+	*outsize = 0;
+	if (info->interlace_method != 0)
+		return 34;
+	*outsize = (size_t)h * (linebytes + 1u);
 	*out = (unsigned char *)lodepng_malloc(*outsize);
-	if (*out && *outsize)
-		memcpy(*out, in, *outsize);
+	if (!*out && *outsize)
+		return 83;
+	if (bpp < 8 && (size_t)w * bpp != linebytes * 8u)
+	{
+		/*scanlines do not end on a byte boundary: pad them first*/
+		unsigned char *padded = (unsigned char *)lodepng_malloc((size_t)h * linebytes);
+		if (!padded)
+			error = 83;
+		if (!error)
+		{
+			addPaddingBits(padded, in, linebytes * 8u, (size_t)w * bpp, h);
+			error = filter(*out, padded, w, h, &info->color, settings);
+		}
+		lodepng_free(padded);
+	}
+	else
+		error = filter(*out, in, w, h, &info->color, settings);
+	return error;
 }
 
 #endif
\ No newline at end of file
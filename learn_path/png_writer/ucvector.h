@@ -42,7 +42,10 @@ static inline int ucvector_resize(ucvector *v, size_t s)
 {
 	if (s > v->allocsize)
 	{
-		size_t n = s ? s : 1;
+		/* grow by half again so byte-wise appends stay amortized O(1) */
+		size_t n = (s > v->allocsize * 2u) ? s : (s * 3u) >> 1u;
+		if (n < 1)
+			n = 1;
 		unsigned char *p = (unsigned char *)lodepng_realloc(v->data, n);
 		if (!p)
 			return 0;
@@ -55,9 +58,10 @@ static inline int ucvector_resize(ucvector *v, size_t s)
 static inline int ucvector_reserve(ucvector *v, size_t s) { return s <= v->allocsize || ucvector_resize(v, s); }
 static inline int ucvector_push_back(ucvector *v, unsigned char c)
 {
-	if (v->size + 1 > v->allocsize && !ucvector_resize(v, v->size + 1))
+	size_t size = v->size;
+	if (!ucvector_resize(v, size + 1))
 		return 0;
-	v->data[v->size++] = c;
+	v->data[size] = c;
 	return 1;
 }
 static inline void ucvector_cleanup(ucvector *v)
@@ -36,7 +36,10 @@ static inline int uivector_resize(uivector *v, size_t s)
 {
 	if (s > v->allocsize)
 	{
-		size_t n = s ? s : 1;
+		/* grow by half again so element-wise appends stay amortized O(1) */
+		size_t n = (s > v->allocsize * 2u) ? s : (s * 3u) >> 1u;
+		if (n < 1)
+			n = 1;
 		unsigned *p = (unsigned *)lodepng_realloc(v->data, n * sizeof(unsigned));
 		if (!p)
 			return 0;
@@ -57,9 +60,10 @@ static inline int uivector_resizev(uivector *v, size_t s, unsigned val)
 }
 static inline int uivector_push_back(uivector *v, unsigned val)
 {
-	if (v->size + 1 > v->allocsize && !uivector_resize(v, v->size + 1))
+	size_t size = v->size;
+	if (!uivector_resize(v, size + 1))
 		return 0;
-	v->data[v->size++] = val;
+	v->data[size] = val;
 	return 1;
 }
 static inline void uivector_cleanup(uivector *v)